@@ -0,0 +1,68 @@
+#!/bin/sh
+# Runs the same keep-alive workload against the epoll and the io_uring event
+# loop and prints throughput, latency and the CPU time awsimd spent on it.
+#
+# Usage: compare_event_loops.sh <awsimd> <http_load> [path] [connections]
+#                               [seconds]
+#
+# The "event loop" key of /etc/awsimd.conf is switched for each run, the
+# original file is put back afterwards. Needs to run as a user that may
+# write the config file and bind the configured port.
+
+set -e
+
+AWSIMD=$1
+HTTP_LOAD=$2
+URL_PATH=${3:-/index.html}
+CONNECTIONS=${4:-1000}
+SECONDS_PER_RUN=${5:-10}
+CONFIG=/etc/awsimd.conf
+
+if [ -z "$AWSIMD" ] || [ -z "$HTTP_LOAD" ]
+then
+    echo "Usage: $0 <awsimd> <http_load> [path] [connections] [seconds]" >&2
+    exit 1
+fi
+if pgrep -x awsimd > /dev/null
+then
+    echo "awsimd is already running" >&2
+    exit 1
+fi
+
+PORT=$(sed -n 's/.*"http port": *\([0-9]*\).*/\1/p' "$CONFIG")
+BACKUP=$(mktemp)
+cp "$CONFIG" "$BACKUP"
+trap 'cp "$BACKUP" "$CONFIG"; rm -f "$BACKUP"; pkill -x awsimd || true' EXIT
+
+# Sum of user and system time of the process in clock ticks
+cpu_ticks()
+{
+    awk '{ print $14 + $15 }' "/proc/$1/stat"
+}
+
+for LOOP in epoll io_uring
+do
+    sed 's/"event loop": *"[a-z_]*"/"event loop": "'$LOOP'"/' "$BACKUP" \
+        > "$CONFIG"
+    "$AWSIMD"
+    sleep 1
+    PID=$(pgrep -x awsimd | head -n 1)
+    if [ -z "$PID" ]
+    then
+        echo "awsimd did not start" >&2
+        exit 1
+    fi
+
+    BEFORE=$(cpu_ticks "$PID")
+    echo "== $LOOP, $CONNECTIONS connections, ${SECONDS_PER_RUN}s"
+    "$HTTP_LOAD" localhost "$PORT" "$URL_PATH" "$CONNECTIONS" \
+        "$SECONDS_PER_RUN" || true
+    AFTER=$(cpu_ticks "$PID")
+    echo "server cpu: $(( (AFTER - BEFORE) * 1000 / $(getconf CLK_TCK) )) ms"
+
+    pkill -x awsimd
+    while pgrep -x awsimd > /dev/null
+    do
+        sleep 0.1
+    done
+done
@@ -0,0 +1,220 @@
+// Measures what on-the-fly compression buys and costs at each level: the
+// share of the bytes that no longer go out against the CPU time spent per
+// response, using the Compressor of the workers. Then shows the level a
+// worker picks at several loads.
+//
+// Without files, a generated HTML page and JSON document stand in for
+// typical dynamic responses.
+//
+// Usage: compression_bench [file]...
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Compressor.h"
+
+#define RUN_NANOSECONDS 300000000
+
+namespace
+{
+    struct Body
+    {
+        std::string name;
+        std::string data;
+    };
+
+    struct Result
+    {
+        uint64_t responses;
+        uint64_t bytesIn;
+        uint64_t bytesOut;
+        uint64_t cpuNanoseconds;
+    };
+}
+
+static std::vector<Body> generate_bodies();
+static uint64_t get_cpu_nanoseconds();
+static std::string read_file(const char *path);
+static Result run(awsim::Compressor &compressor,
+    const std::vector<Body> &bodies);
+
+int main(int argc, char **argv)
+{
+    std::vector<Body> bodies;
+    awsim::Compressor compressor;
+
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            bodies.push_back({argv[i], read_file(argv[i])});
+        }
+        if (bodies.empty())
+        {
+            bodies = generate_bodies();
+        }
+    }
+    catch (const std::exception &ex)
+    {
+        fprintf(stderr, "%s\n", ex.what());
+        return 1;
+    }
+    for (const Body &body : bodies)
+    {
+        printf("%s: %zu bytes\n", body.name.c_str(), body.data.size());
+    }
+
+    printf("\nlevel  reduction  us/response  MB/s in  CPU ns/saved byte\n");
+    for (int level = 1; level <= 9; ++level)
+    {
+        Result result;
+        double saved;
+
+        compressor.set_level(level);
+        result = run(compressor, bodies);
+        saved = result.bytesIn - result.bytesOut;
+        printf("%5d  %8.1f%%  %11.1f  %7.1f  %17.2f\n", level,
+            100.0 * saved / result.bytesIn,
+            result.cpuNanoseconds / 1000.0 / result.responses,
+            result.bytesIn * 1000.0 / result.cpuNanoseconds,
+            result.cpuNanoseconds / saved);
+    }
+
+    printf("\nload  level\n");
+    for (uint64_t load : {10, 60, 80, 95})
+    {
+        awsim::Compressor loaded;
+
+        loaded.record_load(
+            load * awsim::Compressor::LOAD_WINDOW_NANOSECONDS / 100,
+            (100 - load) * awsim::Compressor::LOAD_WINDOW_NANOSECONDS / 100);
+        printf("%3" PRIu64 "%%  %5d\n", load, loaded.get_level());
+    }
+    return 0;
+}
+
+static std::vector<Body> generate_bodies()
+{
+    static const char *words[] = {
+        "server", "request", "worker", "response", "static", "dynamic",
+        "cache", "client", "header", "domain", "compression", "latency"
+    };
+    std::vector<Body> bodies(2);
+    uint32_t seed = 12345;
+    auto next = [&seed]()
+    {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) & 0x7fff;
+    };
+
+    bodies[0].name = "generated HTML";
+    bodies[0].data = "<!DOCTYPE html>\n<html><head><title>Listing</title>"
+        "</head><body><table>\n";
+    for (int i = 0; bodies[0].data.size() < 24576; ++i)
+    {
+        bodies[0].data += "<tr class=\"row\"><td>" + std::to_string(i)
+            + "</td><td><a href=\"/items/" + std::to_string(next())
+            + "\">" + words[next() % 12] + " " + words[next() % 12]
+            + "</a></td><td>" + std::to_string(next() % 1000) + "."
+            + std::to_string(next() % 100) + "</td></tr>\n";
+    }
+    bodies[0].data += "</table></body></html>\n";
+
+    bodies[1].name = "generated JSON";
+    bodies[1].data = "[";
+    for (int i = 0; bodies[1].data.size() < 8192; ++i)
+    {
+        bodies[1].data += std::string(i == 0 ? "" : ",") + "{\"id\":"
+            + std::to_string(next()) + ",\"name\":\"" + words[next() % 12]
+            + "\",\"score\":" + std::to_string(next() % 10000)
+            + ",\"active\":" + (next() % 2 ? "true" : "false") + "}";
+    }
+    bodies[1].data += "]";
+    return bodies;
+}
+
+static uint64_t get_cpu_nanoseconds()
+{
+    timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static std::string read_file(const char *path)
+{
+    std::string data;
+    struct stat s;
+    size_t length = 0;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        throw std::runtime_error(std::string("open(\"") + path
+            + "\", O_RDONLY | O_CLOEXEC) failed -> " + strerror(errno));
+    }
+    if (fstat(fd, &s) == -1)
+    {
+        int error = errno;
+
+        close(fd);
+        throw std::runtime_error(std::string("fstat(\"") + path
+            + "\") failed -> " + strerror(error));
+    }
+    data.resize(s.st_size);
+    while (length < data.size())
+    {
+        ssize_t count = read(fd, &data[length], data.size() - length);
+
+        if (count == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            int error = errno;
+
+            close(fd);
+            throw std::runtime_error(std::string("read(\"") + path
+                + "\") failed -> " + (count == 0 ? "File shrank"
+                : strerror(error)));
+        }
+        length += count;
+    }
+    close(fd);
+    return data;
+}
+
+static Result run(awsim::Compressor &compressor,
+    const std::vector<Body> &bodies)
+{
+    Result result = {0, 0, 0, 0};
+    uint64_t start = get_cpu_nanoseconds();
+
+    do
+    {
+        for (const Body &body : bodies)
+        {
+            result.responses++;
+            result.bytesIn += body.data.size();
+            // Bodies that do not shrink go out as they are
+            result.bytesOut += compressor.compress(
+                awsim::Compressor::Format::Gzip, body.data.data(),
+                body.data.size()) ? compressor.get_output_length()
+                : body.data.size();
+        }
+        result.cpuNanoseconds = get_cpu_nanoseconds() - start;
+    } while (result.cpuNanoseconds < RUN_NANOSECONDS);
+    return result;
+}
@@ -0,0 +1,263 @@
+// Compares finding the Field of a header name with the perfect hash of
+// HttpRequest against the first character guess it replaced, which knew
+// eleven fields and only in their registry case, and against a
+// std::unordered_map over the name in lower case. The names are those
+// browsers, API clients and proxies send, some in lower case as HTTP/2
+// gateways pass them on. Every allocation is counted, so the run shows how
+// many a lookup costs besides how long it takes.
+//
+// Usage: header_lookup_bench
+
+#include <chrono>
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+#include "HttpRequest.h"
+
+#define LOOKUPS 8000000
+
+static uint64_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    void *memory;
+
+    allocations++;
+    memory = malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t size) noexcept
+{
+    (void)size;
+    free(memory);
+}
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Result
+    {
+        double nanoseconds;
+        uint64_t allocations;
+        uint64_t found;
+    };
+
+    // The fields the first character guess knew, in its order
+    enum class OldField
+    {
+        Host,
+        UserAgent,
+        Accept,
+        AcceptLanguage,
+        AcceptEncoding,
+        Connection,
+        UpgradeInsecureRequests,
+        IfModifiedSince,
+        IfNoneMatch,
+        Range,
+        IfRange,
+        Unknown
+    };
+}
+
+static const char *oldFieldStrings[] =
+{
+    "Host",
+    "User-Agent",
+    "Accept",
+    "Accept-Language",
+    "Accept-Encoding",
+    "Connection",
+    "Upgrade-Insecure-Requests",
+    "If-Modified-Since",
+    "If-None-Match",
+    "Range",
+    "If-Range",
+};
+
+static OldField get_old_field(const char *at, size_t length);
+template<class Lookup>
+static Result run(const std::vector<std::string> &names, Lookup lookup);
+
+int main()
+{
+    static const char *requestNames[] = {
+        // Chrome
+        "Host", "Connection", "sec-ch-ua", "sec-ch-ua-mobile", "User-Agent",
+        "sec-ch-ua-platform", "Accept", "Sec-Fetch-Site", "Sec-Fetch-Mode",
+        "Sec-Fetch-Dest", "Referer", "Accept-Encoding", "Accept-Language",
+        "Cookie", "If-None-Match", "If-Modified-Since",
+        // Firefox
+        "Host", "User-Agent", "Accept", "Accept-Language", "Accept-Encoding",
+        "Connection", "Referer", "Cookie", "Upgrade-Insecure-Requests",
+        "Sec-Fetch-Dest", "Sec-Fetch-Mode", "Sec-Fetch-Site",
+        "Sec-Fetch-User", "Priority",
+        // An API client behind a proxy, in lower case
+        "host", "user-agent", "accept", "authorization", "content-type",
+        "content-length", "x-forwarded-for", "x-forwarded-proto",
+        "x-request-id", "traceparent",
+        // Resuming a download
+        "Host", "Range", "If-Range", "User-Agent"
+    };
+    std::vector<std::string> names(std::begin(requestNames),
+        std::end(requestNames));
+    std::unordered_map<std::string, awsim::HttpRequest::Field> map;
+    Result result;
+
+    for (size_t i = 0; i < awsim::HttpRequest::NUMBER_OF_FIELDS; ++i)
+    {
+        std::string name = awsim::HttpRequest::fieldStrings[i];
+
+        for (char &c : name)
+        {
+            c = tolower(c);
+        }
+        map[name] = (awsim::HttpRequest::Field)i;
+    }
+
+    printf("%zu names, %zu fields, %d lookups\n\n", names.size(),
+        awsim::HttpRequest::NUMBER_OF_FIELDS, LOOKUPS);
+    printf("lookup                  ns/lookup  allocations/lookup  found\n");
+    result = run(names, [](const std::string &name)
+    {
+        return get_old_field(name.data(), name.size()) != OldField::Unknown;
+    });
+    printf("first character (old)   %9.1f  %18.3f  %5.1f%%\n",
+        result.nanoseconds, (double)result.allocations / LOOKUPS,
+        100.0 * result.found / LOOKUPS);
+    result = run(names, [&map](const std::string &name)
+    {
+        std::string lower(name);
+
+        for (char &c : lower)
+        {
+            c = tolower(c);
+        }
+        return map.find(lower) != map.end();
+    });
+    printf("unordered_map           %9.1f  %18.3f  %5.1f%%\n",
+        result.nanoseconds, (double)result.allocations / LOOKUPS,
+        100.0 * result.found / LOOKUPS);
+    result = run(names, [](const std::string &name)
+    {
+        return awsim::HttpRequest::find_field(name.data(), name.size())
+            != awsim::HttpRequest::Field::Unknown;
+    });
+    printf("perfect hash            %9.1f  %18.3f  %5.1f%%\n",
+        result.nanoseconds, (double)result.allocations / LOOKUPS,
+        100.0 * result.found / LOOKUPS);
+    return 0;
+}
+
+// As Worker matched header names before the perfect hash
+static OldField get_old_field(const char *at, size_t length)
+{
+    OldField field = OldField::Unknown;
+    const char *fieldString;
+
+    if (length > 0)
+    {
+        switch (at[0])
+        {
+            case 'H':
+                field = OldField::Host;
+                break;
+            case 'A':
+                field = OldField::Accept;
+                break;
+            case 'C':
+                field = OldField::Connection;
+                break;
+            case 'U':
+                field = OldField::UserAgent;
+                break;
+            case 'I':
+                field = OldField::IfModifiedSince;
+                break;
+            case 'R':
+                field = OldField::Range;
+                break;
+            default:
+                field = OldField::Unknown;
+                break;
+        }
+    }
+
+    if (field != OldField::Unknown)
+    {
+        fieldString = oldFieldStrings[(int)field];
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (at[i] != fieldString[i])
+            {
+                if (field == OldField::Accept)
+                {
+                    field = OldField::AcceptEncoding;
+                }
+                else if (field == OldField::AcceptEncoding)
+                {
+                    field = OldField::AcceptLanguage;
+                }
+                else if (field == OldField::UserAgent)
+                {
+                    field = OldField::UpgradeInsecureRequests;
+                }
+                else if (field == OldField::IfModifiedSince)
+                {
+                    field = OldField::IfNoneMatch;
+                }
+                else if (field == OldField::IfNoneMatch)
+                {
+                    field = OldField::IfRange;
+                }
+                else
+                {
+                    field = OldField::Unknown;
+                    break;
+                }
+                fieldString = oldFieldStrings[(int)field];
+                --i;
+            }
+            else if (i == length - 1 && fieldString[i + 1] != '\0')
+            {
+                field = OldField::Unknown;
+                break;
+            }
+        }
+    }
+    return field;
+}
+
+template<class Lookup>
+static Result run(const std::vector<std::string> &names, Lookup lookup)
+{
+    Result result = {0, 0, 0};
+    uint64_t allocationsBefore = allocations;
+    Clock::time_point start = Clock::now();
+
+    for (size_t i = 0; i < LOOKUPS; ++i)
+    {
+        result.found += lookup(names[i % names.size()]);
+    }
+    result.nanoseconds = std::chrono::duration<double, std::nano>(
+        Clock::now() - start).count() / LOOKUPS;
+    result.allocations = allocations - allocationsBefore;
+    return result;
+}
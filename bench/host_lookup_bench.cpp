@@ -0,0 +1,149 @@
+// Compares finding the domain of a Host header in the HostTable of the
+// workers with the std::string and std::unordered_map lookup it replaced,
+// over thousands of virtual hosts. Every allocation is counted, so the run
+// shows how many a lookup costs besides how long it takes.
+//
+// Usage: host_lookup_bench [hosts]
+
+#include <chrono>
+#include <inttypes.h>
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "HostTable.h"
+
+#define LOOKUPS 4000000
+
+static uint64_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    void *memory;
+
+    allocations++;
+    memory = malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t size) noexcept
+{
+    (void)size;
+    free(memory);
+}
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Result
+    {
+        double nanoseconds;
+        uint64_t allocations;
+        uint64_t found;
+    };
+}
+
+template<class Lookup>
+static Result run(const std::vector<std::string> &headers, Lookup lookup);
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000;
+    std::vector<std::string> names;
+    std::vector<std::string> headers;
+    std::vector<std::pair<std::string_view, const awsim::Domain*>> hosts;
+    std::unordered_map<std::string, size_t> map;
+    awsim::HostTable table;
+    Result result;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        names.push_back("www.customer-" + std::to_string(i)
+            + ".example-hosting.com");
+    }
+    // The table only hands the pointers back, they are never dereferenced
+    for (size_t i = 0; i < count; ++i)
+    {
+        hosts.emplace_back(names[i], (const awsim::Domain*)&names[i]);
+        map.emplace(names[i], i);
+    }
+    table.init(hosts, nullptr);
+
+    // What clients send: mostly plain names, some with a port or in upper
+    // case, and some names that no domain has
+    for (size_t i = 0; i < 1024; ++i)
+    {
+        const std::string &name = names[(i * 7919) % count];
+
+        switch (i % 8)
+        {
+            case 5:
+                headers.push_back(name + ":8080");
+                break;
+            case 6:
+                headers.push_back("WWW" + name.substr(3));
+                break;
+            case 7:
+                headers.push_back("unknown-" + std::to_string(i) + ".org");
+                break;
+            default:
+                headers.push_back(name);
+                break;
+        }
+    }
+
+    printf("%zu hosts, %d lookups\n\n", count, LOOKUPS);
+    printf("lookup                   ns/lookup  allocations/lookup  found\n");
+    result = run(headers, [&table](const std::string &header)
+    {
+        return table.find(std::string_view(header.data(), header.size()))
+            != nullptr;
+    });
+    printf("HostTable                %9.1f  %18.3f  %5.1f%%\n",
+        result.nanoseconds, (double)result.allocations / LOOKUPS,
+        100.0 * result.found / LOOKUPS);
+    result = run(headers, [&map](const std::string &header)
+    {
+        // As ParserDetails did: a string of the header value, which does not
+        // match when the header carries a port or is not in lower case
+        return map.find(std::string(header.data(), header.size()))
+            != map.end();
+    });
+    printf("string + unordered_map   %9.1f  %18.3f  %5.1f%%\n",
+        result.nanoseconds, (double)result.allocations / LOOKUPS,
+        100.0 * result.found / LOOKUPS);
+    return 0;
+}
+
+template<class Lookup>
+static Result run(const std::vector<std::string> &headers, Lookup lookup)
+{
+    Result result = {0, 0, 0};
+    uint64_t allocationsBefore = allocations;
+    Clock::time_point start = Clock::now();
+
+    for (size_t i = 0; i < LOOKUPS; ++i)
+    {
+        result.found += lookup(headers[i % headers.size()]);
+    }
+    result.nanoseconds = std::chrono::duration<double, std::nano>(
+        Clock::now() - start).count() / LOOKUPS;
+    result.allocations = allocations - allocationsBefore;
+    return result;
+}
@@ -0,0 +1,294 @@
+// Keep-alive HTTP/1.1 load generator used to compare server configurations.
+//
+// Every connection has exactly one request in flight. The requests are spread
+// over a number of threads, each driving its connections with epoll, and the
+// run reports the throughput and the latency percentiles of all responses.
+//
+// Usage: http_load <host> <port> <path> <connections> <seconds> [threads]
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <errno.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Connection
+    {
+        int sock;
+        Clock::time_point sent;
+        std::string response;
+    };
+
+    struct ThreadResult
+    {
+        uint64_t errors;
+        std::vector<uint32_t> latencies;
+    };
+
+    struct Options
+    {
+        sockaddr_storage address;
+        socklen_t addressLength;
+        std::string request;
+        uint64_t connections;
+        uint64_t seconds;
+        uint64_t threads;
+    };
+}
+
+static int connect_to(const Options &options);
+static size_t response_length(const std::string &response);
+static void run(const Options &options, uint64_t connections,
+    ThreadResult *result);
+static void send_request(const Options &options, Connection *connection);
+
+int main(int argc, char **argv)
+{
+    Options options;
+    addrinfo hints;
+    addrinfo *addresses;
+    std::vector<ThreadResult> results;
+    std::vector<std::thread> threads;
+    std::vector<uint32_t> latencies;
+    uint64_t errors = 0;
+    int error;
+
+    if (argc < 6 || argc > 7)
+    {
+        fprintf(stderr, "Usage: %s <host> <port> <path> <connections> "
+            "<seconds> [threads]\n", argv[0]);
+        return 1;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    error = getaddrinfo(argv[1], argv[2], &hints, &addresses);
+    if (error != 0)
+    {
+        fprintf(stderr, "getaddrinfo(%s, %s) failed -> %s\n", argv[1],
+            argv[2], gai_strerror(error));
+        return 1;
+    }
+    memcpy(&options.address, addresses->ai_addr, addresses->ai_addrlen);
+    options.addressLength = addresses->ai_addrlen;
+    freeaddrinfo(addresses);
+
+    options.request = std::string("GET ") + argv[3] + " HTTP/1.1\r\nHost: "
+        + argv[1] + "\r\n\r\n";
+    options.connections = strtoull(argv[4], nullptr, 10);
+    options.seconds = strtoull(argv[5], nullptr, 10);
+    options.threads = argc == 7 ? strtoull(argv[6], nullptr, 10)
+        : std::max(1u, std::thread::hardware_concurrency() / 2);
+    options.threads = std::min(options.threads, options.connections);
+    if (options.connections == 0 || options.seconds == 0
+        || options.threads == 0)
+    {
+        fprintf(stderr, "connections, seconds and threads must be positive\n");
+        return 1;
+    }
+
+    results.resize(options.threads);
+    for (uint64_t i = 0; i < options.threads; ++i)
+    {
+        uint64_t share = options.connections / options.threads
+            + (i < options.connections % options.threads ? 1 : 0);
+
+        threads.emplace_back(run, std::cref(options), share, &results[i]);
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    for (const ThreadResult &result : results)
+    {
+        errors += result.errors;
+        latencies.insert(latencies.end(), result.latencies.begin(),
+            result.latencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    printf("requests:   %zu\n", latencies.size());
+    printf("errors:     %" PRIu64 "\n", errors);
+    printf("throughput: %.0f req/s\n",
+        (double)latencies.size() / options.seconds);
+    if (!latencies.empty())
+    {
+        printf("latency:    p50 %u us, p90 %u us, p99 %u us, max %u us\n",
+            latencies[latencies.size() / 2],
+            latencies[latencies.size() * 90 / 100],
+            latencies[latencies.size() * 99 / 100],
+            latencies.back());
+    }
+    return errors == 0 ? 0 : 2;
+}
+
+static int connect_to(const Options &options)
+{
+    int sock;
+    int one = 1;
+
+    sock = socket(options.address.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock == -1)
+    {
+        throw std::runtime_error(std::string("socket(...) failed -> ")
+            + strerror(errno));
+    }
+    if (connect(sock, (const sockaddr*)&options.address,
+        options.addressLength) == -1)
+    {
+        int error = errno;
+
+        close(sock);
+        throw std::runtime_error(std::string("connect(...) failed -> ")
+            + strerror(error));
+    }
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return sock;
+}
+
+// Returns the length of the first complete response, 0 if it is incomplete
+static size_t response_length(const std::string &response)
+{
+    size_t headerEnd = response.find("\r\n\r\n");
+    size_t field;
+    size_t length = 0;
+
+    if (headerEnd == std::string::npos)
+    {
+        return 0;
+    }
+    field = response.find("Content-Length:");
+    if (field != std::string::npos && field < headerEnd)
+    {
+        length = strtoull(response.c_str() + field + 15, nullptr, 10);
+    }
+    if (response.size() < headerEnd + 4 + length)
+    {
+        return 0;
+    }
+    return headerEnd + 4 + length;
+}
+
+static void run(const Options &options, uint64_t connections,
+    ThreadResult *result)
+{
+    std::vector<Connection> pool(connections);
+    std::vector<epoll_event> events(connections);
+    Clock::time_point end;
+    char buffer[65536];
+    int epollfd;
+
+    result->errors = 0;
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd == -1)
+    {
+        fprintf(stderr, "epoll_create1(EPOLL_CLOEXEC) failed -> %s\n",
+            strerror(errno));
+        result->errors++;
+        return;
+    }
+    for (uint64_t i = 0; i < connections; ++i)
+    {
+        epoll_event event;
+
+        try
+        {
+            pool[i].sock = connect_to(options);
+        }
+        catch (std::runtime_error &e)
+        {
+            fprintf(stderr, "%s\n", e.what());
+            pool[i].sock = -1;
+            result->errors++;
+            continue;
+        }
+        event.events = EPOLLIN;
+        event.data.ptr = &pool[i];
+        epoll_ctl(epollfd, EPOLL_CTL_ADD, pool[i].sock, &event);
+    }
+
+    end = Clock::now() + std::chrono::seconds(options.seconds);
+    for (Connection &connection : pool)
+    {
+        if (connection.sock != -1)
+        {
+            send_request(options, &connection);
+        }
+    }
+    while (Clock::now() < end)
+    {
+        int count = epoll_wait(epollfd, events.data(), (int)events.size(),
+            100);
+
+        for (int i = 0; i < count; ++i)
+        {
+            Connection *connection = (Connection*)events[i].data.ptr;
+            ssize_t received;
+            size_t length;
+
+            received = recv(connection->sock, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+            {
+                result->errors++;
+                epoll_ctl(epollfd, EPOLL_CTL_DEL, connection->sock, nullptr);
+                close(connection->sock);
+                connection->sock = -1;
+                continue;
+            }
+            connection->response.append(buffer, received);
+            length = response_length(connection->response);
+            if (length == 0)
+            {
+                continue;
+            }
+            if (connection->response.compare(9, 3, "200") != 0)
+            {
+                result->errors++;
+            }
+            result->latencies.push_back((uint32_t)
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - connection->sent).count());
+            connection->response.erase(0, length);
+            send_request(options, connection);
+        }
+    }
+
+    for (Connection &connection : pool)
+    {
+        if (connection.sock != -1)
+        {
+            close(connection.sock);
+        }
+    }
+    close(epollfd);
+}
+
+static void send_request(const Options &options, Connection *connection)
+{
+    connection->sent = Clock::now();
+    if (send(connection->sock, options.request.data(), options.request.size(),
+        MSG_NOSIGNAL) != (ssize_t)options.request.size())
+    {
+        fprintf(stderr, "send(...) failed -> %s\n", strerror(errno));
+        shutdown(connection->sock, SHUT_RDWR);
+    }
+}
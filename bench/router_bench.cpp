@@ -0,0 +1,270 @@
+// Compares finding the dynamic page of a URL in the Router of the domains
+// with the nested std::unordered_map lookup over std::string segments it
+// replaced, over thousands of routes. The maps only know static routes, so
+// they are measured on those, and the Router on routes with captures too.
+// Every allocation is counted, so the run shows how many a lookup costs
+// besides how long it takes.
+//
+// Usage: router_bench [routes]
+
+#include <chrono>
+#include <inttypes.h>
+#include <memory>
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Router.h"
+
+#define LOOKUPS 2000000
+
+static uint64_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    void *memory;
+
+    allocations++;
+    memory = malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t size) noexcept
+{
+    (void)size;
+    free(memory);
+}
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Result
+    {
+        double nanoseconds;
+        uint64_t allocations;
+        uint64_t found;
+    };
+
+    // One level of the maps DynamicPages kept, one per segment
+    struct Level
+    {
+        awsim::DynamicPage dynamicPage = nullptr;
+        std::unique_ptr<std::unordered_map<std::string, Level>> next;
+    };
+}
+
+static bool find_in_maps(const std::unordered_map<std::string, Level> &root,
+    const std::string &url);
+static void insert_in_maps(std::unordered_map<std::string, Level> &root,
+    const std::string &url, awsim::DynamicPage dynamicPage);
+static void page(const awsim::HttpRequest *request, awsim::Client *client);
+template<class Lookup>
+static Result run(const std::vector<std::string> &urls, Lookup lookup);
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000;
+    std::vector<std::string> patterns;
+    std::vector<awsim::Router::Entry> staticEntries;
+    std::vector<awsim::Router::Entry> entries;
+    std::vector<std::string> staticUrls;
+    std::vector<std::string> urls;
+    std::unordered_map<std::string, Level> maps;
+    awsim::Router staticRouter;
+    awsim::Router router;
+    awsim::Router::Match match;
+    Result result;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::string base = "/api/v2/service-" + std::to_string(i);
+
+        patterns.push_back(base + "/status");
+        insert_in_maps(maps, patterns.back(), page);
+        patterns.push_back(base + "/users/:id");
+        patterns.push_back(base + "/users/:id/posts/:post");
+        patterns.push_back("/files-" + std::to_string(i) + "/*path");
+    }
+    // The patterns no longer move from here on
+    for (size_t i = 0; i < patterns.size(); i += 4)
+    {
+        staticEntries.push_back({patterns[i], true,
+            awsim::HttpRequest::Method::GET, page, nullptr});
+        entries.push_back({patterns[i], true,
+            awsim::HttpRequest::Method::GET, page, nullptr});
+        entries.push_back({patterns[i + 1], false,
+            awsim::HttpRequest::Method::GET, page, nullptr});
+        entries.push_back({patterns[i + 1], false,
+            awsim::HttpRequest::Method::POST, page, nullptr});
+        entries.push_back({patterns[i + 2], true,
+            awsim::HttpRequest::Method::GET, page, nullptr});
+        entries.push_back({patterns[i + 3], true,
+            awsim::HttpRequest::Method::GET, page, nullptr});
+    }
+    staticRouter.init(staticEntries);
+    router.init(entries);
+
+    // What clients ask for, as normalize_url() leaves it: mostly existing
+    // routes, and some paths that match nothing
+    for (size_t i = 0; i < 1024; ++i)
+    {
+        std::string base = "/api/v2/service-"
+            + std::to_string((i * 7919) % count);
+
+        staticUrls.push_back(i % 8 == 7 ? base + "/missing" : base
+            + "/status");
+        switch (i % 8)
+        {
+            case 0:
+            case 1:
+                urls.push_back(base + "/users/" + std::to_string(i));
+                break;
+            case 2:
+                urls.push_back(base + "/users/" + std::to_string(i)
+                    + "/posts/" + std::to_string(i * 3));
+                break;
+            case 3:
+                urls.push_back("/files-" + std::to_string((i * 7919) % count)
+                    + "/css/site.css");
+                break;
+            case 7:
+                urls.push_back(base + "/missing");
+                break;
+            default:
+                urls.push_back(base + "/status");
+                break;
+        }
+    }
+
+    printf("%zu static routes, %zu routes, %d lookups\n\n", count,
+        router.size(), LOOKUPS);
+    printf("lookup                   ns/lookup  allocations/lookup  found\n");
+    result = run(staticUrls, [&staticRouter, &match](const std::string &url)
+    {
+        return staticRouter.match(url, awsim::HttpRequest::Method::GET,
+            match);
+    });
+    printf("Router, static           %9.1f  %18.3f  %5.1f%%\n",
+        result.nanoseconds, (double)result.allocations / LOOKUPS,
+        100.0 * result.found / LOOKUPS);
+    result = run(staticUrls, [&maps](const std::string &url)
+    {
+        return find_in_maps(maps, url);
+    });
+    printf("unordered_maps, static   %9.1f  %18.3f  %5.1f%%\n",
+        result.nanoseconds, (double)result.allocations / LOOKUPS,
+        100.0 * result.found / LOOKUPS);
+    result = run(urls, [&router, &match](const std::string &url)
+    {
+        return router.match(url, awsim::HttpRequest::Method::GET, match);
+    });
+    printf("Router, with captures    %9.1f  %18.3f  %5.1f%%\n",
+        result.nanoseconds, (double)result.allocations / LOOKUPS,
+        100.0 * result.found / LOOKUPS);
+    return 0;
+}
+
+static bool find_in_maps(const std::unordered_map<std::string, Level> &root,
+    const std::string &url)
+{
+    const std::unordered_map<std::string, Level> *map = &root;
+    size_t start = 0;
+
+    // As DynamicPages did: a string per segment, looked up level by level
+    while (start < url.size())
+    {
+        size_t end;
+
+        while (start < url.size() && url[start] == '/')
+        {
+            ++start;
+        }
+        end = url.find('/', start);
+        if (end == std::string::npos)
+        {
+            end = url.size();
+        }
+
+        auto it = map->find(url.substr(start, end - start));
+        if (it == map->end())
+        {
+            return false;
+        }
+        if (end == url.size())
+        {
+            return it->second.dynamicPage != nullptr;
+        }
+        if (it->second.next == nullptr)
+        {
+            return false;
+        }
+        map = it->second.next.get();
+        start = end;
+    }
+    return false;
+}
+
+static void insert_in_maps(std::unordered_map<std::string, Level> &root,
+    const std::string &url, awsim::DynamicPage dynamicPage)
+{
+    std::unordered_map<std::string, Level> *map = &root;
+    size_t start = 1;
+
+    while (true)
+    {
+        size_t end = url.find('/', start);
+        Level &level = (*map)[url.substr(start, end == std::string::npos
+            ? std::string::npos : end - start)];
+
+        if (end == std::string::npos)
+        {
+            level.dynamicPage = dynamicPage;
+            return;
+        }
+        if (level.next == nullptr)
+        {
+            level.next =
+                std::make_unique<std::unordered_map<std::string, Level>>();
+        }
+        map = level.next.get();
+        start = end + 1;
+    }
+}
+
+static void page(const awsim::HttpRequest *request, awsim::Client *client)
+{
+    (void)request;
+    (void)client;
+}
+
+template<class Lookup>
+static Result run(const std::vector<std::string> &urls, Lookup lookup)
+{
+    Result result = {0, 0, 0};
+    uint64_t allocationsBefore = allocations;
+    Clock::time_point start = Clock::now();
+
+    for (size_t i = 0; i < LOOKUPS; ++i)
+    {
+        result.found += lookup(urls[i % urls.size()]);
+    }
+    result.nanoseconds = std::chrono::duration<double, std::nano>(
+        Clock::now() - start).count() / LOOKUPS;
+    result.allocations = allocations - allocationsBefore;
+    return result;
+}
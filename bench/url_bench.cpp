@@ -0,0 +1,202 @@
+// Measures normalize_url() of HttpRequest over the URLs browsers, crawlers
+// and scanners send, at each level of vectorized scanning the CPU has,
+// against the check on_url made before it: no two periods in a row, with
+// nothing decoded. Also counts the file cache keys each leaves behind, as
+// spellings of one file that only differ in escapes, slashes or dot
+// segments got an entry each before.
+//
+// Usage: url_bench
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <string.h>
+#include <unordered_set>
+#include <vector>
+
+#include "ByteClass.h"
+#include "HttpRequest.h"
+
+#define PASSES 200000
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Result
+    {
+        double nanoseconds;
+        size_t accepted;
+        size_t keys;
+    };
+}
+
+static std::vector<std::string> generate_urls();
+static bool has_double_period(const std::string &url);
+static Result run_normalize(const std::vector<std::string> &urls);
+static Result run_old(const std::vector<std::string> &urls);
+
+int main()
+{
+    static const struct
+    {
+        awsim::ByteClass::Level level;
+        const char *name;
+    } levels[] = {
+        {awsim::ByteClass::Level::Scalar, "scalar"},
+        {awsim::ByteClass::Level::Ssse3, "SSSE3"},
+        {awsim::ByteClass::Level::Avx2, "AVX2"}
+    };
+    awsim::ByteClass::Level available = awsim::ByteClass::get_level();
+    std::vector<std::string> urls = generate_urls();
+    Result result;
+
+    printf("%zu URLs, %d passes\n\n", urls.size(), PASSES);
+    printf("check            level   ns/url  accepted  cache keys\n");
+    result = run_old(urls);
+    printf("periods (old)    -       %6.1f  %8zu  %10zu\n",
+        result.nanoseconds, result.accepted, result.keys);
+    for (const auto &entry : levels)
+    {
+        if (entry.level > available)
+        {
+            printf("normalize_url    %-6s  not supported by this CPU\n",
+                entry.name);
+            continue;
+        }
+        awsim::ByteClass::set_level(entry.level);
+        result = run_normalize(urls);
+        printf("normalize_url    %-6s  %6.1f  %8zu  %10zu\n", entry.name,
+            result.nanoseconds, result.accepted, result.keys);
+    }
+    return 0;
+}
+
+static std::vector<std::string> generate_urls()
+{
+    static const char *urls[] = {
+        // Pages and their assets
+        "/",
+        "/index.html",
+        "/assets/js/app.3f9a1c2e.js?v=20240611",
+        "/assets/css/site.8d2f0b17.css",
+        "/images/products/2024/espresso-machine-large.webp",
+        "/fonts/inter-var-latin.woff2",
+        "/api/v2/users/1842/orders?page=3&per_page=50&sort=-created_at",
+        "/search?q=caf%C3%A9+cr%C3%A8me&lang=fr#results",
+        "/docs/Getting%20Started/Installing%20on%20Linux.html",
+        "/wiki/%E6%9D%B1%E4%BA%AC%E9%83%BD",
+        // Spellings of the same files
+        "//index.html",
+        "/./index.html",
+        "/assets//css/site.8d2f0b17.css",
+        "/assets/js/../css/site.8d2f0b17.css",
+        "/images/products/2024/espresso%2Dmachine%2Dlarge.webp",
+        "/fonts/./inter-var-latin.woff2",
+        "http://www.example-shop.com/index.html",
+        // Scanners
+        "/../../../../etc/passwd",
+        "/%2e%2e/%2e%2e/etc/passwd",
+        "/static/..%2f..%2fetc/passwd",
+        "/cgi-bin/%2E%2E/%2E%2E/bin/sh",
+        "/index.php%00.html",
+        "/wp-login.php?redirect_to=%2Fwp-admin%2F"
+    };
+
+    return std::vector<std::string>(std::begin(urls), std::end(urls));
+}
+
+// As on_url did before normalize_url()
+static bool has_double_period(const std::string &url)
+{
+    const char *at = url.data();
+    const char *end = at + url.size();
+    const char *period = (const char*)memchr(at, '.', end - at);
+
+    while (period != nullptr && period + 1 < end)
+    {
+        if (period[1] == '.')
+        {
+            return true;
+        }
+        period = (const char*)memchr(period + 1, '.', end - period - 1);
+    }
+    return false;
+}
+
+static Result run_normalize(const std::vector<std::string> &urls)
+{
+    static awsim::HttpRequest request;
+    Result result = {0, 0, 0};
+    std::unordered_set<std::string> keys;
+    size_t accepted = 0;
+    Clock::time_point start;
+
+    for (const std::string &url : urls)
+    {
+        request.clear();
+        request.url.buffer = url.data();
+        request.url.length = url.size();
+        request.url.set = true;
+        if (request.normalize_url())
+        {
+            keys.emplace(request.path.buffer, request.path.length);
+            result.accepted++;
+        }
+    }
+    result.keys = keys.size();
+
+    start = Clock::now();
+    for (int pass = 0; pass < PASSES; ++pass)
+    {
+        for (const std::string &url : urls)
+        {
+            request.url.buffer = url.data();
+            request.url.length = url.size();
+            accepted += request.normalize_url();
+        }
+    }
+    result.nanoseconds = std::chrono::duration<double, std::nano>(
+        Clock::now() - start).count() / ((double)PASSES * urls.size());
+    if (accepted != result.accepted * PASSES)
+    {
+        fprintf(stderr, "normalize_url() is not deterministic\n");
+    }
+    return result;
+}
+
+static Result run_old(const std::vector<std::string> &urls)
+{
+    Result result = {0, 0, 0};
+    std::unordered_set<std::string> keys;
+    size_t accepted = 0;
+    Clock::time_point start;
+
+    for (const std::string &url : urls)
+    {
+        if (!has_double_period(url))
+        {
+            // The cache was keyed by the whole URL
+            keys.insert(url);
+            result.accepted++;
+        }
+    }
+    result.keys = keys.size();
+
+    start = Clock::now();
+    for (int pass = 0; pass < PASSES; ++pass)
+    {
+        for (const std::string &url : urls)
+        {
+            accepted += !has_double_period(url);
+        }
+    }
+    result.nanoseconds = std::chrono::duration<double, std::nano>(
+        Clock::now() - start).count() / ((double)PASSES * urls.size());
+    if (accepted != result.accepted * PASSES)
+    {
+        fprintf(stderr, "The check is not deterministic\n");
+    }
+    return result;
+}
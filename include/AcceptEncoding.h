@@ -0,0 +1 @@
+../src/AcceptEncoding.h
\ No newline at end of file
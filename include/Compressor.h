@@ -0,0 +1 @@
+../src/Compressor.h
\ No newline at end of file
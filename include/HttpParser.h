@@ -0,0 +1 @@
+../src/HttpParser.h
\ No newline at end of file
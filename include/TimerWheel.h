@@ -0,0 +1 @@
+../src/TimerWheel.h
\ No newline at end of file
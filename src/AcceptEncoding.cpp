@@ -0,0 +1,114 @@
+#include "AcceptEncoding.h"
+
+awsim::AcceptEncoding::AcceptEncoding(
+    const HttpRequest::Value &acceptEncoding) :
+    qualities{-1, -1, -1, -1},
+    wildcard(-1)
+{
+    static const struct
+    {
+        const char *name;
+        Coding coding;
+    } codings[] = {
+        {"br", Coding::Brotli},
+        {"zstd", Coding::Zstd},
+        {"gzip", Coding::Gzip},
+        {"x-gzip", Coding::Gzip},
+        {"deflate", Coding::Deflate}
+    };
+    const char *it = acceptEncoding.buffer;
+    const char *end = acceptEncoding.set ? it + acceptEncoding.length : it;
+
+    // Accept-Encoding: gzip, br;q=0.9, zstd;q=0, *;q=0.1
+    while (it < end)
+    {
+        const char *name;
+        size_t nameLength;
+        int quality = 1000;
+
+        while (it < end && (*it == ' ' || *it == '\t' || *it == ','))
+        {
+            ++it;
+        }
+        name = it;
+        while (it < end && *it != ',' && *it != ';' && *it != ' '
+            && *it != '\t')
+        {
+            ++it;
+        }
+        nameLength = it - name;
+        // Of the parameters only q means anything
+        while (it < end && *it != ',')
+        {
+            if (*it == ';')
+            {
+                ++it;
+                while (it < end && (*it == ' ' || *it == '\t'))
+                {
+                    ++it;
+                }
+                if (end - it > 2 && (*it == 'q' || *it == 'Q')
+                    && it[1] == '=')
+                {
+                    it += 2;
+                    quality = parse_quality(it, end);
+                    continue;
+                }
+            }
+            ++it;
+        }
+        if (nameLength == 0)
+        {
+            continue;
+        }
+
+        if (nameLength == 1 && *name == '*')
+        {
+            wildcard = quality;
+            continue;
+        }
+        for (const auto &coding : codings)
+        {
+            if (strlen(coding.name) == nameLength
+                && strncasecmp(coding.name, name, nameLength) == 0)
+            {
+                qualities[(int)coding.coding] = std::max(
+                    qualities[(int)coding.coding], quality);
+            }
+        }
+    }
+}
+
+int awsim::AcceptEncoding::get_quality(Coding coding) const
+{
+    int quality = qualities[(int)coding];
+
+    if (quality == -1)
+    {
+        quality = wildcard;
+    }
+    return quality == -1 ? 0 : quality;
+}
+
+int awsim::AcceptEncoding::parse_quality(const char *&it, const char *end)
+{
+    int quality = 0;
+    int scale = 100;
+
+    if (it < end && *it >= '0' && *it <= '9')
+    {
+        quality = (*it - '0') * 1000;
+        ++it;
+    }
+    if (it < end && *it == '.')
+    {
+        ++it;
+        while (it < end && *it >= '0' && *it <= '9')
+        {
+            quality += (*it - '0') * scale;
+            scale /= 10;
+            ++it;
+        }
+    }
+    return std::min(quality, 1000);
+}
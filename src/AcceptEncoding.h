@@ -0,0 +1,42 @@
+#ifndef AWSIM_ACCEPTENCODING_H
+#define AWSIM_ACCEPTENCODING_H
+
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "HttpRequest.h"
+
+namespace awsim
+{
+    // The qualities an Accept-Encoding header gives to the content codings
+    // that can be sent, in thousandths (q=0.5 is 500). A coding that is not
+    // named gets the quality of "*", and 0 when that is missing too.
+    class AcceptEncoding
+    {
+    public:
+        enum class Coding : uint8_t
+        {
+            Brotli,
+            Zstd,
+            Gzip,
+            Deflate
+        };
+
+        static const uint8_t NUMBER_OF_CODINGS = 4;
+
+        AcceptEncoding(const HttpRequest::Value &acceptEncoding);
+
+        int get_quality(Coding coding) const;
+    private:
+        // -1 while the coding is not named
+        int qualities[NUMBER_OF_CODINGS];
+        int wildcard;
+
+        // Parses the value of a q parameter ("1", "0.5", "0.125")
+        static int parse_quality(const char *&it, const char *end);
+    };
+}
+
+#endif
@@ -0,0 +1,159 @@
+#include "ByteClass.h"
+
+awsim::ByteClass::Level awsim::ByteClass::level = detect_level();
+
+awsim::ByteClass::ByteClass(bool (*contains)(uint8_t byte)) :
+    vectorizable(true)
+{
+    uint16_t rows[16] = {0};
+    uint16_t patterns[8];
+    int numberOfPatterns = 0;
+
+    for (int byte = 0; byte < 256; ++byte)
+    {
+        table[byte] = contains(byte);
+        if (table[byte])
+        {
+            rows[byte >> 4] |= 1 << (byte & 0x0f);
+        }
+    }
+
+    memset(low, 0, sizeof(low));
+    memset(high, 0, sizeof(high));
+    for (int row = 0; row < 16 && vectorizable; ++row)
+    {
+        int pattern = 0;
+
+        if (rows[row] == 0)
+        {
+            continue;
+        }
+        while (pattern < numberOfPatterns && patterns[pattern] != rows[row])
+        {
+            ++pattern;
+        }
+        if (pattern == numberOfPatterns)
+        {
+            if (numberOfPatterns == 8)
+            {
+                vectorizable = false;
+                break;
+            }
+            patterns[numberOfPatterns++] = rows[row];
+        }
+        high[row] = 1 << pattern;
+        high[row + 16] = high[row];
+    }
+    for (int pattern = 0; pattern < numberOfPatterns; ++pattern)
+    {
+        for (int nibble = 0; nibble < 16; ++nibble)
+        {
+            if (patterns[pattern] & (1 << nibble))
+            {
+                low[nibble] |= 1 << pattern;
+                low[nibble + 16] = low[nibble];
+            }
+        }
+    }
+}
+
+awsim::ByteClass::Level awsim::ByteClass::detect_level()
+{
+    #if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return Level::Avx2;
+        }
+        if (__builtin_cpu_supports("ssse3"))
+        {
+            return Level::Ssse3;
+        }
+    #endif
+    return Level::Scalar;
+}
+
+const char* awsim::ByteClass::find(const char *it, const char *end) const
+{
+    #if defined(__x86_64__) || defined(__i386__)
+        if (vectorizable && level == Level::Avx2)
+        {
+            it = find_avx2(it, end);
+        }
+        else if (vectorizable && level == Level::Ssse3)
+        {
+            it = find_ssse3(it, end);
+        }
+    #endif
+    // What is left is shorter than a register, or the byte was found
+    while (it < end && !table[(uint8_t)*it])
+    {
+        ++it;
+    }
+    return it;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+const char* awsim::ByteClass::find_avx2(const char *it, const char *end) const
+{
+    const __m256i lowTable = _mm256_load_si256((const __m256i*)low);
+    const __m256i highTable = _mm256_load_si256((const __m256i*)high);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+    for (; end - it >= 32; it += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)it);
+        __m256i lowBits = _mm256_shuffle_epi8(lowTable,
+            _mm256_and_si256(bytes, nibble));
+        __m256i highBits = _mm256_shuffle_epi8(highTable,
+            _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+        uint32_t outside = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_and_si256(lowBits, highBits), _mm256_setzero_si256()));
+
+        if (outside != UINT32_MAX)
+        {
+            return it + __builtin_ctz(~outside);
+        }
+    }
+    return it;
+}
+
+__attribute__((target("ssse3")))
+const char* awsim::ByteClass::find_ssse3(const char *it, const char *end)
+    const
+{
+    const __m128i lowTable = _mm_load_si128((const __m128i*)low);
+    const __m128i highTable = _mm_load_si128((const __m128i*)high);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+
+    for (; end - it >= 16; it += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)it);
+        __m128i lowBits = _mm_shuffle_epi8(lowTable,
+            _mm_and_si128(bytes, nibble));
+        __m128i highBits = _mm_shuffle_epi8(highTable,
+            _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+        uint32_t outside = _mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_and_si128(lowBits, highBits), _mm_setzero_si128()));
+
+        if (outside != 0xffff)
+        {
+            return it + __builtin_ctz(~outside);
+        }
+    }
+    return it;
+}
+#endif
+
+awsim::ByteClass::Level awsim::ByteClass::get_level()
+{
+    return level;
+}
+
+void awsim::ByteClass::set_level(Level level)
+{
+    Level detected = detect_level();
+
+    ByteClass::level = level < detected ? level : detected;
+}
@@ -0,0 +1,60 @@
+#ifndef AWSIM_BYTECLASS_H
+#define AWSIM_BYTECLASS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace awsim
+{
+    // A set of byte values, and the search for the first byte of a buffer
+    // in it, which is how the parser skips over the bytes of a header or
+    // URL that need no look. The set is split into a table for the low
+    // nibble of a byte and one for the high nibble, so that 16 or 32 bytes
+    // are classified at once with two shuffles, using SSSE3 or AVX2 as the
+    // CPU has them. Other CPUs, and sets that do not split, go a byte at a
+    // time.
+    class ByteClass
+    {
+    public:
+        enum class Level : uint8_t
+        {
+            Scalar,
+            Ssse3,
+            Avx2
+        };
+
+        // contains says which of the 256 values are in the set
+        explicit ByteClass(bool (*contains)(uint8_t byte));
+
+        // The first byte from it on that is in the set, or end
+        const char* find(const char *it, const char *end) const;
+        static Level get_level();
+        // Caps the level of all searches below what the CPU has, for
+        // benchmarks
+        static void set_level(Level level);
+
+    private:
+        // Bit i of low[n] is set when the i-th row pattern has low nibble
+        // n, high[h] has the bit of the pattern of row h. Repeated for both
+        // halves of an AVX2 register.
+        alignas(32) uint8_t low[32];
+        alignas(32) uint8_t high[32];
+        bool table[256];
+        // At most eight row patterns fit in a byte
+        bool vectorizable;
+
+        static Level level;
+
+        static Level detect_level();
+        #if defined(__x86_64__) || defined(__i386__)
+            const char* find_avx2(const char *it, const char *end) const;
+            const char* find_ssse3(const char *it, const char *end) const;
+        #endif
+    };
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include "ByteRanges.h"
+
+awsim::ByteRanges::ByteRanges(const HttpRequest::Value &range,
+    uint64_t size) :
+    bounds{0, 0},
+    count(0),
+    status(Status::Ignored),
+    truncated(false)
+{
+    const char *it = range.buffer;
+    const char *end = it + range.length;
+    uint64_t parsed = 0;
+
+    if (!range.set || range.length < sizeof("bytes=") - 1
+        || strncasecmp(it, "bytes=", sizeof("bytes=") - 1) != 0)
+    {
+        return;
+    }
+    it += sizeof("bytes=") - 1;
+
+    while (it < end)
+    {
+        Range current;
+
+        while (it < end && (*it == ' ' || *it == '\t' || *it == ','))
+        {
+            ++it;
+        }
+        if (it == end)
+        {
+            break;
+        }
+        if (*it == '-')
+        {
+            uint64_t length;
+
+            // The last length bytes
+            ++it;
+            if (!parse_number(it, end, length))
+            {
+                return;
+            }
+            current.first = length < size ? size - length : 0;
+            current.last = size - 1;
+            if (length == 0 || size == 0)
+            {
+                current.first = size;
+            }
+        }
+        else
+        {
+            if (!parse_number(it, end, current.first) || it == end
+                || *it != '-')
+            {
+                return;
+            }
+            ++it;
+            current.last = UINT64_MAX;
+            if (it < end && *it >= '0' && *it <= '9'
+                && (!parse_number(it, end, current.last)
+                || current.last < current.first))
+            {
+                return;
+            }
+        }
+        while (it < end && (*it == ' ' || *it == '\t'))
+        {
+            ++it;
+        }
+        if (it < end && *it != ',')
+        {
+            return;
+        }
+
+        parsed++;
+        if (current.first >= size)
+        {
+            continue;
+        }
+        current.last = std::min(current.last, size - 1);
+        if (count == 0)
+        {
+            bounds = current;
+        }
+        else
+        {
+            bounds.first = std::min(bounds.first, current.first);
+            bounds.last = std::max(bounds.last, current.last);
+        }
+        if (count < MAX_RANGES)
+        {
+            ranges[count++] = current;
+        }
+        else
+        {
+            truncated = true;
+        }
+    }
+
+    if (parsed == 0)
+    {
+        return;
+    }
+    status = count == 0 ? Status::NotSatisfiable : Status::Satisfiable;
+}
+
+const awsim::ByteRanges::Range& awsim::ByteRanges::get(uint8_t i) const
+{
+    return ranges[i];
+}
+
+awsim::ByteRanges::Range awsim::ByteRanges::get_bounds() const
+{
+    return bounds;
+}
+
+uint8_t awsim::ByteRanges::get_count() const
+{
+    return count;
+}
+
+awsim::ByteRanges::Status awsim::ByteRanges::get_status() const
+{
+    return status;
+}
+
+bool awsim::ByteRanges::is_truncated() const
+{
+    return truncated;
+}
+
+bool awsim::ByteRanges::parse_number(const char *&it, const char *end,
+    uint64_t &number)
+{
+    const char *start = it;
+
+    number = 0;
+    while (it < end && *it >= '0' && *it <= '9')
+    {
+        if (number > (UINT64_MAX - (*it - '0')) / 10)
+        {
+            return false;
+        }
+        number = number * 10 + (*it - '0');
+        ++it;
+    }
+    return it != start;
+}
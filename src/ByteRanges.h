@@ -0,0 +1,62 @@
+#ifndef AWSIM_BYTERANGES_H
+#define AWSIM_BYTERANGES_H
+
+#include <algorithm>
+#include <stdint.h>
+#include <strings.h>
+
+#include "HttpRequest.h"
+
+namespace awsim
+{
+    // The ranges a Range header asks for ("bytes=0-499, 1000-, -500"),
+    // resolved against the size of the representation. Ranges that start
+    // past the end are dropped, and the ones that end past it are cut
+    // short.
+    class ByteRanges
+    {
+    public:
+        // More ranges than this are only answered as one range covering
+        // all of them, which keeps hostile headers from multiplying the
+        // work of a response
+        static const uint8_t MAX_RANGES = 16;
+
+        enum class Status
+        {
+            // Malformed or not in bytes, the header is ignored
+            Ignored,
+            Satisfiable,
+            NotSatisfiable
+        };
+
+        struct Range
+        {
+            uint64_t first;
+            uint64_t last;
+        };
+
+        ByteRanges(const HttpRequest::Value &range, uint64_t size);
+
+        // Only set while the status is Satisfiable
+        const Range& get(uint8_t i) const;
+        // The smallest range that covers all of them
+        Range get_bounds() const;
+        uint8_t get_count() const;
+        Status get_status() const;
+        // Whether there were more than MAX_RANGES
+        bool is_truncated() const;
+    private:
+        Range ranges[MAX_RANGES];
+        Range bounds;
+        uint8_t count;
+        Status status;
+        bool truncated;
+
+        // Parses the digits at it, returns false if there are none or they
+        // do not fit
+        static bool parse_number(const char *&it, const char *end,
+            uint64_t &number);
+    };
+}
+
+#endif
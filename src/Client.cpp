@@ -1,8 +1,212 @@
 #include "Client.h"
 
+void awsim::Client::discard_output()
+{
+   if (fileFd != -1)
+   {
+      close(fileFd);
+      fileFd = -1;
+   }
+   writeLength = 0;
+   writeOffset = 0;
+   fileOffset = 0;
+   fileRemaining = 0;
+}
+
+bool awsim::Client::flush()
+{
+   while (writeOffset < writeLength)
+   {
+      ssize_t sent = send(sock, writeBuffer + writeOffset,
+         writeLength - writeOffset,
+         MSG_NOSIGNAL | (fileRemaining > 0 ? MSG_MORE : 0));
+      if (sent == -1)
+      {
+         if (errno == EAGAIN || errno == EWOULDBLOCK)
+         {
+            return false;
+         }
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         throw std::runtime_error("send(" + std::to_string(sock)
+            + ", writeBuffer + " + std::to_string(writeOffset) + ", "
+            + std::to_string(writeLength - writeOffset)
+            + ", MSG_NOSIGNAL) failed -> " + strerror(errno));
+      }
+      writeOffset += sent;
+   }
+   writeLength = 0;
+   writeOffset = 0;
+
+   while (fileRemaining > 0)
+   {
+      ssize_t sent = sendfile(sock, fileFd, &fileOffset, fileRemaining);
+      if (sent == -1)
+      {
+         if (errno == EAGAIN || errno == EWOULDBLOCK)
+         {
+            return false;
+         }
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         throw std::runtime_error("sendfile(" + std::to_string(sock) + ", "
+            + std::to_string(fileFd) + ", &fileOffset, "
+            + std::to_string(fileRemaining) + ") failed -> "
+            + strerror(errno));
+      }
+      if (sent == 0)
+      {
+         throw std::runtime_error("File " + std::to_string(fileFd)
+            + " ended " + std::to_string(fileRemaining)
+            + " bytes before the promised length");
+      }
+      fileRemaining -= sent;
+   }
+   if (fileFd != -1)
+   {
+      close(fileFd);
+      fileFd = -1;
+   }
+
+   return true;
+}
+
+bool awsim::Client::has_pending_output() const
+{
+   return writeOffset < writeLength || fileRemaining > 0;
+}
+
 void awsim::Client::init(int clientSocket, bool https)
 {
    this->https = https;
    this->sock = clientSocket;
+   readLength = 0;
+   parsedLength = 0;
+   requestsServed = 0;
+   writeLength = 0;
+   writeOffset = 0;
+   fileFd = -1;
+   fileOffset = 0;
+   fileRemaining = 0;
+   waitingForWrite = false;
+   receiving = false;
+   receiveCancelled = false;
+   sendPending = false;
+   pendingOutputs = 0;
+   overflowLength = 0;
+   splicePipe[0] = -1;
+   splicePipe[1] = -1;
+   pipeLength = 0;
+   reset_request();
    allocated = true;
 }
+
+void awsim::Client::queue(const void *data, size_t length)
+{
+   if (fileFd != -1)
+   {
+      throw std::runtime_error("Cannot queue data behind a file body");
+   }
+   reserve(length);
+   memcpy(writeBuffer + writeLength, data, length);
+   writeLength += length;
+}
+
+void awsim::Client::queue_file(int fd, off_t offset, size_t length)
+{
+   if (fileFd != -1)
+   {
+      close(fd);
+      throw std::runtime_error("A file body is already queued");
+   }
+   fileFd = fd;
+   fileOffset = offset;
+   fileRemaining = length;
+}
+
+void awsim::Client::queue_from_file(int fd, off_t offset, size_t length)
+{
+   size_t done = 0;
+
+   if (fileFd != -1)
+   {
+      throw std::runtime_error("Cannot queue data behind a file body");
+   }
+   reserve(length);
+   while (done < length)
+   {
+      ssize_t count = pread(fd, writeBuffer + writeLength + done,
+         length - done, offset + done);
+      if (count == -1 && errno == EINTR)
+      {
+         continue;
+      }
+      if (count <= 0)
+      {
+         throw std::runtime_error("pread(" + std::to_string(fd)
+            + ", writeBuffer, " + std::to_string(length - done) + ", "
+            + std::to_string(offset + done) + ") failed -> "
+            + (count == 0 ? "File shrank" : strerror(errno)));
+      }
+      done += count;
+   }
+   writeLength += length;
+}
+
+void awsim::Client::release_write_buffer()
+{
+   if (writeCapacity > WRITE_BUFFER_KEPT_SIZE)
+   {
+      free(writeBuffer);
+      writeBuffer = nullptr;
+      writeCapacity = 0;
+   }
+}
+
+void awsim::Client::reserve(size_t length)
+{
+   if (writeLength + length > writeCapacity)
+   {
+      size_t capacity = writeCapacity == 0 ? 4096 : writeCapacity;
+      char *tmp;
+
+      while (capacity < writeLength + length)
+      {
+         capacity *= 2;
+      }
+      tmp = (char*)realloc(writeBuffer, capacity);
+      if (tmp == nullptr)
+      {
+         throw std::runtime_error("realloc(writeBuffer, "
+            + std::to_string(capacity) + ") failed -> "
+            + strerror(errno));
+      }
+      writeBuffer = tmp;
+      writeCapacity = capacity;
+   }
+}
+
+void awsim::Client::reset_request()
+{
+   if (request.bodyFd != -1)
+   {
+      close(request.bodyFd);
+   }
+   request.clear();
+   headerField = HttpRequest::Value();
+   headerValue = nullptr;
+   bodyHandling = BodyHandling::Discard;
+   bodyHandler = nullptr;
+   bodyRoutingEpoch = 0;
+   bodyEnd = 0;
+   bodyLength = 0;
+   spoolRemaining = 0;
+   bodyTooLarge = false;
+   requestComplete = false;
+   headersComplete = false;
+   keepAlive = false;
+}
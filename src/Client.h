@@ -1,18 +1,165 @@
 #ifndef AWSIM_CLIENT_H
 #define AWSIM_CLIENT_H
 
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "DynamicPage.h"
+#include "HttpParser.h"
+#include "HttpRequest.h"
+#include "TimerWheel.h"
+
 namespace awsim
 {
-    class Client
+    class Compressor;
+
+    // Clients live in the fixed-size chunks of a worker's slab and never
+    // move once allocated. Slots are cache line aligned, and the fields
+    // that every event or completion of a connection touches come first so
+    // that they share the first lines of the slot. The cold part (list
+    // links, the parsed request and the io_uring bookkeeping that is only
+    // needed to set up or tear down output) starts on a line of its own.
+    class alignas(64) Client
     {
     public:
+        static const size_t READ_BUFFER_SIZE = 8192;
+        // writeBuffer grows to hold a whole response with its body. Past
+        // this capacity it is let go once the response is out, so that a
+        // large body does not keep its memory for as long as the slot lives.
+        static const size_t WRITE_BUFFER_KEPT_SIZE = 65536;
+
+        enum class BodyHandling : uint8_t
+        {
+            // Kept in readBuffer for a dynamic page without a body handler
+            Gather,
+            // A gathered body that filled readBuffer, moved to
+            // request.bodyFd. The rest is written there by the parser as it
+            // decodes it, so chunked bodies take this way as well.
+            SpoolParsed,
+            // Handed to the body handler of a dynamic page as it arrives
+            Stream,
+            // Written to request.bodyFd, for long bodies of dynamic pages
+            // without a body handler. The parser skips it, the worker moves
+            // it out of the socket once the header is parsed.
+            Spool,
+            // Read and dropped, as nothing but a dynamic page takes a body
+            Discard
+        };
+
+        int sock;
+        // Position in the worker's slab, which the io_uring backend refers
+        // to clients by
+        uint32_t index;
         bool allocated;
         bool https;
-        int sock;
-        Client *next;
+        bool requestComplete;
+        // Set once the header of the current request has been parsed,
+        // whatever is still in readBuffer belongs to its body
+        bool headersComplete;
+        // Whether the connection stays open after the current response
+        bool keepAlive;
+
+        // Output that the socket did not take yet. The queued bytes go out
+        // first, then fileRemaining bytes of fileFd starting at fileOffset.
+        // The worker waits for EPOLLOUT instead of EPOLLIN while
+        // waitingForWrite is set.
+        bool waitingForWrite;
+        int fileFd;
+        char *writeBuffer;
+        size_t writeLength;
+        size_t writeOffset;
+        off_t fileOffset;
+        size_t fileRemaining;
+
+        // Parser state survives between reads. The slices in request point
+        // into readBuffer, which is only compacted once the request has been
+        // answered, so they stay valid without being copied.
+        char *readBuffer;
+        size_t readLength;
+        size_t parsedLength;
+        HttpParser parser;
+
+        // The deadline (header, idle or write) the connection is waiting on
+        TimerWheel::Timer timer;
+
+        // Only used by the io_uring backend, where sock is an index into the
+        // ring's table of direct descriptors. generation tells completions
+        // for an earlier connection in the same slot apart.
+        uint32_t generation;
+        bool receiving;
+        bool receiveCancelled;
+        bool sendPending;
+        uint8_t pendingOutputs;
+
+        alignas(64) Client *next;
         Client *prev;
 
+        HttpRequest request;
+        HttpRequest::Value headerField;
+        // Where the value of the current header goes, nullptr when the
+        // header is dropped
+        HttpRequest::Value *headerValue;
+        // What happens to the body of the current request, decided once its
+        // header is parsed. A gathered body is moved together right behind
+        // the header, up to bodyEnd. Otherwise bodyEnd stays where the body
+        // started. Everything parsed past bodyEnd is dropped from
+        // readBuffer after each read. A gathered body that fills readBuffer
+        // goes on to a file, see BodyHandling::SpoolParsed.
+        BodyHandling bodyHandling;
+        DynamicPageBody bodyHandler;
+        // The epoch of the snapshot bodyHandler was found in, see Routing.
+        // The page is unloaded along with the snapshot.
+        uint64_t bodyRoutingEpoch;
+        size_t bodyEnd;
+        // Decoded so far, without the framing of chunks. For a spooled body
+        // the length written to request.bodyFd, with spoolRemaining to go.
+        uint64_t bodyLength;
+        uint64_t spoolRemaining;
+        bool bodyTooLarge;
+        uint64_t requestsServed;
+        size_t writeCapacity;
+        // Compresses the bodies of responses, nullptr while compression is
+        // turned off
+        Compressor *compressor;
+
+        // Data the io_uring backend received while a response is going out,
+        // or that does not fit in readBuffer, waits in overflowBuffer. File
+        // bodies are spliced through splicePipe, which holds pipeLength
+        // bytes of them.
+        char *overflowBuffer;
+        size_t overflowCapacity;
+        size_t overflowLength;
+        int splicePipe[2];
+        size_t pipeLength;
+
+        // Drops the output of a response that failed halfway through being
+        // queued, so that an error response can take its place
+        void discard_output();
+        // Sends as much of the queued output as the socket takes without
+        // blocking. Returns true once everything has been sent.
+        bool flush();
+        bool has_pending_output() const;
         void init(int clientSocket, bool https);
+        void queue(const void *data, size_t length);
+        // Takes ownership of fd, it is closed once the body has been sent
+        void queue_file(int fd, off_t offset, size_t length);
+        // Reads length bytes of fd at offset into the queued output
+        void queue_from_file(int fd, off_t offset, size_t length);
+        // Frees writeBuffer when it grew past WRITE_BUFFER_KEPT_SIZE. Only
+        // once nothing is queued and no send is reading from it.
+        void release_write_buffer();
+        // Makes room for length more bytes behind the queued output
+        void reserve(size_t length);
+        void reset_request();
     };
 }
 
@@ -0,0 +1,233 @@
+#include "Compressor.h"
+
+awsim::Compressor::Compressor() :
+    initialized{false, false},
+    streamLevels{0, 0},
+    level(IDLE_LEVEL),
+    busy(0),
+    idle(0),
+    outputLength(0),
+    stats()
+{
+
+}
+
+awsim::Compressor::~Compressor()
+{
+    clear();
+}
+
+std::string awsim::Compressor::Stats::to_string() const
+{
+    return std::to_string(compressed) + " responses compressed from "
+        + std::to_string(bytesIn) + " to " + std::to_string(bytesOut)
+        + " bytes in " + std::to_string(nanoseconds / 1000) + " us, "
+        + std::to_string(notSmaller) + " not smaller";
+}
+
+bool awsim::Compressor::choose_format(const AcceptEncoding &accepted,
+    Format &format)
+{
+    int gzip = accepted.get_quality(AcceptEncoding::Coding::Gzip);
+    int deflate = accepted.get_quality(AcceptEncoding::Coding::Deflate);
+
+    // Some old clients took deflate for raw deflate, so gzip wins ties
+    if (gzip > 0 && gzip >= deflate)
+    {
+        format = Format::Gzip;
+        return true;
+    }
+    if (deflate > 0)
+    {
+        format = Format::Deflate;
+        return true;
+    }
+    return false;
+}
+
+void awsim::Compressor::clear()
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        if (initialized[i])
+        {
+            deflateEnd(&streams[i]);
+            initialized[i] = false;
+        }
+    }
+    output.clear();
+    output.shrink_to_fit();
+    outputLength = 0;
+}
+
+bool awsim::Compressor::compress(Format format, const void *data,
+    size_t length)
+{
+    z_stream &stream = streams[(int)format];
+    uint64_t start = get_nanoseconds();
+    size_t bound;
+    int result;
+
+    // zlib counts in 32 bits
+    if (length > UINT32_MAX)
+    {
+        return false;
+    }
+    if (!initialized[(int)format])
+    {
+        memset(&stream, 0, sizeof(stream));
+        // 16 on top of the window bits asks for a gzip header and trailer.
+        // Without them the stream is zlib wrapped, which is what deflate
+        // means in HTTP.
+        result = deflateInit2(&stream, level, Z_DEFLATED,
+            format == Format::Gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY);
+        if (result != Z_OK)
+        {
+            throw std::runtime_error("deflateInit2(...) failed -> "
+                + std::to_string(result));
+        }
+        initialized[(int)format] = true;
+        streamLevels[(int)format] = level;
+    }
+    else if (streamLevels[(int)format] != level)
+    {
+        // Nothing has gone in since the last reset, so there is nothing to
+        // flush at the old level
+        result = deflateParams(&stream, level, Z_DEFAULT_STRATEGY);
+        if (result != Z_OK)
+        {
+            throw std::runtime_error("deflateParams(&stream, "
+                + std::to_string(level) + ", Z_DEFAULT_STRATEGY) failed -> "
+                + std::to_string(result));
+        }
+        streamLevels[(int)format] = level;
+    }
+
+    bound = deflateBound(&stream, length);
+    if (output.size() < bound)
+    {
+        output.resize(bound);
+    }
+    stream.next_in = (Bytef*)data;
+    stream.avail_in = length;
+    stream.next_out = (Bytef*)&output[0];
+    stream.avail_out = output.size();
+    result = deflate(&stream, Z_FINISH);
+    outputLength = stream.total_out;
+    deflateReset(&stream);
+    if (result != Z_STREAM_END)
+    {
+        throw std::runtime_error("deflate(&stream, Z_FINISH) failed -> "
+            + std::to_string(result));
+    }
+
+    stats.nanoseconds += get_nanoseconds() - start;
+    if (outputLength >= length)
+    {
+        stats.notSmaller++;
+        return false;
+    }
+    stats.compressed++;
+    stats.bytesIn += length;
+    stats.bytesOut += outputLength;
+    return true;
+}
+
+int awsim::Compressor::get_level() const
+{
+    return level;
+}
+
+uint64_t awsim::Compressor::get_nanoseconds()
+{
+    timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+const char* awsim::Compressor::get_output() const
+{
+    return output.data();
+}
+
+size_t awsim::Compressor::get_output_length() const
+{
+    return outputLength;
+}
+
+const awsim::Compressor::Stats& awsim::Compressor::get_stats() const
+{
+    return stats;
+}
+
+void awsim::Compressor::init()
+{
+    clear();
+    level = IDLE_LEVEL;
+    busy = 0;
+    idle = 0;
+    stats = Stats();
+}
+
+bool awsim::Compressor::is_compressible(const char *path)
+{
+    static const char *skipped[] = {
+        ".7z", ".avif", ".br", ".bz2", ".gif", ".gz", ".jpeg", ".jpg",
+        ".mp3", ".mp4", ".ogg", ".png", ".webm", ".webp", ".woff", ".woff2",
+        ".xz", ".zip", ".zst"
+    };
+    size_t pathLength = strlen(path);
+
+    for (const char *suffix : skipped)
+    {
+        size_t suffixLength = strlen(suffix);
+
+        if (pathLength >= suffixLength
+            && strcasecmp(path + pathLength - suffixLength, suffix) == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void awsim::Compressor::record_load(uint64_t busyNanoseconds,
+    uint64_t idleNanoseconds)
+{
+    // Levels by the share of the window the worker was busy, in percent
+    static const struct
+    {
+        uint64_t load;
+        int level;
+    } levels[] = {
+        {50, IDLE_LEVEL},
+        {75, 4},
+        {90, 2},
+        {100, 1}
+    };
+    uint64_t load;
+
+    busy += busyNanoseconds;
+    idle += idleNanoseconds;
+    if (busy + idle < LOAD_WINDOW_NANOSECONDS)
+    {
+        return;
+    }
+    load = busy * 100 / (busy + idle);
+    for (const auto &entry : levels)
+    {
+        if (load < entry.load || entry.load == 100)
+        {
+            level = entry.level;
+            break;
+        }
+    }
+    busy = 0;
+    idle = 0;
+}
+
+void awsim::Compressor::set_level(int level)
+{
+    this->level = level;
+}
@@ -0,0 +1,95 @@
+#ifndef AWSIM_COMPRESSOR_H
+#define AWSIM_COMPRESSOR_H
+
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <zlib.h>
+
+#include "AcceptEncoding.h"
+
+namespace awsim
+{
+    // Compresses response bodies for one worker on the fly. A body is
+    // compressed in one go while its response is queued, so the worker never
+    // needs more than one deflate context per format. The contexts are set
+    // up on first use and only reset between responses, and the output
+    // buffer is kept at the size of the largest body so far, so compressing
+    // a response allocates nothing.
+    //
+    // The level follows the load of the worker, measured as the share of
+    // time it spends handling events rather than waiting for them: an idle
+    // worker spends more CPU for smaller bodies, a saturated one the least.
+    class Compressor
+    {
+    public:
+        enum class Format : uint8_t
+        {
+            Gzip,
+            Deflate
+        };
+
+        // Bodies smaller than this hardly shrink and are sent as they are
+        static const size_t MINIMUM_SIZE = 256;
+        // Level while the worker is mostly waiting, zlib's default
+        static const int IDLE_LEVEL = 6;
+        static const uint64_t LOAD_WINDOW_NANOSECONDS = 100000000;
+
+        // Logged when the worker stops
+        struct Stats
+        {
+            uint64_t compressed;
+            uint64_t notSmaller;
+            uint64_t bytesIn;
+            uint64_t bytesOut;
+            uint64_t nanoseconds;
+
+            std::string to_string() const;
+        };
+
+        Compressor();
+        ~Compressor();
+
+        // Picks the format a client that sent accepted gets, returns false
+        // when it takes neither
+        static bool choose_format(const AcceptEncoding &accepted,
+            Format &format);
+        void clear();
+        // Compresses length bytes of data. Returns false, and leaves the
+        // body to be sent as it is, when the result is not smaller.
+        // Otherwise the result stays in get_output() until the next call.
+        bool compress(Format format, const void *data, size_t length);
+        int get_level() const;
+        const char* get_output() const;
+        size_t get_output_length() const;
+        const Stats& get_stats() const;
+        void init();
+        // Whether a file is worth compressing judging by its name, which
+        // rules out formats that are compressed already
+        static bool is_compressible(const char *path);
+        // Adds the time spent handling events and waiting for them since
+        // the last call, and adapts the level once per window
+        void record_load(uint64_t busyNanoseconds, uint64_t idleNanoseconds);
+        // Pins the level until the next window ends, for benchmarks
+        void set_level(int level);
+
+    private:
+        z_stream streams[2];
+        bool initialized[2];
+        // Level each context was last set to
+        int streamLevels[2];
+        int level;
+        uint64_t busy;
+        uint64_t idle;
+        std::string output;
+        size_t outputLength;
+        Stats stats;
+
+        static uint64_t get_nanoseconds();
+    };
+}
+
+#endif
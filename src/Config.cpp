@@ -47,6 +47,18 @@ awsim::Config::Config(const std::string &filePath)
             + filePath + "\" -> " + ex.what());
     }
 
+    try
+    {
+        json_check_existance(document, "compression");
+        compression = json_get_bool(document["compression"]);
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(
+            std::string("Failed to get \"compression\" from config file -> ")
+            + ex.what());
+    }
+
     try
     {
         json_check_existance(document, "console socket path");
@@ -69,6 +81,72 @@ awsim::Config::Config(const std::string &filePath)
             + ex.what());
     }
 
+    try
+    {
+        std::string eventLoopName;
+
+        json_check_existance(document, "event loop");
+        eventLoopName = json_get_string(document["event loop"]);
+        if (eventLoopName == "epoll")
+        {
+            eventLoop = EventLoop::Epoll;
+        }
+        else if (eventLoopName == "io_uring")
+        {
+            eventLoop = EventLoop::IoUring;
+        }
+        else
+        {
+            throw std::runtime_error("Must be \"epoll\" or \"io_uring\", "
+                "currently set to \"" + eventLoopName + "\"");
+        }
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(
+            std::string("Failed to get \"event loop\" from config file -> ")
+            + ex.what());
+    }
+
+    try
+    {
+        json_check_existance(document, "file cache entries");
+        fileCacheEntries = json_get_uint64(document["file cache entries"]);
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(std::string("Failed to get \"file cache "
+            "entries\" from config file -> ") + ex.what());
+    }
+    if (fileCacheEntries < 1)
+    {
+        throw std::runtime_error("\"file cache entries\" must be an integer "
+            "greater than or equal to 1, currently set to \""
+            + std::to_string(fileCacheEntries) + "\"");
+    }
+
+    try
+    {
+        json_check_existance(document, "file cache memory");
+        fileCacheMemory = json_get_uint64(document["file cache memory"]);
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(std::string("Failed to get \"file cache "
+            "memory\" from config file -> ") + ex.what());
+    }
+
+    try
+    {
+        json_check_existance(document, "file cache ttl");
+        fileCacheTtl = json_get_uint64(document["file cache ttl"]);
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(std::string("Failed to get \"file cache "
+            "ttl\" from config file -> ") + ex.what());
+    }
+
     try
     {
         json_check_existance(document, "http port");
@@ -93,6 +171,17 @@ awsim::Config::Config(const std::string &filePath)
             + ex.what());
     }
 
+    try
+    {
+        json_check_existance(document, "keep alive timeout");
+        keepAliveTimeout = json_get_uint64(document["keep alive timeout"]);
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(std::string("Failed to get \"keep alive "
+            "timeout\" from config file -> ") + ex.what());
+    }
+
     try
     {
         json_check_existance(document, "localhost domain name");
@@ -105,6 +194,17 @@ awsim::Config::Config(const std::string &filePath)
             "domain name\" from config file -> ") + ex.what());
     }
 
+    try
+    {
+        json_check_existance(document, "max body size");
+        maxBodySize = json_get_uint64(document["max body size"]);
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(std::string("Failed to get \"max body "
+            "size\" from config file -> ") + ex.what());
+    }
+
     try
     {
         json_check_existance(document, "dynamic number of workers");
@@ -129,6 +229,18 @@ awsim::Config::Config(const std::string &filePath)
             "large files\" from config file -> ") + ex.what());
     }
 
+    try
+    {
+        json_check_existance(document, "minimum size of spooled bodies");
+        minimumSizeOfSpooledBodies = json_get_uint64(
+            document["minimum size of spooled bodies"]);
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(std::string("Failed to get \"minimum size of "
+            "spooled bodies\" from config file -> ") + ex.what());
+    }
+
     try
     {
         json_check_existance(document, "percent of cores as workers");
@@ -147,6 +259,46 @@ awsim::Config::Config(const std::string &filePath)
             + std::to_string(numberOfWorkers) + "\"");
     }
 
+    try
+    {
+        json_check_existance(document, "reuse port");
+        reusePort = json_get_bool(document["reuse port"]);
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(std::string("Failed to get \"reuse port\" "
+            "from config file -> ") + ex.what());
+    }
+
+    try
+    {
+        json_check_existance(document, "request header timeout");
+        requestHeaderTimeout = json_get_uint64(
+            document["request header timeout"]);
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(std::string("Failed to get \"request header "
+            "timeout\" from config file -> ") + ex.what());
+    }
+    if (requestHeaderTimeout < 1)
+    {
+        throw std::runtime_error("\"request header timeout\" must be an "
+            "integer greater than or equal to 1, currently set to \""
+            + std::to_string(requestHeaderTimeout) + "\"");
+    }
+
+    try
+    {
+        json_check_existance(document, "spool directory");
+        spoolDirectory = json_get_string(document["spool directory"]);
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(std::string("Failed to get \"spool "
+            "directory\" from config file -> ") + ex.what());
+    }
+
     try
     {
         json_check_existance(document, "static number of workers");
@@ -165,6 +317,23 @@ awsim::Config::Config(const std::string &filePath)
             + std::to_string(numberOfWorkers) + "\"");
     }
 
+    try
+    {
+        json_check_existance(document, "write timeout");
+        writeTimeout = json_get_uint64(document["write timeout"]);
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(std::string("Failed to get \"write timeout\" "
+            "from config file -> ") + ex.what());
+    }
+    if (writeTimeout < 1)
+    {
+        throw std::runtime_error("\"write timeout\" must be an integer "
+            "greater than or equal to 1, currently set to \""
+            + std::to_string(writeTimeout) + "\"");
+    }
+
     if (!domains_contains(localhostDomainName, domains))
     {
         throw std::runtime_error(
@@ -186,6 +355,9 @@ static void create_config_file(const std::string &configFilePath)
     }
 
     stream << "{" << std::endl
+        << "   \"compression\": "
+            << (AWSIM_DEFAULT_COMPRESSION ? "true" : "false") << ","
+            << std::endl
         << "   \"console socket path\": \""
             << AWSIM_DEFAULT_CONSOLE_SOCKET_PATH << "\", " << std::endl
         << "   \"domains\": [" << std::endl
@@ -197,6 +369,14 @@ static void create_config_file(const std::string &configFilePath)
         << "         \"status code 404 URL\": \"\"" << std::endl
         << "      }" << std::endl
         << "   ]," << std::endl
+        << "   \"event loop\": \"" << AWSIM_DEFAULT_EVENT_LOOP << "\","
+            << std::endl
+        << "   \"file cache entries\": " << AWSIM_DEFAULT_FILE_CACHE_ENTRIES
+            << "," << std::endl
+        << "   \"file cache memory\": " << AWSIM_DEFAULT_FILE_CACHE_MEMORY
+            << "," << std::endl
+        << "   \"file cache ttl\": " << AWSIM_DEFAULT_FILE_CACHE_TTL << ","
+            << std::endl
         << "   \"http port\": " << AWSIM_DEFAULT_HTTP_PORT_NUMBER << ", "
             << std::endl
         << "   \"https port\": " << AWSIM_DEFAULT_HTTPS_PORT_NUMBER << ", "
@@ -204,13 +384,27 @@ static void create_config_file(const std::string &configFilePath)
         << "   \"dynamic number of workers\": "
             << (AWSIM_DEFAULT_DYNAMIC_NUMBER_OF_WORKERS ? "true" : "false")
             << "," << std::endl
+        << "   \"keep alive timeout\": " << AWSIM_DEFAULT_KEEP_ALIVE_TIMEOUT
+            << "," << std::endl
         << "   \"localhost domain name\": \"\"," << std::endl
+        << "   \"max body size\": " << AWSIM_DEFAULT_MAX_BODY_SIZE << ","
+            << std::endl
         << "   \"minimum size of large files\": "
             << AWSIM_DEFAULT_MINIMUM_SIZE_OF_LARGE_FILES << ", " << std::endl
+        << "   \"minimum size of spooled bodies\": "
+            << AWSIM_DEFAULT_MINIMUM_SIZE_OF_SPOOLED_BODIES << "," << std::endl
         << "   \"percent of cores as workers\": "
             << AWSIM_DEFAULT_PERCENT_OF_CORES_AS_WORKERS << "," << std::endl
+        << "   \"request header timeout\": "
+            << AWSIM_DEFAULT_REQUEST_HEADER_TIMEOUT << "," << std::endl
+        << "   \"reuse port\": "
+            << (AWSIM_DEFAULT_REUSE_PORT ? "true" : "false") << ","
+            << std::endl
+        << "   \"spool directory\": \"" << AWSIM_DEFAULT_SPOOL_DIRECTORY
+            << "\"," << std::endl
         << "   \"static number of workers\": "
-            << AWSIM_DEFAULT_STATIC_NUMBER_OF_WORKERS << std::endl
+            << AWSIM_DEFAULT_STATIC_NUMBER_OF_WORKERS << "," << std::endl
+        << "   \"write timeout\": " << AWSIM_DEFAULT_WRITE_TIMEOUT << std::endl
         << "}" << std::endl;
     stream.close();
 }
@@ -18,6 +18,12 @@ namespace awsim
 {
     struct Config
     {
+        enum class EventLoop
+        {
+            Epoll,
+            IoUring
+        };
+
         struct Domain
         {
             std::unordered_map<std::string, std::string> dynamicPages;
@@ -36,14 +42,26 @@ namespace awsim
 
         std::vector<Domain> domains;
         bool dynamicNumberOfWorkers;
+        bool compression;
         std::string consoleSocketPath;
+        EventLoop eventLoop;
+        uint64_t fileCacheEntries;
+        uint64_t fileCacheMemory;
+        uint64_t fileCacheTtl;
         uint16_t httpPort;
         uint16_t httpsPort;
+        uint64_t keepAliveTimeout;
         std::string localhostDomainName;
+        uint64_t maxBodySize;
         uint64_t minimumSizeOfLargeFiles;
+        uint64_t minimumSizeOfSpooledBodies;
         uint64_t numberOfWorkers;
         double percentOfCoresForWorkers;
+        uint64_t requestHeaderTimeout;
+        bool reusePort;
+        std::string spoolDirectory;
         uint64_t staticNumberOfWorkers;
+        uint64_t writeTimeout;
 
         Config(const std::string &fileName);
     };
@@ -2,7 +2,9 @@
 
 awsim::Domain::Domain(const Config::Domain &domain) :
     name(domain.name),
-    rootDirectory(domain.rootDirectory)
+    rootDirectory(domain.rootDirectory),
+    statusCode403Page(nullptr),
+    statusCode404Page(nullptr)
 {
 
     directoryFd = open(domain.rootDirectory.c_str(),
@@ -15,83 +17,106 @@ awsim::Domain::Domain(const Config::Domain &domain) :
             + strerror(errno));
     }
 
-    for (const auto &entry : domain.dynamicPages)
-    {
-        try
-        {
-            dynamicPages.insert_dynamic_page(entry.first, entry.second);
-        }
-        catch (const std::exception &ex)
-        {
-            throw std::runtime_error("Failed to insert dynamic page \""
-                + entry.second + "\" -> " + ex.what());
-        }
-    }
-
     try
     {
-        statusCode403Resource.init(domain.statusCode403Url,
-            directoryFd, dynamicPages);
-    }
-    catch (const Resource::FileForbiddenException &ex)
-    {
-        throw std::runtime_error("Failed to open resource \""
-            + domain.statusCode403Url + "\" -> File is forbidden");
-    }
-    catch (const Resource::FileNotFoundException &ex)
-    {
-        throw std::runtime_error("Failed to open resource \""
-            + domain.statusCode403Url + "\" -> File not found");
+        dynamicPages.init(domain.dynamicPages);
     }
     catch (const std::exception &ex)
     {
-        throw std::runtime_error("Failed to open resource \""
-            + domain.statusCode403Url + "\" -> " + ex.what());
+        throw std::runtime_error("Failed to load dynamic pages -> "
+            + std::string(ex.what()));
     }
 
+    load_error_page(domain.statusCode403Url,
+        HttpResponse::StatusCode::Forbidden_403, statusCode403Page);
+    load_error_page(domain.statusCode404Url,
+        HttpResponse::StatusCode::NotFound_404, statusCode404Page);
+}
+
+awsim::Domain::~Domain()
+{
+    close(directoryFd);
+}
+
+void awsim::Domain::get_resource(std::string url, HttpRequest::Method method,
+    Resource &destination, FileCache &fileCache) const
+{
+    destination.init(url, method, directoryFd, dynamicPages, &fileCache);
+}
+
+void awsim::Domain::load_error_page(const std::string &url,
+    HttpResponse::StatusCode statusCode, DynamicPage &dynamicPage)
+{
+    Resource resource;
+
     try
     {
-        statusCode404Resource.init(domain.statusCode404Url,
-            directoryFd, dynamicPages);
+        // Error pages answer every method, a route for GET only will do
+        resource.init(url, HttpRequest::Method::GET, directoryFd,
+            dynamicPages, nullptr);
+        if (resource.is_static())
+        {
+            // The file is closed again with resource, later changes to it
+            // take a restart
+            // Most likely a page of HTML whatever its name
+            errorResponses.set_body(statusCode, resource.get_contents(),
+                HttpResponse::get_mime_type(url,
+                HttpResponse::MimeType::Text_HTML));
+            dynamicPage = nullptr;
+        }
+        else
+        {
+            dynamicPage = resource.get_dynamic_page();
+        }
     }
     catch (const Resource::FileForbiddenException &ex)
     {
         throw std::runtime_error("Failed to open resource \""
-            + domain.statusCode404Url + "\" -> File is forbidden");
+            + url + "\" -> File is forbidden");
     }
     catch (const Resource::FileNotFoundException &ex)
     {
         throw std::runtime_error("Failed to open resource \""
-            + domain.statusCode404Url + "\" -> File not found");
+            + url + "\" -> File not found");
     }
     catch (const std::exception &ex)
     {
         throw std::runtime_error("Failed to open resource \""
-            + domain.statusCode404Url + "\" -> " + ex.what());
+            + url + "\" -> " + ex.what());
     }
 }
 
-awsim::Domain::~Domain()
+void awsim::Domain::send_403(HttpRequest *request, Client *client) const
 {
-    close(directoryFd);
+    send_error(HttpResponse::StatusCode::Forbidden_403, statusCode403Page,
+        request, client);
 }
 
-awsim::DynamicPage awsim::Domain::get_dynamic_page(const std::string &url) const
+void awsim::Domain::send_404(HttpRequest *request, Client *client) const
 {
-    return dynamicPages.get_dynamic_page(url);
+    send_error(HttpResponse::StatusCode::NotFound_404, statusCode404Page,
+        request, client);
 }
 
-void awsim::Domain::get_resource(std::string url, Resource &destination) const
+void awsim::Domain::send_405(Client *client) const
 {
-    destination.init(url, directoryFd, dynamicPages);
-}
+    const std::string &response = errorResponses.get(
+        HttpResponse::StatusCode::MethodNotAllowed_405, client->keepAlive);
 
-void awsim::Domain::send_403(HttpRequest *request, Client *client) const
-{
-    statusCode403Resource.respond(request, client);
+    client->queue(response.data(), response.size());
 }
 
-void awsim::Domain::send_404(HttpRequest *request, Client *client) const
+void awsim::Domain::send_error(HttpResponse::StatusCode statusCode,
+    DynamicPage dynamicPage, HttpRequest *request, Client *client) const
 {
-    statusCode404Resource.respond(request, client);
+    const std::string &response = request->method == HttpRequest::Method::HEAD
+        ? errorResponses.get_head(statusCode, client->keepAlive)
+        : errorResponses.get(statusCode, client->keepAlive);
+
+    if (dynamicPage != nullptr)
+    {
+        dynamicPage(request, client);
+        return;
+    }
+    client->queue(response.data(), response.size());
 }
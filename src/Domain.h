@@ -9,6 +9,8 @@
 #include "Config.h"
 #include "DynamicPage.h"
 #include "DynamicPages.h"
+#include "ErrorResponses.h"
+#include "FileCache.h"
 #include "HttpRequest.h"
 #include "Resource.h"
 
@@ -24,16 +26,28 @@ namespace awsim
         Domain(const Config::Domain &domain);
         ~Domain();
 
-        DynamicPage get_dynamic_page(const std::string &url) const;
-        void get_resource(std::string url, Resource &destination) const;
+        void get_resource(std::string url, HttpRequest::Method method,
+            Resource &destination, FileCache &fileCache) const;
         void send_403(HttpRequest *request, Client *client) const;
         void send_404(HttpRequest *request, Client *client) const;
+        // Answers a request for a static file with a method other than GET
+        // or HEAD
+        void send_405(Client *client) const;
 
     private:
         DynamicPages dynamicPages;
         int directoryFd;
-        Resource statusCode403Resource;
-        Resource statusCode404Resource;
+        // Error pages that are static files are read once and served from
+        // errorResponses, the ones that are dynamic pages are called
+        ErrorResponses errorResponses;
+        DynamicPage statusCode403Page;
+        DynamicPage statusCode404Page;
+
+        void load_error_page(const std::string &url,
+            HttpResponse::StatusCode statusCode, DynamicPage &dynamicPage);
+        void send_error(HttpResponse::StatusCode statusCode,
+            DynamicPage dynamicPage, HttpRequest *request,
+            Client *client) const;
     };
 }
 
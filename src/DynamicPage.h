@@ -1,12 +1,29 @@
 #ifndef AWSIM_DYNAMICPAGE_H
 #define AWSIM_DYNAMICPAGE_H
 
+#include <stddef.h>
+
 #include "HttpRequest.h"
-#include "Client.h"
 
 namespace awsim
 {
-    typedef void (*DynamicPage) (const HttpRequest*, const Client*);
+    class Client;
+
+    typedef void (*DynamicPage) (const HttpRequest*, Client*);
+    // A page that exports "process_body" next to "process" is handed the
+    // body of its requests piece by piece as it arrives, decoded, before
+    // "process" is called. Each piece points into the read buffer and is
+    // only valid during the call, pageData of the request is the page's to
+    // keep what it needs between pieces. Returning false refuses the body,
+    // which is answered with 413. data is nullptr when the request is
+    // dropped before it reaches "process", so the page can let go of
+    // pageData.
+    typedef bool (*DynamicPageBody) (HttpRequest*, Client*, const char *data,
+        size_t length);
 }
 
+// Pages use the Client they are handed. It keeps a DynamicPageBody itself,
+// so it comes after the typedefs.
+#include "Client.h"
+
 #endif
@@ -1,97 +1,70 @@
 #include "DynamicPages.h"
 
-static std::string next_token(const std::string &str, size_t start,
-    char delimiter, size_t *end);
 static void* load_symbol(void *lib, const std::string &name);
 static void* open_dynamic_library(const std::string &filePath);
+static std::string_view parse_method(std::string_view route, bool &anyMethod,
+    awsim::HttpRequest::Method &method);
 
-awsim::DynamicPage awsim::DynamicPages::get_dynamic_page(const std::string &url)
-    const
+awsim::DynamicPages::DynamicPages()
 {
-    const std::unordered_map<std::string, Triple> *map = &root;
-    size_t start = 0;
-    while (start < url.length())
+
+}
+
+awsim::DynamicPages::~DynamicPages()
+{
+    for (void *lib : libs)
     {
-        std::string token = next_token(url, start, '/', &start);
-        const auto it = map->find(token);
-        if (it == map->end())
-        {
-            break;
-        }
-        const Triple &triple = it->second;
-        if (triple.nextMap == nullptr)
-        {
-            break;
-        }
-        if (triple.dynamicPage != nullptr)
-        {
-            return triple.dynamicPage;
-        }
-        map = triple.nextMap;
+        dlclose(lib);
     }
-    return nullptr;
 }
 
-void awsim::DynamicPages::insert_dynamic_page(const std::string &url,
-    const std::string &sharedLibraryFilePath)
+bool awsim::DynamicPages::get_dynamic_page(std::string_view url,
+    HttpRequest::Method method, Router::Match &match) const
 {
-    std::unordered_map<std::string, Triple> *map;
-    size_t start = 0;
-    DynamicPage dynamicPage;
-    map = &root;
-    void *lib;
+    return router.match(url, method, match);
+}
 
-    try
-    {
-        lib = open_dynamic_library(sharedLibraryFilePath);
-    }
-    catch (const std::exception &ex)
-    {
-        throw std::runtime_error("Failed to open dynamic library \""
-            + sharedLibraryFilePath + "\" -> " + ex.what());
-    }
+void awsim::DynamicPages::init(
+    const std::unordered_map<std::string, std::string> &pages)
+{
+    std::vector<Router::Entry> entries;
 
-    try
-    {
-        dynamicPage = (DynamicPage)load_symbol(lib, "process");
-    }
-    catch (const std::exception &ex)
+    for (const auto &page : pages)
     {
-        throw std::runtime_error(
-            "Failed to open load dynamic page from library \""
-            + sharedLibraryFilePath + "\" -> " + ex.what());
-    }
+        Router::Entry entry{{}, true, HttpRequest::Method::GET, nullptr,
+            nullptr};
+        void *lib;
 
-    while (start < url.length())
-    {
-        std::string token = next_token(url, start, '/', &start);
-        std::unordered_map<std::string, Triple>::iterator it =
-            map->find(token);
-        if (it == map->end())
+        entry.pattern = parse_method(page.first, entry.anyMethod,
+            entry.method);
+
+        try
+        {
+            lib = open_dynamic_library(page.second);
+        }
+        catch (const std::exception &ex)
         {
-            std::pair<std::unordered_map<std::string, Triple>::iterator, bool>
-                pair = map->emplace(std::piecewise_construct,
-                std::forward_as_tuple(token),
-                std::forward_as_tuple(nullptr, nullptr));
-            it = pair.first;
+            throw std::runtime_error("Failed to open dynamic library \""
+                + page.second + "\" -> " + ex.what());
         }
+        libs.push_back(lib);
 
-        if (start < url.length())
+        try
         {
-            if (it->second.nextMap == nullptr)
-            {
-                it->second.nextMap =
-                    new std::unordered_map<std::string, Triple>();
-            }
-            map = it->second.nextMap;
+            entry.dynamicPage = (DynamicPage)load_symbol(lib, "process");
         }
-        else
+        catch (const std::exception &ex)
         {
-            it->second.dynamicPage = dynamicPage;
-            it->second.lib = lib;
-            break;
+            throw std::runtime_error(
+                "Failed to open load dynamic page from library \""
+                + page.second + "\" -> " + ex.what());
         }
+        // Optional, pages without it get the body whole
+        entry.dynamicPageBody = (DynamicPageBody)dlsym(lib, "process_body");
+        entries.push_back(entry);
     }
+
+    router.init(entries);
 }
 
 static void* load_symbol(void *lib, const std::string &name)
@@ -122,39 +95,29 @@ static void* open_dynamic_library(const std::string &filePath)
     return lib;
 }
 
-static std::string next_token(const std::string &str, size_t start,
-    char delimiter, size_t *end)
+static std::string_view parse_method(std::string_view route, bool &anyMethod,
+    awsim::HttpRequest::Method &method)
 {
-    size_t tmp;
+    size_t space = route.find(' ');
+    size_t start;
+    std::string_view name;
 
-    while (str[start] == delimiter)
+    anyMethod = space == std::string_view::npos;
+    if (anyMethod)
     {
-        ++start;
+        return route;
     }
-
-    tmp = start + 1;
-    while (tmp < str.length() && str[tmp] != delimiter)
+    name = route.substr(0, space);
+    for (int i = 0; i <= (int)awsim::HttpRequest::Method::PATCH; ++i)
     {
-        ++tmp;
-    }
-    *end = tmp;
-
-    return str.substr(start, tmp - start);
-}
-
-awsim::DynamicPages::Triple::Triple(DynamicPage dynamicPage, void *lib) :
-    dynamicPage(dynamicPage),
-    lib(lib),
-    nextMap(nullptr)
-{
-
-}
-
-awsim::DynamicPages::Triple::~Triple()
-{
-    dlclose(lib);
-    if (nextMap != nullptr)
-    {
-        delete nextMap;
+        if (name == awsim::HttpRequest::methodStrings[i])
+        {
+            method = (awsim::HttpRequest::Method)i;
+            start = route.find_first_not_of(' ', space);
+            return start == std::string_view::npos ? std::string_view()
+                : route.substr(start);
+        }
     }
+    throw std::runtime_error("Unknown method \"" + std::string(name)
+        + "\" in route \"" + std::string(route) + "\"");
 }
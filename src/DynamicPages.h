@@ -5,31 +5,36 @@
 #include <errno.h>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <string.h>
 #include <unordered_map>
+#include <vector>
 
 #include "DynamicPage.h"
+#include "HttpRequest.h"
+#include "Router.h"
 
 namespace awsim
 {
     class DynamicPages
     {
     public:
-        DynamicPage get_dynamic_page(const std::string &url) const;
-        void insert_dynamic_page(const std::string &url,
-            const std::string &sharedLibraryFilePath);
-    private:
-        struct Triple
-        {
-            DynamicPage dynamicPage;
-            void *lib;
-            std::unordered_map<std::string, Triple> *nextMap;
-
-            Triple(DynamicPage dynamicPage, void *lib);
-            ~Triple();
-        };
+        DynamicPages();
+        DynamicPages(const DynamicPages&) = delete;
+        DynamicPages& operator=(const DynamicPages&) = delete;
+        ~DynamicPages();
 
-        std::unordered_map<std::string, Triple> root;
+        // Returns false when no route matches
+        bool get_dynamic_page(std::string_view url, HttpRequest::Method method,
+            Router::Match &match) const;
+        // Loads the page of each route from its shared library. A route is
+        // a Router pattern, optionally after a method and a space, like
+        // "GET /users/:id". Without a method it takes any.
+        void init(const std::unordered_map<std::string, std::string> &pages);
+    private:
+        Router router;
+        // Closed with the pages
+        std::vector<void*> libs;
     };
 }
 
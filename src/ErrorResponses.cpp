@@ -0,0 +1,56 @@
+#include "ErrorResponses.h"
+
+awsim::ErrorResponses::ErrorResponses()
+{
+    for (int i = (int)HttpResponse::StatusCode::BadRequest_400;
+        i < HttpResponse::NUMBER_OF_STATUS_CODES; ++i)
+    {
+        const char *status = HttpResponse::get_status(
+            (HttpResponse::StatusCode)i);
+
+        build((HttpResponse::StatusCode)i, std::string("<!DOCTYPE html>\n"
+            "<html><head><title>") + status + "</title></head>\n"
+            "<body><h1>" + status + "</h1></body></html>\n",
+            HttpResponse::MimeType::Text_HTML);
+    }
+}
+
+void awsim::ErrorResponses::build(HttpResponse::StatusCode statusCode,
+    const std::string &body, HttpResponse::MimeType contentType)
+{
+    for (int keepAlive = 0; keepAlive < 2; ++keepAlive)
+    {
+        HttpResponse response(1, 1, statusCode);
+
+        if (statusCode == HttpResponse::StatusCode::MethodNotAllowed_405)
+        {
+            response.set_allow(HttpResponse::Allow::Get_Head);
+        }
+        response.set_connection(keepAlive
+            ? HttpResponse::Connection::KeepAlive
+            : HttpResponse::Connection::Close);
+        response.set_content_length(body.size());
+        response.set_content_type(contentType);
+        heads[(int)statusCode][keepAlive] = response.to_string();
+        responses[(int)statusCode][keepAlive] =
+            heads[(int)statusCode][keepAlive] + body;
+    }
+}
+
+const std::string& awsim::ErrorResponses::get(
+    HttpResponse::StatusCode statusCode, bool keepAlive) const
+{
+    return responses[(int)statusCode][keepAlive];
+}
+
+const std::string& awsim::ErrorResponses::get_head(
+    HttpResponse::StatusCode statusCode, bool keepAlive) const
+{
+    return heads[(int)statusCode][keepAlive];
+}
+
+void awsim::ErrorResponses::set_body(HttpResponse::StatusCode statusCode,
+    const std::string &body, HttpResponse::MimeType contentType)
+{
+    build(statusCode, body, contentType);
+}
@@ -0,0 +1,40 @@
+#ifndef AWSIM_ERRORRESPONSES_H
+#define AWSIM_ERRORRESPONSES_H
+
+#include <string>
+
+#include "HttpResponse.h"
+
+namespace awsim
+{
+    // Complete error responses, status line, headers and body, serialized
+    // once up front. Answering a request with one of them is a single copy
+    // into the output of the client, no matter how many bad requests come
+    // in. They do not change while the server runs, so all workers share
+    // them.
+    class ErrorResponses
+    {
+    public:
+        // Fills in a short HTML page for every error status code
+        ErrorResponses();
+
+        // The response for Connection: close or keep-alive
+        const std::string& get(HttpResponse::StatusCode statusCode,
+            bool keepAlive) const;
+        // The same without the body, for HEAD requests
+        const std::string& get_head(HttpResponse::StatusCode statusCode,
+            bool keepAlive) const;
+        // Replaces the body of the responses for statusCode, sent as
+        // contentType
+        void set_body(HttpResponse::StatusCode statusCode,
+            const std::string &body, HttpResponse::MimeType contentType);
+    private:
+        std::string responses[HttpResponse::NUMBER_OF_STATUS_CODES][2];
+        std::string heads[HttpResponse::NUMBER_OF_STATUS_CODES][2];
+
+        void build(HttpResponse::StatusCode statusCode,
+            const std::string &body, HttpResponse::MimeType contentType);
+    };
+}
+
+#endif
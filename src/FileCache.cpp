@@ -0,0 +1,508 @@
+#include "FileCache.h"
+
+static std::string build_etag(const struct stat &s);
+static int open_beneath(int rootDirectoryFd, const char *path);
+static int try_open_beneath(int rootDirectoryFd, const char *path,
+    int flags);
+
+const char *awsim::FileCache::encodingSuffixes[NUMBER_OF_ENCODINGS] = {
+    "",
+    ".br",
+    ".zst",
+    ".gz"
+};
+
+static std::string build_etag(const struct stat &s)
+{
+    char buf[64];
+
+    // Changes whenever the file is replaced or written to, without reading
+    // a byte of it
+    snprintf(buf, sizeof(buf), "\"%" PRIx64 "-%" PRIx64 "-%" PRIx64 "\"",
+        (uint64_t)s.st_ino,
+        (uint64_t)s.st_mtim.tv_sec * 1000000000 + s.st_mtim.tv_nsec,
+        (uint64_t)s.st_size);
+    return buf;
+}
+
+// No component of path, symbolic links included, may lead out of the root
+// directory. Reading the file leaves its access time alone when the server
+// owns it.
+static int open_beneath(int rootDirectoryFd, const char *path)
+{
+    int fd = try_open_beneath(rootDirectoryFd, path,
+        O_RDONLY | O_CLOEXEC | O_NOATIME);
+
+    // O_NOATIME is refused for files the server does not own
+    if (fd == -1 && errno == EPERM)
+    {
+        fd = try_open_beneath(rootDirectoryFd, path, O_RDONLY | O_CLOEXEC);
+    }
+    return fd;
+}
+
+// Kernels before 5.6, and sandboxes that filter openat2, only have openat:
+// the path has no ".." left, but its symbolic links are followed anywhere
+static int try_open_beneath(int rootDirectoryFd, const char *path,
+    int flags)
+{
+    struct open_how how = {};
+    int fd;
+
+    how.flags = flags;
+    how.resolve = RESOLVE_BENEATH;
+    fd = syscall(SYS_openat2, rootDirectoryFd, path, &how, sizeof(how));
+    if (fd == -1 && (errno == ENOSYS || errno == EPERM))
+    {
+        fd = openat(rootDirectoryFd, path, flags);
+    }
+    return fd;
+}
+
+awsim::FileCache::FileCache() :
+    maxEntries(1),
+    maxMemoryFileSize(0),
+    memoryBudget(0),
+    memoryUsed(0),
+    stats(),
+    ttl(0)
+{
+
+}
+
+awsim::FileCache::~FileCache()
+{
+    clear();
+}
+
+std::string awsim::FileCache::Stats::to_string() const
+{
+    return std::to_string(hits) + " hits, " + std::to_string(misses)
+        + " misses, " + std::to_string(revalidations) + " revalidations ("
+        + std::to_string(reopened) + " reopened), "
+        + std::to_string(memoryHits) + " served from memory, "
+        + std::to_string(memoryAdmissions) + " admitted to and "
+        + std::to_string(memoryEvictions) + " evicted from memory";
+}
+
+void awsim::FileCache::admit(Entry &entry)
+{
+    File &file = entry.file;
+    size_t length = 0;
+
+    make_room(file.size, file);
+    file.contents.resize(file.size);
+    while (length < file.size)
+    {
+        ssize_t count = pread(file.fd, &file.contents[length],
+            file.size - length, length);
+
+        if (count == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            // Shrunk since it was opened, revalidation picks that up
+            file.contents.clear();
+            file.contents.shrink_to_fit();
+            return;
+        }
+        length += count;
+    }
+    file.inMemory = true;
+    memoryUsed += file.size;
+    stats.memoryAdmissions++;
+}
+
+void awsim::FileCache::clear()
+{
+    for (Entry &entry : entries)
+    {
+        entry.file.close();
+    }
+    index.clear();
+    entries.clear();
+    memoryUsed = 0;
+}
+
+bool awsim::FileCache::compress(int rootDirectoryFd, const char *path,
+    Compressor::Format format, Compressor &compressor, const char *&data,
+    size_t &length)
+{
+    File &file = index.find(Key{rootDirectoryFd, path,
+        Encoding::Identity})->second->file;
+    std::string &compressed = file.compressed[(int)format];
+    uint8_t bit = 1 << (int)format;
+
+    if (file.compressedFormats & bit)
+    {
+        data = compressed.data();
+        length = compressed.size();
+        return !compressed.empty();
+    }
+    if (!compressor.compress(format, file.contents.data(), file.size))
+    {
+        // Neither is it going to be the next time
+        file.compressedFormats |= bit;
+        return false;
+    }
+    data = compressor.get_output();
+    length = compressor.get_output_length();
+    make_room(length, file);
+    if (memoryUsed + length <= memoryBudget)
+    {
+        compressed.assign(data, length);
+        file.compressedFormats |= bit;
+        memoryUsed += length;
+        data = compressed.data();
+    }
+    return true;
+}
+
+void awsim::FileCache::drop_contents(File &file)
+{
+    if (file.inMemory)
+    {
+        memoryUsed -= file.size;
+        file.inMemory = false;
+        file.contents.clear();
+        file.contents.shrink_to_fit();
+        for (std::string &compressed : file.compressed)
+        {
+            memoryUsed -= compressed.size();
+            compressed.clear();
+            compressed.shrink_to_fit();
+        }
+        file.compressedFormats = 0;
+    }
+}
+
+const awsim::FileCache::File* awsim::FileCache::get(int rootDirectoryFd,
+    const char *path, Encoding encoding)
+{
+    Key key{rootDirectoryFd, path, encoding};
+    uint64_t now = get_milliseconds();
+    auto it = index.find(key);
+
+    if (it != index.end())
+    {
+        Entry &entry = *it->second;
+
+        stats.hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        if (now - entry.checked >= ttl)
+        {
+            revalidate(entry, now);
+        }
+        entry.file.hits++;
+        if (!entry.file.inMemory && entry.file.fd != -1
+            && entry.file.hits >= 2 && entry.file.size < maxMemoryFileSize
+            && entry.file.size <= memoryBudget)
+        {
+            admit(entry);
+        }
+        if (entry.file.inMemory)
+        {
+            stats.memoryHits++;
+        }
+        return &entry.file;
+    }
+
+    stats.misses++;
+    if (entries.size() >= maxEntries)
+    {
+        drop_contents(entries.back().file);
+        entries.back().file.close();
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+    entries.emplace_front();
+    try
+    {
+        entries.front().file.open(rootDirectoryFd, path, encoding);
+    }
+    catch (...)
+    {
+        entries.pop_front();
+        throw;
+    }
+    entries.front().file.hits = 1;
+    entries.front().checked = now;
+    entries.front().path = path;
+    entries.front().key = Key{rootDirectoryFd, entries.front().path, encoding};
+    index.emplace(entries.front().key, entries.begin());
+    return &entries.front().file;
+}
+
+uint64_t awsim::FileCache::get_milliseconds()
+{
+    timespec ts;
+
+    // Served from the vDSO, and a tick of resolution is plenty for a TTL
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+const awsim::FileCache::Stats& awsim::FileCache::get_stats() const
+{
+    return stats;
+}
+
+void awsim::FileCache::init(uint64_t maxEntries, uint64_t ttlSeconds,
+    uint64_t memoryBudget, uint64_t maxMemoryFileSize)
+{
+    clear();
+    // The entry handed out last has to stay around until the next lookup
+    this->maxEntries = maxEntries > 0 ? maxEntries : 1;
+    this->maxMemoryFileSize = maxMemoryFileSize;
+    this->memoryBudget = memoryBudget;
+    stats = Stats();
+    ttl = ttlSeconds * 1000;
+}
+
+void awsim::FileCache::make_room(size_t length, const File &keep)
+{
+    for (auto it = entries.rbegin();
+        memoryUsed + length > memoryBudget && it != entries.rend(); ++it)
+    {
+        if (it->file.inMemory && &it->file != &keep)
+        {
+            drop_contents(it->file);
+            stats.memoryEvictions++;
+        }
+    }
+}
+
+void awsim::FileCache::revalidate(Entry &entry, uint64_t now)
+{
+    struct stat s;
+
+    entry.checked = now;
+    stats.revalidations++;
+    if (entry.file.fd != -1
+        && fstatat(entry.key.rootDirectoryFd,
+        (entry.path + encodingSuffixes[(int)entry.key.encoding]).c_str(),
+        &s, 0) == 0 && entry.file.matches(s))
+    {
+        // Siblings may have been added or removed on their own
+        if (entry.file.encoding == Encoding::Identity
+            && entry.file.probe_variants(entry.key.rootDirectoryFd,
+            entry.path.c_str()))
+        {
+            entry.file.build_headers();
+        }
+        return;
+    }
+    // Gone, replaced or changed, or it did not exist before
+    stats.reopened++;
+    drop_contents(entry.file);
+    entry.file.close();
+    entry.file.open(entry.key.rootDirectoryFd, entry.path.c_str(),
+        entry.key.encoding);
+    entry.file.hits = 0;
+}
+
+bool awsim::FileCache::Key::operator==(const Key &other) const
+{
+    return rootDirectoryFd == other.rootDirectoryFd
+        && encoding == other.encoding && path == other.path;
+}
+
+size_t awsim::FileCache::KeyHash::operator()(const Key &key) const
+{
+    return std::hash<std::string_view>()(key.path)
+        ^ ((size_t)key.rootDirectoryFd << 2) ^ (size_t)key.encoding;
+}
+
+void awsim::FileCache::File::build_headers()
+{
+    for (int keepAlive = 0; keepAlive < 2; ++keepAlive)
+    {
+        HttpResponse response(1, 1, HttpResponse::StatusCode::OK_200);
+        HttpResponse notModifiedResponse(1, 1,
+            HttpResponse::StatusCode::NotModified_304);
+
+        response.set_connection(keepAlive
+            ? HttpResponse::Connection::KeepAlive
+            : HttpResponse::Connection::Close);
+        notModifiedResponse.set_connection(keepAlive
+            ? HttpResponse::Connection::KeepAlive
+            : HttpResponse::Connection::Close);
+        switch (encoding)
+        {
+            case Encoding::Identity:
+                break;
+            case Encoding::Brotli:
+                response.set_content_encoding(
+                    HttpResponse::ContentEncoding::Brotli);
+                break;
+            case Encoding::Zstd:
+                response.set_content_encoding(
+                    HttpResponse::ContentEncoding::Zstd);
+                break;
+            case Encoding::Gzip:
+                response.set_content_encoding(
+                    HttpResponse::ContentEncoding::Gzip);
+                break;
+        }
+        response.set_accept_ranges(HttpResponse::AcceptRanges::Bytes);
+        response.set_content_length(size);
+        response.set_etag(etag);
+        response.set_last_modified(modified.tv_sec);
+        notModifiedResponse.set_etag(etag);
+        notModifiedResponse.set_last_modified(modified.tv_sec);
+        // Shared caches must not hand one variant to every client
+        if (encoding != Encoding::Identity || variants != 0 || compressible)
+        {
+            response.set_vary(HttpResponse::Vary::AcceptEncoding);
+            notModifiedResponse.set_vary(HttpResponse::Vary::AcceptEncoding);
+        }
+        headers[keepAlive] = response.to_string();
+        notModified[0][keepAlive] = notModifiedResponse.to_string();
+        if (compressible)
+        {
+            // The output of the compressor is not the same byte for byte
+            // at every level
+            notModifiedResponse.set_etag("W/" + etag);
+            notModified[1][keepAlive] = notModifiedResponse.to_string();
+        }
+    }
+}
+
+void awsim::FileCache::File::close()
+{
+    if (fd != -1)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool awsim::FileCache::File::matches(const struct stat &s) const
+{
+    return S_ISREG(s.st_mode) && s.st_dev == device && s.st_ino == inode
+        && (size_t)s.st_size == size
+        && s.st_mtim.tv_sec == modified.tv_sec
+        && s.st_mtim.tv_nsec == modified.tv_nsec
+        && s.st_ctim.tv_sec == changed.tv_sec
+        && s.st_ctim.tv_nsec == changed.tv_nsec;
+}
+
+void awsim::FileCache::File::open(int rootDirectoryFd, const char *path,
+    Encoding encoding)
+{
+    std::string variantPath;
+    struct stat s;
+
+    if (encoding != Encoding::Identity)
+    {
+        variantPath = std::string(path) + encodingSuffixes[(int)encoding];
+        path = variantPath.c_str();
+    }
+    fd = -1;
+    forbidden = false;
+    this->encoding = encoding;
+    variants = 0;
+    compressible = false;
+    size = 0;
+    etag.clear();
+    headers[0].clear();
+    headers[1].clear();
+    notModified[1][0].clear();
+    notModified[1][1].clear();
+    contents.clear();
+    inMemory = false;
+    compressed[0].clear();
+    compressed[1].clear();
+    compressedFormats = 0;
+    hits = 0;
+
+    fd = open_beneath(rootDirectoryFd, path);
+    if (fd == -1)
+    {
+        switch (errno)
+        {
+            case EACCES:
+            // A symbolic link out of the root directory
+            case EXDEV:
+                forbidden = true;
+                return;
+            case ENOENT:
+            case ENOTDIR:
+            case ENAMETOOLONG:
+            case ELOOP:
+            case EFAULT:
+                // File is missing; it may be a dynamic page
+                return;
+            case EMFILE:
+            case ENFILE:
+            case ENOMEM:
+                throw UnavailableException("openat2("
+                    + std::to_string(rootDirectoryFd) + ", \"" + path
+                    + "\", RESOLVE_BENEATH) failed -> "
+                    + strerror(errno));
+            default:
+                throw std::runtime_error("openat2("
+                    + std::to_string(rootDirectoryFd) + ", \"" + path
+                    + "\", RESOLVE_BENEATH) failed -> "
+                    + strerror(errno));
+        }
+    }
+
+    if (fstat(fd, &s) == -1)
+    {
+        int error = errno;
+        std::string message = "fstat(" + std::to_string(fd)
+            + ", &s) failed -> " + strerror(error);
+
+        close();
+        throw std::runtime_error(message);
+    }
+    if (!S_ISREG(s.st_mode))
+    {
+        close();
+        return;
+    }
+
+    size = s.st_size;
+    device = s.st_dev;
+    inode = s.st_ino;
+    modified = s.st_mtim;
+    changed = s.st_ctim;
+    etag = build_etag(s);
+    if (encoding == Encoding::Identity)
+    {
+        probe_variants(rootDirectoryFd, path);
+        compressible = size >= Compressor::MINIMUM_SIZE
+            && Compressor::is_compressible(path);
+    }
+    build_headers();
+}
+
+bool awsim::FileCache::File::probe_variants(int rootDirectoryFd,
+    const char *path)
+{
+    uint8_t found = 0;
+    std::string variantPath = path;
+    size_t length = variantPath.size();
+
+    for (uint8_t i = 1; i < NUMBER_OF_ENCODINGS; ++i)
+    {
+        struct stat s;
+
+        variantPath.resize(length);
+        variantPath += encodingSuffixes[i];
+        if (fstatat(rootDirectoryFd, variantPath.c_str(), &s, 0) == 0
+            && S_ISREG(s.st_mode))
+        {
+            found |= 1 << i;
+        }
+    }
+    if (found == variants)
+    {
+        return false;
+    }
+    variants = found;
+    return true;
+}
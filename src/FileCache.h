@@ -0,0 +1,196 @@
+#ifndef AWSIM_FILECACHE_H
+#define AWSIM_FILECACHE_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <functional>
+#include <inttypes.h>
+#include <linux/openat2.h>
+#include <list>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "Compressor.h"
+#include "HttpResponse.h"
+#include "UnavailableException.h"
+
+namespace awsim
+{
+    // Per worker cache of opened static files, keyed by the root directory
+    // of the domain and the path below it. A hit costs no syscalls until the
+    // entry is older than the TTL, after which a single fstatat tells
+    // whether the file has to be opened again. Misses (the path is not a
+    // regular file, so it may be a dynamic page) are cached as well. The
+    // least recently used entry is dropped once the cache is full.
+    //
+    // Files smaller than the large file threshold have their contents kept
+    // in memory once they are asked for a second time, so files that are
+    // only ever requested once do not push out the ones that are popular.
+    // The contents of all files together stay within the memory budget, the
+    // least recently used ones are dropped to make room. So does the output
+    // of compressing a file in memory on the fly, which is kept with its
+    // contents so that it is only compressed once.
+    //
+    // Precompressed siblings of a file (foo.js.br, foo.js.zst, foo.js.gz)
+    // are cached as entries of their own. The entry of the file itself
+    // records which of them exist.
+    class FileCache
+    {
+    public:
+        // In order of preference when the client accepts several equally
+        enum class Encoding : uint8_t
+        {
+            Identity,
+            Brotli,
+            Zstd,
+            Gzip
+        };
+
+        static const uint8_t NUMBER_OF_ENCODINGS = 4;
+        // File name suffix of each encoding
+        static const char *encodingSuffixes[NUMBER_OF_ENCODINGS];
+
+        // Logged when the worker stops
+        struct Stats
+        {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t revalidations;
+            uint64_t reopened;
+            uint64_t memoryHits;
+            uint64_t memoryAdmissions;
+            uint64_t memoryEvictions;
+
+            std::string to_string() const;
+        };
+
+        struct File
+        {
+            // -1 unless the path is a readable regular file
+            int fd;
+            bool forbidden;
+            Encoding encoding;
+            // Bit (1 << encoding) is set for every precompressed sibling,
+            // only kept for Identity
+            uint8_t variants;
+            // Whether a file without a sibling the client takes is worth
+            // compressing on the fly, only kept for Identity
+            bool compressible;
+            size_t size;
+            // Identify the version of the file that fd refers to
+            dev_t device;
+            ino_t inode;
+            timespec modified;
+            timespec changed;
+            // Strong validator made of the inode, modification time and
+            // size, quotes included
+            std::string etag;
+            // Status line and headers of a 200 response with the body, for
+            // Connection: close and keep-alive
+            std::string headers[2];
+            // Status line and headers of a 304 response, for Connection:
+            // close and keep-alive. The second pair carries the weak ETag
+            // of the file compressed on the fly, only kept when compressible.
+            std::string notModified[2][2];
+            // The whole file once inMemory is set
+            std::string contents;
+            bool inMemory;
+            // The contents compressed in each Compressor::Format, once the
+            // bit (1 << format) of compressedFormats is set. Left empty when
+            // the output was not smaller.
+            std::string compressed[2];
+            uint8_t compressedFormats;
+            // Requests since the file was opened
+            uint64_t hits;
+
+            void build_headers();
+            // Opens path below rootDirectoryFd, with the suffix of encoding
+            // appended, and fills in the rest
+            void open(int rootDirectoryFd, const char *path,
+                Encoding encoding);
+            void close();
+            // Whether s describes the same version of the file
+            bool matches(const struct stat &s) const;
+            // Looks for precompressed siblings, returns whether the set
+            // changed
+            bool probe_variants(int rootDirectoryFd, const char *path);
+        };
+
+        FileCache();
+        ~FileCache();
+
+        void clear();
+        // Compresses the contents of the file at path, which get() has just
+        // returned in memory without a suffix, and keeps the output with
+        // them when the budget has room. Returns false when the output is
+        // not smaller. Otherwise data and length stay valid until the next
+        // call to compress(), get() or clear(), or to compressor.
+        bool compress(int rootDirectoryFd, const char *path,
+            Compressor::Format format, Compressor &compressor,
+            const char *&data, size_t &length);
+        // The returned entry stays valid until the next call to get() or
+        // clear(). path must not start with a '/'.
+        const File* get(int rootDirectoryFd, const char *path,
+            Encoding encoding);
+        const Stats& get_stats() const;
+        // Files smaller than maxMemoryFileSize are kept in memory, using up
+        // to memoryBudget bytes
+        void init(uint64_t maxEntries, uint64_t ttlSeconds,
+            uint64_t memoryBudget, uint64_t maxMemoryFileSize);
+
+    private:
+        // The index is keyed by views of the paths the entries own, so that
+        // a lookup can use the path it was given without copying it
+        struct Key
+        {
+            int rootDirectoryFd;
+            std::string_view path;
+            Encoding encoding;
+
+            bool operator==(const Key &other) const;
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key &key) const;
+        };
+
+        struct Entry
+        {
+            std::string path;
+            // path is a view of the path above
+            Key key;
+            File file;
+            uint64_t checked;
+        };
+
+        // Most recently used first
+        std::list<Entry> entries;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+        uint64_t maxEntries;
+        uint64_t maxMemoryFileSize;
+        uint64_t memoryBudget;
+        uint64_t memoryUsed;
+        Stats stats;
+        uint64_t ttl;
+
+        void admit(Entry &entry);
+        void drop_contents(File &file);
+        static uint64_t get_milliseconds();
+        // Drops the contents of the least recently used files other than
+        // keep until length more bytes fit in the budget, or none are left
+        void make_room(size_t length, const File &keep);
+        void revalidate(Entry &entry, uint64_t now);
+    };
+}
+
+#endif
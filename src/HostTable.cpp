@@ -0,0 +1,188 @@
+#include "HostTable.h"
+
+#define ONES 0x0101010101010101ULL
+
+awsim::HostTable::HostTable() :
+    mask(0),
+    count(0),
+    localhostDomain(nullptr)
+{
+
+}
+
+void awsim::HostTable::clear()
+{
+    slots.clear();
+    slots.shrink_to_fit();
+    names.clear();
+    names.shrink_to_fit();
+    mask = 0;
+    count = 0;
+    localhostDomain = nullptr;
+}
+
+bool awsim::HostTable::equals(const char *lower, std::string_view name)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= name.size(); i += 8)
+    {
+        uint64_t word;
+
+        memcpy(&word, lower + i, 8);
+        if (word != load_lowercase(name.data() + i, 8))
+        {
+            return false;
+        }
+    }
+    return i == name.size() || load_lowercase(lower + i, name.size() - i)
+        == load_lowercase(name.data() + i, name.size() - i);
+}
+
+const awsim::Domain* awsim::HostTable::find(std::string_view host) const
+{
+    uint64_t hostHash;
+
+    host = strip_port(host);
+    hostHash = hash(host);
+    if (!slots.empty())
+    {
+        for (size_t i = hostHash & mask; slots[i].domain != nullptr;
+            i = (i + 1) & mask)
+        {
+            const Slot &slot = slots[i];
+
+            if (slot.hash == hostHash && slot.length == host.size()
+                && equals(names.data() + slot.offset, host))
+            {
+                return slot.domain;
+            }
+        }
+    }
+    // equals() reads as many bytes of the literal as host has
+    if (host.size() == sizeof("localhost") - 1 && equals("localhost", host))
+    {
+        return localhostDomain;
+    }
+    return nullptr;
+}
+
+const awsim::Domain* awsim::HostTable::get_localhost() const
+{
+    return localhostDomain;
+}
+
+uint64_t awsim::HostTable::hash(std::string_view name)
+{
+    uint64_t result = name.size();
+    size_t i = 0;
+
+    for (; i + 8 <= name.size(); i += 8)
+    {
+        result = (result ^ load_lowercase(name.data() + i, 8))
+            * 0x9e3779b97f4a7c15ULL;
+    }
+    if (i < name.size())
+    {
+        result = (result ^ load_lowercase(name.data() + i, name.size() - i))
+            * 0x9e3779b97f4a7c15ULL;
+    }
+    // The low bits pick the slot, but the multiplications only carry
+    // upwards, so the high bits are folded down
+    result ^= result >> 32;
+    result *= 0xff51afd7ed558ccdULL;
+    return result ^ (result >> 32);
+}
+
+void awsim::HostTable::init(const std::vector<std::pair<std::string_view,
+    const Domain*>> &hosts, const Domain *localhostDomain)
+{
+    size_t capacity = 8;
+
+    clear();
+    while (capacity < hosts.size() * 2)
+    {
+        capacity *= 2;
+    }
+    slots.assign(capacity, Slot{0, 0, 0, nullptr});
+    mask = capacity - 1;
+    for (const auto &host : hosts)
+    {
+        std::string_view name = strip_port(host.first);
+        uint64_t nameHash = hash(name);
+        size_t i = nameHash & mask;
+
+        while (slots[i].domain != nullptr
+            && !(slots[i].hash == nameHash && slots[i].length == name.size()
+            && equals(names.data() + slots[i].offset, name)))
+        {
+            i = (i + 1) & mask;
+        }
+        if (slots[i].domain == nullptr)
+        {
+            count++;
+            slots[i] = Slot{nameHash, names.size(), name.size(), nullptr};
+            for (char c : name)
+            {
+                names += c >= 'A' && c <= 'Z' ? c + 'a' - 'A' : c;
+            }
+        }
+        // A duplicate name replaces the earlier one
+        slots[i].domain = host.second;
+    }
+    this->localhostDomain = localhostDomain;
+}
+
+uint64_t awsim::HostTable::load_lowercase(const char *name, size_t length)
+{
+    uint64_t word = 0;
+    uint64_t low;
+    uint64_t upper;
+
+    if (length == 8)
+    {
+        memcpy(&word, name, 8);
+    }
+    else
+    {
+        // A memcpy of a variable length would be a call
+        for (size_t i = 0; i < length; ++i)
+        {
+            word |= (uint64_t)(uint8_t)name[i] << (i * 8);
+        }
+    }
+    // The high bit of each byte ends up set when the byte is between 'A'
+    // and 'Z', the low seven bits are looked at on their own so that the
+    // additions do not carry into the next byte
+    low = word & (0x7f * ONES);
+    upper = (low + (0x80 - 'A') * ONES) & ~(low + (0x80 - 'Z' - 1) * ONES)
+        & ~word & (0x80 * ONES);
+    return word | (upper >> 2);
+}
+
+size_t awsim::HostTable::size() const
+{
+    return count;
+}
+
+std::string_view awsim::HostTable::strip_port(std::string_view host)
+{
+    size_t end;
+
+    // An IPv6 address is bracketed, the port follows the closing bracket
+    if (!host.empty() && host[0] == '[')
+    {
+        end = host.find(']');
+        return end == std::string_view::npos ? host : host.substr(0, end + 1);
+    }
+    end = host.find(':');
+    if (end != std::string_view::npos)
+    {
+        host = host.substr(0, end);
+    }
+    if (!host.empty() && host.back() == '.')
+    {
+        host.remove_suffix(1);
+    }
+    return host;
+}
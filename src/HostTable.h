@@ -0,0 +1,69 @@
+#ifndef AWSIM_HOSTTABLE_H
+#define AWSIM_HOSTTABLE_H
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+namespace awsim
+{
+    class Domain;
+
+    // Finds the domain a Host header names. Each Routing snapshot builds its
+    // own table, which is immutable once the snapshot is published, so the
+    // workers share it without locking. It is open addressed with linear
+    // probing, kept at most half full, and every slot carries the full hash
+    // of its name, so a lookup hashes the header value once and usually
+    // compares a single name. Both go eight bytes at a time, lower casing
+    // the header value on the way, against names that are stored in lower
+    // case. A lookup never allocates.
+    //
+    // Names compare case-insensitively, and the port and a trailing dot of
+    // the header value are ignored.
+    class HostTable
+    {
+    public:
+        HostTable();
+
+        void clear();
+        // Returns nullptr when no domain has the name. "localhost" names the
+        // localhost domain unless a domain has that name.
+        const Domain* find(std::string_view host) const;
+        const Domain* get_localhost() const;
+        // Replaces the table, the names are copied
+        void init(const std::vector<std::pair<std::string_view,
+            const Domain*>> &hosts, const Domain *localhostDomain);
+        size_t size() const;
+
+    private:
+        struct Slot
+        {
+            uint64_t hash;
+            // Offset of the name in names
+            size_t offset;
+            size_t length;
+            const Domain *domain;
+        };
+
+        std::vector<Slot> slots;
+        // All names in lower case, one after the other
+        std::string names;
+        size_t mask;
+        size_t count;
+        const Domain *localhostDomain;
+
+        // Whether name is lower, ignoring case. lower has to be at least as
+        // long as name.
+        static bool equals(const char *lower, std::string_view name);
+        static uint64_t hash(std::string_view name);
+        // Up to eight bytes of name, lower cased, zero padded
+        static uint64_t load_lowercase(const char *name, size_t length);
+        // The name in a Host header value, without port or trailing dot
+        static std::string_view strip_port(std::string_view host);
+    };
+}
+
+#endif
@@ -1,9 +1,11 @@
 #include "HttpParser.h"
+#include "ByteClass.h"
 
 #include <assert.h>
 #include <stddef.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <limits>
 
@@ -397,6 +399,18 @@ enum http_host_state
 #define IS_HEADER_CHAR(ch)                                                     \
   (ch == CR || ch == LF || ch == 9 || ((unsigned char)ch > 31 && ch != 127))
 
+/* The bytes that end the fast-forwarding over a header name, a header value,
+ * and a URL path or query string. Everything else needs no look, so the
+ * parser skips to the next of these many bytes at a time.
+ */
+static const ByteClass not_token([](uint8_t c) { return !TOKEN(c); });
+static const ByteClass header_value_stop([](uint8_t c) {
+  return c == CR || c == LF || c == QT || c == BS || !IS_HEADER_CHAR(c);
+});
+static const ByteClass not_url_char([](uint8_t c) {
+  return !IS_URL_CHAR(c);
+});
+
 #define start_state (parser->type == HTTP_REQUEST ? s_pre_start_req : s_pre_start_res)
 
 #define STRICT_CHECK(cond)
@@ -1117,7 +1131,15 @@ size_t http_parser_execute (HttpRequest *request,
 
       case s_req_path:
       {
-        if (IS_URL_CHAR(ch)) break;
+        if (IS_URL_CHAR(ch)) {
+          // fast-forwarding to the end of the path
+          p = not_url_char.find(p + 1, data + len);
+          if (p == data + len) {
+            --p;
+            break;
+          }
+          ch = *p;
+        }
 
         switch (ch) {
           case ' ':
@@ -1189,7 +1211,15 @@ size_t http_parser_execute (HttpRequest *request,
 
       case s_req_query_string:
       {
-        if (IS_URL_CHAR(ch)) break;
+        if (IS_URL_CHAR(ch)) {
+          // fast-forwarding to the end of the query string
+          p = not_url_char.find(p + 1, data + len);
+          if (p == data + len) {
+            --p;
+            break;
+          }
+          ch = *p;
+        }
 
         switch (ch) {
           case '?':
@@ -1476,30 +1506,13 @@ size_t http_parser_execute (HttpRequest *request,
           switch (parser->header_state) {
             case h_general:
 
-              // fast-forwarding, wheeeeeee!
-              #define MOVE_THE_HEAD do { \
-                ++p;                     \
-                if (!TOKEN(*p)) {        \
-                  ch = *p;               \
-                  goto notatoken;        \
-                }                        \
-              } while(0);
-
-              if (data + len - p >= 9) {
-                MOVE_THE_HEAD
-                MOVE_THE_HEAD
-                MOVE_THE_HEAD
-                MOVE_THE_HEAD
-                MOVE_THE_HEAD
-                MOVE_THE_HEAD
-                MOVE_THE_HEAD
-                MOVE_THE_HEAD
-              } else if (data + len - p >= 4) {
-                MOVE_THE_HEAD
-                MOVE_THE_HEAD
-                MOVE_THE_HEAD
+              // fast-forwarding to the end of the name
+              p = not_token.find(p + 1, data + len);
+              if (p != data + len) {
+                ch = *p;
+                goto notatoken;
               }
-
+              --p;
               break;
 
             /* content-length */
@@ -1675,35 +1688,13 @@ size_t http_parser_execute (HttpRequest *request,
               parser->header_state = h_general_and_quote;
             }
 
-            // fast-forwarding, wheee!
-            #define MOVE_FAST do {                    \
-              ++p;                                    \
-              ch = *p;                                \
-              if (ch == CR || ch == LF || ch == QT || \
-                  ch == BS || !IS_HEADER_CHAR(ch)) {  \
-                goto cr_or_lf_or_qt;                  \
-              }                                       \
-            } while(0);
-
-            if (data + len - p >= 12) {
-              MOVE_FAST
-              MOVE_FAST
-              MOVE_FAST
-              MOVE_FAST
-              MOVE_FAST
-              MOVE_FAST
-              MOVE_FAST
-              MOVE_FAST
-              MOVE_FAST
-              MOVE_FAST
-              MOVE_FAST
-            } else if (data + len - p >= 5) {
-              MOVE_FAST
-              MOVE_FAST
-              MOVE_FAST
-              MOVE_FAST
+            // fast-forwarding to the next byte that needs a look
+            p = header_value_stop.find(p + 1, data + len);
+            if (p != data + len) {
+              ch = *p;
+              goto cr_or_lf_or_qt;
             }
-
+            --p;
             break;
 
           case h_general_and_quote:
@@ -2131,6 +2122,233 @@ error:
 }
 
 
+
+/* The most headers a request can have and still take the fast path */
+#define FAST_MAX_HEADERS 64
+
+/* Run the notify callback FOR on the fast path, returning ER if it fails */
+#define FAST_CALLBACK_NOTIFY(FOR, ER)                                \
+do {                                                                 \
+  if (0 != settings->on_##FOR(request, details, parser)) {           \
+    SET_ERRNO(HPE_CB_##FOR);                                         \
+  }                                                                  \
+  if (HTTP_PARSER_ERRNO(parser) != HPE_OK) {                         \
+    return (ER);                                                     \
+  }                                                                  \
+} while (0)
+
+/* Run data callback FOR with a slice on the fast path, returning ER if it
+ * fails */
+#define FAST_CALLBACK_DATA(FOR, SLICE, ER)                           \
+do {                                                                 \
+  if (0 != settings->on_##FOR(request, details, parser, (SLICE).at,  \
+                              (SLICE).length)) {                     \
+    SET_ERRNO(HPE_CB_##FOR);                                         \
+  }                                                                  \
+  if (HTTP_PARSER_ERRNO(parser) != HPE_OK) {                         \
+    return (ER);                                                     \
+  }                                                                  \
+} while (0)
+
+struct fast_slice {
+  const char *at;
+  size_t length;
+};
+
+struct fast_request {
+  HTTPRequestMethod method;
+  unsigned short http_minor;
+  unsigned nheaders;
+  fast_slice url;
+  fast_slice fields[FAST_MAX_HEADERS];
+  fast_slice values[FAST_MAX_HEADERS];
+};
+
+/* Whether the header decides where the message ends or what follows it,
+ * which only http_parser_execute() keeps track of */
+static int
+is_framing_header(const char *name, size_t len)
+{
+  static const char *const framing[] = { CONTENT_LENGTH, TRANSFER_ENCODING,
+                                         UPGRADE };
+  size_t i, j;
+
+  for (i = 0; i < sizeof(framing) / sizeof(framing[0]); i++) {
+    if (strlen(framing[i]) != len) {
+      continue;
+    }
+    for (j = 0; j < len && LOWER(name[j]) == framing[i][j]; j++);
+    if (j == len) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Looks for a whole GET or HEAD request for an origin-form URL, HTTP/1.0 or
+ * HTTP/1.1, with no body and no folded header, at the start of data. Fills
+ * in the slices the callbacks get, and returns the length of the request,
+ * or 0 when http_parser_execute() has to parse it. Nothing is reported
+ * before the whole request is seen, so the other parser can always start
+ * over.
+ */
+static size_t
+parse_simple_request(const char *data, size_t len, fast_request *req)
+{
+  const char *p = data;
+  const char *end = data + len;
+
+  if (len >= 4 && memcmp(p, "GET ", 4) == 0) {
+    req->method = HTTPRequestMethod::GET;
+    p += 4;
+  } else if (len >= 5 && memcmp(p, "HEAD ", 5) == 0) {
+    req->method = HTTPRequestMethod::HEAD;
+    p += 5;
+  } else {
+    return 0;
+  }
+
+  if (p == end || *p != '/') {
+    return 0;
+  }
+  req->url.at = p;
+  do {
+    /* '?' starts the query string, and may appear again in it */
+    p = not_url_char.find(p + 1, end);
+  } while (p != end && *p == '?');
+  if (p == end || *p != ' ') {
+    return 0;
+  }
+  req->url.length = p - req->url.at;
+  p++;
+
+  if (end - p < 10 || memcmp(p, "HTTP/1.", 7) != 0 ||
+      (p[7] != '0' && p[7] != '1') || p[8] != CR || p[9] != LF) {
+    return 0;
+  }
+  req->http_minor = p[7] - '0';
+  p += 10;
+
+  for (req->nheaders = 0; ; req->nheaders++) {
+    const char *name = p;
+    const char *value;
+    int quoted = 0;
+
+    if (end - p < 2) {
+      return 0;
+    }
+    if (p[0] == CR && p[1] == LF) {
+      return p + 2 - data;
+    }
+    if (req->nheaders == FAST_MAX_HEADERS) {
+      return 0;
+    }
+
+    p = not_token.find(p, end);
+    if (p == name || p == end || *p != ':' ||
+        is_framing_header(name, p - name)) {
+      return 0;
+    }
+    req->fields[req->nheaders].at = name;
+    req->fields[req->nheaders].length = p - name;
+
+    for (p++; p != end && (*p == ' ' || *p == '\t'); p++);
+    value = p;
+    for (;;) {
+      p = header_value_stop.find(p, end);
+      if (p == end) {
+        return 0;
+      }
+      if (*p == QT) {
+        quoted = !quoted;
+        p++;
+      } else if (*p == BS) {
+        /* An escaped CR or LF does not end the value */
+        if (quoted && (end - p < 2 || p[1] == CR || p[1] == LF)) {
+          return 0;
+        }
+        p += quoted ? 2 : 1;
+      } else {
+        break;
+      }
+    }
+    /* A line starting with whitespace would continue the value */
+    if (*p != CR || end - p < 3 || p[1] != LF || p[2] == ' ' ||
+        p[2] == '\t') {
+      return 0;
+    }
+    req->values[req->nheaders].at = value;
+    req->values[req->nheaders].length = p - value;
+    p += 2;
+  }
+}
+
+size_t http_parser_execute_fast (HttpRequest *request,
+                                 ParserDetails *details,
+                                 HttpParser *parser,
+                                 const HttpParserSettings *settings,
+                                 const char *data,
+                                 size_t len)
+{
+  fast_request req;
+  size_t parsed = 0;
+
+  while (parsed < len) {
+    const char *start = data + parsed;
+    size_t request_len;
+    unsigned i;
+
+    if (parser->state != s_pre_start_req ||
+        HTTP_PARSER_ERRNO(parser) != HPE_OK ||
+        (request_len = parse_simple_request(start, len - parsed, &req)) == 0) {
+      return parsed + http_parser_execute(request, details, parser, settings,
+                                          start, len - parsed);
+    }
+
+    /* Leave the parser as http_parser_execute() would, callbacks look at
+     * it */
+    parser->state = s_start_req;
+    parser->flags = 0;
+    parser->content_length = -1;
+    parser->method = req.method;
+    parser->http_major = 1;
+    parser->http_minor = req.http_minor;
+    parser->upgrade = 0;
+
+    FAST_CALLBACK_NOTIFY(message_begin, parsed);
+    FAST_CALLBACK_DATA(url, req.url,
+                       req.url.at + req.url.length - data + 1);
+    for (i = 0; i < req.nheaders; i++) {
+      FAST_CALLBACK_DATA(header_field, req.fields[i],
+                         req.fields[i].at + req.fields[i].length - data + 1);
+      FAST_CALLBACK_DATA(header_value, req.values[i],
+                         req.values[i].at + req.values[i].length - data + 1);
+    }
+
+    /* 1 would tell a response parser to skip the body, there is none */
+    switch (settings->on_headers_complete(request, details, parser, nullptr,
+                                          request_len)) {
+      case 0:
+      case 1:
+        break;
+
+      default:
+        SET_ERRNO(HPE_CB_headers_complete);
+        return parsed + request_len - 1;
+    }
+    if (HTTP_PARSER_ERRNO(parser) != HPE_OK) {
+      return parsed + request_len - 1;
+    }
+
+    parser->nread = 0;
+    parsed += request_len;
+    parser->state = NEW_MESSAGE();
+    FAST_CALLBACK_NOTIFY(message_complete, parsed);
+  }
+
+  return parsed;
+}
+
 void
 http_parser_init (HttpParser *parser, enum http_parser_type t)
 {
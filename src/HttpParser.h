@@ -21,11 +21,6 @@ typedef unsigned __int64 uint64_t;
 #include <stdint.h>
 #endif
 
-#include <unordered_map>
-
-#include "Domain.h"
-#include "DynamicPage.h"
-#include "ParserDetails.h"
 #include "HttpRequest.h"
 
 namespace awsim {
@@ -51,7 +46,7 @@ namespace awsim {
 
 typedef struct HttpParser HttpParser;
 typedef struct HttpParserSettings HttpParserSettings;
-typedef struct ParserDetails ParserDetails;
+class ParserDetails;
 typedef struct http_parser_result http_parser_result;
 
 
@@ -288,6 +283,18 @@ size_t http_parser_execute(HttpRequest *request,
                            const char *data,
                            size_t len);
 
+/* Parses whole GET and HEAD requests without a body in a single pass, and
+ * hands anything else, including requests that are not all in data yet, to
+ * http_parser_execute(). Calls the same callbacks with the same slices and
+ * returns the same.
+ */
+size_t http_parser_execute_fast(HttpRequest *request,
+                                ParserDetails *details,
+                                HttpParser *parser,
+                                const HttpParserSettings *settings,
+                                const char *data,
+                                size_t len);
+
 /* Return a string name of the given error */
 const char *http_errno_name(enum http_errno err);
 
@@ -1,12 +1,806 @@
 #include "HttpRequest.h"
+#include "ByteClass.h"
 
-const char *awsim::HttpRequest::fieldStrings[] =
+// Hash and displace: the fields are split into buckets by the hash of their
+// name. From the fullest bucket on, each bucket gets the first displacement
+// that moves all of its fields to free slots, so no two fields share one.
+// Finding a field then takes one hash, one slot and one comparison.
+#define FIELD_BUCKETS 128
+#define FIELD_SLOTS 512
+// Enough for the 40 bytes of the longest name
+#define FIELD_WORDS 5
+
+namespace
+{
+   struct FieldTable
+   {
+      // Each name in lower case, as split_name() splits it
+      uint64_t words[awsim::HttpRequest::NUMBER_OF_FIELDS][FIELD_WORDS];
+      uint8_t lengths[awsim::HttpRequest::NUMBER_OF_FIELDS];
+      uint8_t displacements[FIELD_BUCKETS];
+      // The Field in each slot, Field::Unknown in free ones
+      uint8_t slots[FIELD_SLOTS];
+   };
+}
+
+static constexpr FieldTable build_field_table();
+static bool decode_query_component(const awsim::HttpRequest &request,
+   const char *at, size_t length, awsim::HttpRequest::Value &value);
+static bool equals_ignoring_case(const char *a, const char *b,
+   size_t length);
+static const awsim::HttpRequest::Value* find_pair(
+   const awsim::HttpRequest::Pairs &pairs, const char *name);
+static constexpr size_t get_bucket(uint64_t hash);
+static constexpr size_t get_slot(uint64_t hash, unsigned displacement);
+static constexpr uint64_t hash_words(const uint64_t *words,
+   size_t numberOfWords, size_t length);
+static int hex_value(char c);
+static constexpr uint64_t load_word(const char *bytes, size_t length);
+static awsim::HttpRequest::Pair* next_pair(awsim::HttpRequest::Pairs &pairs);
+static char* resolve_segment(char *path, char *segment, char *end);
+static void split_cookies(const awsim::HttpRequest::Value &header,
+   awsim::HttpRequest::Pairs &cookies);
+static constexpr size_t split_name(const char *name, size_t length,
+   uint64_t *words);
+static void split_query(const awsim::HttpRequest &request);
+static constexpr uint64_t to_lower(uint64_t word);
+
+// What a key or value of the query has to have decoded
+static const awsim::ByteClass queryEscape([](uint8_t c) {
+   return c == '%' || c == '+';
+});
+// Where the plain run of a path ends
+static const awsim::ByteClass pathStop([](uint8_t c) {
+   return c == '%' || c == '/' || c == '?' || c == '#';
+});
+
+static constexpr const char *FIELD_NAMES[] =
+{
+   #define AWSIM_FIELD_NAME(field, name) name,
+   AWSIM_HTTP_FIELD_MAP(AWSIM_FIELD_NAME)
+   #undef AWSIM_FIELD_NAME
+};
+
+const char *const awsim::HttpRequest::fieldStrings[] =
+{
+   #define AWSIM_FIELD_NAME(field, name) name,
+   AWSIM_HTTP_FIELD_MAP(AWSIM_FIELD_NAME)
+   #undef AWSIM_FIELD_NAME
+};
+
+static constexpr FieldTable build_field_table()
+{
+   const size_t numberOfFields = awsim::HttpRequest::NUMBER_OF_FIELDS;
+   FieldTable table = {};
+   uint64_t hashes[awsim::HttpRequest::NUMBER_OF_FIELDS] = {};
+   size_t bucketSizes[FIELD_BUCKETS] = {};
+   size_t order[FIELD_BUCKETS] = {};
+   bool taken[FIELD_SLOTS] = {};
+
+   for (size_t field = 0; field < numberOfFields; ++field)
+   {
+      size_t length = 0;
+      size_t numberOfWords = 0;
+
+      while (FIELD_NAMES[field][length] != '\0')
+      {
+         ++length;
+      }
+      if (length > 8 * FIELD_WORDS)
+      {
+         throw std::logic_error("Field name longer than FIELD_WORDS");
+      }
+      numberOfWords = split_name(FIELD_NAMES[field], length,
+         table.words[field]);
+      hashes[field] = hash_words(table.words[field], numberOfWords, length);
+      table.lengths[field] = length;
+      ++bucketSizes[get_bucket(hashes[field])];
+   }
+   for (size_t slot = 0; slot < FIELD_SLOTS; ++slot)
+   {
+      table.slots[slot] = (uint8_t)awsim::HttpRequest::Field::Unknown;
+   }
+
+   // The fullest buckets are the hardest to place, they go first
+   for (size_t i = 0; i < FIELD_BUCKETS; ++i)
+   {
+      size_t j = i;
+
+      for (; j > 0 && bucketSizes[order[j - 1]] < bucketSizes[i]; --j)
+      {
+         order[j] = order[j - 1];
+      }
+      order[j] = i;
+   }
+
+   for (size_t bucket : order)
+   {
+      unsigned displacement = 0;
+
+      if (bucketSizes[bucket] == 0)
+      {
+         break;
+      }
+      for (; displacement <= UINT8_MAX; ++displacement)
+      {
+         size_t placed = 0;
+
+         for (size_t field = 0; field < numberOfFields
+            && placed < bucketSizes[bucket]; ++field)
+         {
+            size_t slot = get_slot(hashes[field], displacement);
+
+            if (get_bucket(hashes[field]) != bucket)
+            {
+               continue;
+            }
+            if (taken[slot])
+            {
+               break;
+            }
+            taken[slot] = true;
+            ++placed;
+         }
+         if (placed == bucketSizes[bucket])
+         {
+            break;
+         }
+         for (size_t field = 0; placed > 0; ++field)
+         {
+            if (get_bucket(hashes[field]) == bucket)
+            {
+               taken[get_slot(hashes[field], displacement)] = false;
+               --placed;
+            }
+         }
+      }
+      if (displacement > UINT8_MAX)
+      {
+         throw std::logic_error("No displacement fits a bucket of fields");
+      }
+
+      table.displacements[bucket] = displacement;
+      for (size_t field = 0; field < numberOfFields; ++field)
+      {
+         if (get_bucket(hashes[field]) == bucket)
+         {
+            table.slots[get_slot(hashes[field], displacement)] = field;
+         }
+      }
+   }
+   return table;
+}
+
+// A slice of the query when it has nothing to decode, else decoded into the
+// scratch of the request. False when the scratch is full.
+static bool decode_query_component(const awsim::HttpRequest &request,
+   const char *at, size_t length, awsim::HttpRequest::Value &value)
+{
+   const char *end = at + length;
+   const char *escape = queryEscape.find(at, end);
+   char *out = request.scratch + request.scratchLength;
+
+   value.set = true;
+   if (escape == end)
+   {
+      value.buffer = at;
+      value.length = length;
+      return true;
+   }
+   // Decoding only ever shortens
+   if (length > awsim::HttpRequest::SCRATCH_SIZE - request.scratchLength)
+   {
+      return false;
+   }
+   value.buffer = out;
+   while (at != end)
+   {
+      memcpy(out, at, escape - at);
+      out += escape - at;
+      at = escape;
+      if (at == end)
+      {
+         break;
+      }
+      if (*at == '+')
+      {
+         *out++ = ' ';
+         ++at;
+      }
+      else if (end - at >= 3 && hex_value(at[1]) >= 0
+         && hex_value(at[2]) >= 0)
+      {
+         *out++ = (char)(hex_value(at[1]) << 4 | hex_value(at[2]));
+         at += 3;
+      }
+      else
+      {
+         // A '%' that starts no escape is itself
+         *out++ = *at++;
+      }
+      escape = queryEscape.find(at, end);
+   }
+   value.length = out - value.buffer;
+   request.scratchLength += value.length;
+   return true;
+}
+
+static bool equals_ignoring_case(const char *a, const char *b,
+   size_t length)
+{
+   for (size_t i = 0; i < length; ++i)
+   {
+      if (to_lower((uint8_t)a[i]) != to_lower((uint8_t)b[i]))
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+static const awsim::HttpRequest::Value* find_pair(
+   const awsim::HttpRequest::Pairs &pairs, const char *name)
+{
+   size_t length = strlen(name);
+
+   for (unsigned i = 0; i < pairs.numberOfPairs; ++i)
+   {
+      const awsim::HttpRequest::Pair &pair = pairs.pairs[i];
+
+      if (pair.name.length == length
+         && memcmp(pair.name.buffer, name, length) == 0)
+      {
+         return &pair.value;
+      }
+   }
+   return nullptr;
+}
+
+static constexpr size_t get_bucket(uint64_t hash)
+{
+   return (hash >> 32) & (FIELD_BUCKETS - 1);
+}
+
+static constexpr size_t get_slot(uint64_t hash, unsigned displacement)
+{
+   // Each displacement scatters the fields of a bucket differently
+   hash ^= (displacement + 1) * 0x9e3779b97f4a7c15ULL;
+   hash ^= hash >> 31;
+   hash *= 0xbf58476d1ce4e5b9ULL;
+   hash ^= hash >> 29;
+   return hash & (FIELD_SLOTS - 1);
+}
+
+static constexpr uint64_t hash_words(const uint64_t *words,
+   size_t numberOfWords, size_t length)
+{
+   uint64_t hash = length;
+
+   for (size_t i = 0; i < numberOfWords; ++i)
+   {
+      hash = (hash ^ words[i]) * 0x9e3779b97f4a7c15ULL;
+      hash ^= hash >> 32;
+   }
+   return hash;
+}
+
+// -1 when c is no hex digit
+static int hex_value(char c)
+{
+   if (c >= '0' && c <= '9')
+   {
+      return c - '0';
+   }
+   c |= 0x20;
+   if (c >= 'a' && c <= 'f')
+   {
+      return c - 'a' + 10;
+   }
+   return -1;
+}
+
+// Up to 8 bytes, the first in the lowest byte of the word
+static constexpr uint64_t load_word(const char *bytes, size_t length)
+{
+   uint64_t word = 0;
+
+   // The compiler does not merge the loop below into one load
+   if (length == 8 && !__builtin_is_constant_evaluated())
+   {
+      memcpy(&word, bytes, 8);
+      return le64toh(word);
+   }
+   for (size_t i = 0; i < length; ++i)
+   {
+      word |= (uint64_t)(uint8_t)bytes[i] << (8 * i);
+   }
+   return word;
+}
+
+// Room for one more pair, nullptr when there is none. The pairs move out of
+// the request the first time there are more than INLINE_PAIRS, and stay out
+// for the requests after.
+static awsim::HttpRequest::Pair* next_pair(awsim::HttpRequest::Pairs &pairs)
+{
+   awsim::HttpRequest::Pair *grown;
+
+   if (pairs.numberOfPairs == awsim::HttpRequest::MAX_PAIRS)
+   {
+      return nullptr;
+   }
+   if (pairs.pairs == pairs.inlinePairs
+      && pairs.numberOfPairs == awsim::HttpRequest::INLINE_PAIRS)
+   {
+      grown = (awsim::HttpRequest::Pair*)malloc(
+         sizeof(awsim::HttpRequest::Pair) * awsim::HttpRequest::MAX_PAIRS);
+      if (grown == nullptr)
+      {
+         return nullptr;
+      }
+      memcpy(grown, pairs.inlinePairs, sizeof(pairs.inlinePairs));
+      pairs.pairs = grown;
+   }
+   return &pairs.pairs[pairs.numberOfPairs];
+}
+
+// Drops the segment from segment to end of the path when it is ".", and the
+// one before it too when it is "..". Every segment is preceded by a '/'.
+// Returns the new end, nullptr when ".." would climb above the root.
+static char* resolve_segment(char *path, char *segment, char *end)
+{
+   size_t length = end - segment;
+
+   if (length == 1 && segment[0] == '.')
+   {
+      return segment;
+   }
+   if (length == 2 && segment[0] == '.' && segment[1] == '.')
+   {
+      if (segment - 1 == path)
+      {
+         return nullptr;
+      }
+      end = segment - 1;
+      while (end[-1] != '/')
+      {
+         --end;
+      }
+   }
+   return end;
+}
+
+// "name=value; name2=value2", with no decoding but the quotes around a
+// value dropped. A cookie without '=' has an empty name, as browsers keep
+// it.
+static void split_cookies(const awsim::HttpRequest::Value &header,
+   awsim::HttpRequest::Pairs &cookies)
+{
+   const char *it = header.buffer;
+   const char *end = header.buffer + header.length;
+
+   cookies.numberOfPairs = 0;
+   while (it != end)
+   {
+      const char *semicolon = (const char*)memchr(it, ';', end - it);
+      const char *pairEnd = semicolon == nullptr ? end : semicolon;
+      const char *equals;
+      awsim::HttpRequest::Pair *cookie = next_pair(cookies);
+
+      if (cookie == nullptr)
+      {
+         break;
+      }
+      while (it != pairEnd && (*it == ' ' || *it == '\t'))
+      {
+         ++it;
+      }
+      while (pairEnd != it && (pairEnd[-1] == ' ' || pairEnd[-1] == '\t'))
+      {
+         --pairEnd;
+      }
+      if (it != pairEnd)
+      {
+         equals = (const char*)memchr(it, '=', pairEnd - it);
+         cookie->name.buffer = it;
+         cookie->name.length = equals == nullptr ? 0 : equals - it;
+         cookie->name.set = true;
+         cookie->value.buffer = equals == nullptr ? it : equals + 1;
+         cookie->value.length = pairEnd - cookie->value.buffer;
+         cookie->value.set = true;
+         if (cookie->value.length >= 2 && cookie->value.buffer[0] == '"'
+            && cookie->value.buffer[cookie->value.length - 1] == '"')
+         {
+            cookie->value.buffer++;
+            cookie->value.length -= 2;
+         }
+         cookies.numberOfPairs++;
+      }
+      it = semicolon == nullptr ? end : semicolon + 1;
+   }
+   cookies.split = true;
+}
+
+// The name in lower case as words: the first bytes 8 at a time, then the
+// last 8, which may overlap the ones before. A name of up to 8 bytes is one
+// word. Returns the number of words.
+static constexpr size_t split_name(const char *name, size_t length,
+   uint64_t *words)
 {
-   "Host",
-   "User-Agent",
-   "Accept",
-   "Accept-Language",
-   "Accept-Encoding",
-   "Connection",
-   "Upgrade-Insecure-Requests",
+   size_t numberOfWords = 0;
+
+   if (length <= 8)
+   {
+      words[0] = to_lower(load_word(name, length));
+      return 1;
+   }
+   for (size_t i = 0; i + 8 < length; i += 8)
+   {
+      words[numberOfWords++] = to_lower(load_word(name + i, 8));
+   }
+   words[numberOfWords++] = to_lower(load_word(name + length - 8, 8));
+   return numberOfWords;
+}
+
+// "key=value&key2=value2", split before it is decoded so that an escaped
+// '&' or '=' stays in its key or value
+static void split_query(const awsim::HttpRequest &request)
+{
+   awsim::HttpRequest::Pairs &pairs = request.queryPairs;
+   const char *it = request.query.buffer;
+   const char *end = request.query.buffer + request.query.length;
+
+   pairs.numberOfPairs = 0;
+   while (it != end)
+   {
+      const char *ampersand = (const char*)memchr(it, '&', end - it);
+      const char *pairEnd = ampersand == nullptr ? end : ampersand;
+      const char *equals = (const char*)memchr(it, '=', pairEnd - it);
+      awsim::HttpRequest::Pair *pair = next_pair(pairs);
+
+      if (pair == nullptr)
+      {
+         break;
+      }
+      if (it != pairEnd
+         && decode_query_component(request, it,
+         (equals == nullptr ? pairEnd : equals) - it, pair->name)
+         && decode_query_component(request,
+         equals == nullptr ? pairEnd : equals + 1,
+         equals == nullptr ? 0 : pairEnd - equals - 1, pair->value))
+      {
+         pairs.numberOfPairs++;
+      }
+      it = ampersand == nullptr ? end : ampersand + 1;
+   }
+   pairs.split = true;
+}
+
+// Sets bit 5 of the bytes of the word that are upper case letters, all
+// bytes at once
+static constexpr uint64_t to_lower(uint64_t word)
+{
+   const uint64_t ones = 0x0101010101010101ULL;
+   uint64_t ascii = word & (0x7f * ones);
+   uint64_t aboveZ = ascii + (0x7f - 'Z') * ones;
+   uint64_t fromA = ascii + (0x80 - 'A') * ones;
+
+   return word | (((fromA ^ aboveZ) & ~word & (0x80 * ones)) >> 2);
+}
+
+static constexpr FieldTable fieldTable = build_field_table();
+
+const char *awsim::HttpRequest::methodStrings[] =
+{
+   "DELETE",
+   "GET",
+   "HEAD",
+   "POST",
+   "PUT",
+   "CONNECT",
+   "OPTIONS",
+   "TRACE",
+   "COPY",
+   "LOCK",
+   "MKCOL",
+   "MOVE",
+   "PROPFIND",
+   "PROPPATCH",
+   "UNLOCK",
+   "REPORT",
+   "MKACTIVITY",
+   "CHECKOUT",
+   "MERGE",
+   "M-SEARCH",
+   "NOTIFY",
+   "SUBSCRIBE",
+   "UNSUBSCRIBE",
+   "PATCH",
 };
+
+const awsim::HttpRequest::Value* awsim::HttpRequest::get_param(
+   const char *name) const
+{
+   size_t nameLength = strlen(name);
+
+   for (unsigned i = 0; i < numberOfParams; ++i)
+   {
+      if (params[i].nameLength == nameLength
+         && memcmp(params[i].name, name, nameLength) == 0)
+      {
+         return &params[i].value;
+      }
+   }
+   return nullptr;
+}
+
+const awsim::HttpRequest::Pairs& awsim::HttpRequest::get_query_pairs() const
+{
+   if (!queryPairs.split)
+   {
+      split_query(*this);
+   }
+   return queryPairs;
+}
+
+const awsim::HttpRequest::Value* awsim::HttpRequest::get_query_value(
+   const char *name) const
+{
+   return find_pair(get_query_pairs(), name);
+}
+
+awsim::HttpRequest::HttpRequest()
+{
+   scratch = nullptr;
+   clear();
+}
+
+awsim::HttpRequest::~HttpRequest()
+{
+   free(scratch);
+   if (queryPairs.pairs != queryPairs.inlinePairs)
+   {
+      free(queryPairs.pairs);
+   }
+   if (cookies.pairs != cookies.inlinePairs)
+   {
+      free(cookies.pairs);
+   }
+}
+
+awsim::HttpRequest::Value* awsim::HttpRequest::add_field(Field field)
+{
+   uint8_t &slot = fieldSlots[(size_t)field];
+
+   // A repeated header replaces the earlier one
+   if (slot == 0)
+   {
+      if (numberOfFieldValues == MAX_FIELD_VALUES)
+      {
+         return nullptr;
+      }
+      slot = ++numberOfFieldValues;
+   }
+   fieldValues[slot - 1] = Value();
+   return &fieldValues[slot - 1];
+}
+
+awsim::HttpRequest::Header* awsim::HttpRequest::add_unknown_header()
+{
+   if (numberOfUnknownHeaders == MAX_UNKNOWN_HEADERS)
+   {
+      return nullptr;
+   }
+   unknownHeaders[numberOfUnknownHeaders] = Header();
+   return &unknownHeaders[numberOfUnknownHeaders++];
+}
+
+void awsim::HttpRequest::clear()
+{
+   url = Value();
+   path = Value();
+   query = Value();
+   fragment = Value();
+   body = Value();
+   bodyFd = -1;
+   pageData = nullptr;
+   queryPairs.split = false;
+   cookies.split = false;
+   scratchLength = 0;
+   memset(fieldSlots, 0, sizeof(fieldSlots));
+   numberOfFieldValues = 0;
+   numberOfUnknownHeaders = 0;
+   numberOfParams = 0;
+}
+
+const awsim::HttpRequest::Value* awsim::HttpRequest::get_cookie(
+   const char *name) const
+{
+   return find_pair(get_cookies(), name);
+}
+
+const awsim::HttpRequest::Pairs& awsim::HttpRequest::get_cookies() const
+{
+   if (!cookies.split)
+   {
+      split_cookies(get_field(Field::Cookie), cookies);
+   }
+   return cookies;
+}
+
+awsim::HttpRequest::Field awsim::HttpRequest::find_field(const char *name,
+   size_t length)
+{
+   uint64_t words[FIELD_WORDS];
+   size_t numberOfWords;
+   uint64_t hash;
+   uint8_t field;
+
+   if (length > 8 * FIELD_WORDS)
+   {
+      return Field::Unknown;
+   }
+   numberOfWords = split_name(name, length, words);
+   hash = hash_words(words, numberOfWords, length);
+   field = fieldTable.slots[get_slot(hash,
+      fieldTable.displacements[get_bucket(hash)])];
+   if (field == (uint8_t)Field::Unknown || fieldTable.lengths[field] != length)
+   {
+      return Field::Unknown;
+   }
+   for (size_t i = 0; i < numberOfWords; ++i)
+   {
+      if (fieldTable.words[field][i] != words[i])
+      {
+         return Field::Unknown;
+      }
+   }
+   return (Field)field;
+}
+
+const awsim::HttpRequest::Value& awsim::HttpRequest::get_field(Field field)
+   const
+{
+   static const Value unset;
+   uint8_t slot = fieldSlots[(size_t)field];
+
+   return slot == 0 ? unset : fieldValues[slot - 1];
+}
+
+const awsim::HttpRequest::Value* awsim::HttpRequest::get_header(
+   const char *name) const
+{
+   size_t length = strlen(name);
+   Field field = find_field(name, length);
+
+   if (field != Field::Unknown)
+   {
+      const Value &value = get_field(field);
+
+      return value.set ? &value : nullptr;
+   }
+   for (unsigned i = 0; i < numberOfUnknownHeaders; ++i)
+   {
+      const Header &header = unknownHeaders[i];
+
+      if (header.name.length == length
+         && equals_ignoring_case(header.name.buffer, name, length))
+      {
+         return &header.value;
+      }
+   }
+   return nullptr;
+}
+
+bool awsim::HttpRequest::normalize_url()
+{
+   const char *it = url.buffer;
+   const char *end = url.buffer + url.length;
+   char *out;
+   char *segment;
+
+   if (scratch == nullptr)
+   {
+      scratch = (char*)malloc(SCRATCH_SIZE);
+      if (scratch == nullptr)
+      {
+         throw std::runtime_error("malloc(" + std::to_string(SCRATCH_SIZE)
+            + ") failed -> " + strerror(errno));
+      }
+   }
+   out = scratch;
+   // A proxy sends the absolute form, whose path starts after the authority
+   if (it != end && *it != '/')
+   {
+      it = (const char*)memmem(it, url.length, "://", 3);
+      if (it == nullptr)
+      {
+         return false;
+      }
+      it += 3;
+      while (it != end && *it != '/' && *it != '?' && *it != '#')
+      {
+         ++it;
+      }
+   }
+   if (it != end && *it == '/')
+   {
+      ++it;
+   }
+   *out++ = '/';
+   segment = out;
+
+   // Runs without an escape or a slash are copied whole, the dot segments
+   // are resolved on the decoded bytes so that %2e%2e is a ".." as well
+   for (;;)
+   {
+      const char *stop = pathStop.find(it, end);
+      size_t length = stop - it;
+      int high;
+      int low;
+
+      if (length >= (size_t)(scratch + MAX_PATH_LENGTH - out))
+      {
+         return false;
+      }
+      memcpy(out, it, length);
+      out += length;
+      it = stop;
+
+      if (it != end && *it == '%')
+      {
+         if (end - it < 3 || (high = hex_value(it[1])) < 0
+            || (low = hex_value(it[2])) < 0)
+         {
+            return false;
+         }
+         // An escaped slash would be a separator to the file system but
+         // not to the resolution above, a NUL would cut the path short
+         *out = (char)(high << 4 | low);
+         if (*out == '/' || *out == '\0')
+         {
+            return false;
+         }
+         ++out;
+         it += 3;
+         continue;
+      }
+
+      out = resolve_segment(scratch, segment, out);
+      if (out == nullptr)
+      {
+         return false;
+      }
+      if (it == end || *it != '/')
+      {
+         break;
+      }
+      ++it;
+      // An empty segment adds no second slash
+      if (out[-1] != '/')
+      {
+         *out++ = '/';
+      }
+      segment = out;
+   }
+
+   path.buffer = scratch;
+   path.length = out - scratch;
+   path.set = true;
+   scratchLength = path.length;
+   if (it != end && *it == '?')
+   {
+      const char *hash = (const char*)memchr(it, '#', end - it);
+
+      query.buffer = it + 1;
+      query.length = (hash == nullptr ? end : hash) - query.buffer;
+      query.set = true;
+      it = query.buffer + query.length;
+   }
+   if (it != end)
+   {
+      fragment.buffer = it + 1;
+      fragment.length = end - fragment.buffer;
+      fragment.set = true;
+   }
+   return true;
+}
@@ -1,26 +1,281 @@
 #ifndef AWSIM_HTTPREQUEST_H
 #define AWSIM_HTTPREQUEST_H
 
+#include <endian.h>
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
 #include <vector>
 
+// Every header field HttpRequest has a slot for, as XX(Field, name)
+#define AWSIM_HTTP_FIELD_MAP(XX)                                             \
+  /* IANA HTTP Field Name Registry */                                        \
+  XX(AIm, "A-IM")                                                            \
+  XX(Accept, "Accept")                                                       \
+  XX(AcceptAdditions, "Accept-Additions")                                    \
+  XX(AcceptCh, "Accept-CH")                                                  \
+  XX(AcceptCharset, "Accept-Charset")                                        \
+  XX(AcceptDatetime, "Accept-Datetime")                                      \
+  XX(AcceptEncoding, "Accept-Encoding")                                      \
+  XX(AcceptFeatures, "Accept-Features")                                      \
+  XX(AcceptLanguage, "Accept-Language")                                      \
+  XX(AcceptPatch, "Accept-Patch")                                            \
+  XX(AcceptPost, "Accept-Post")                                              \
+  XX(AcceptRanges, "Accept-Ranges")                                          \
+  XX(AcceptSignature, "Accept-Signature")                                    \
+  XX(AccessControlAllowCredentials, "Access-Control-Allow-Credentials")      \
+  XX(AccessControlAllowHeaders, "Access-Control-Allow-Headers")              \
+  XX(AccessControlAllowMethods, "Access-Control-Allow-Methods")              \
+  XX(AccessControlAllowOrigin, "Access-Control-Allow-Origin")                \
+  XX(AccessControlExposeHeaders, "Access-Control-Expose-Headers")            \
+  XX(AccessControlMaxAge, "Access-Control-Max-Age")                          \
+  XX(AccessControlRequestHeaders, "Access-Control-Request-Headers")          \
+  XX(AccessControlRequestMethod, "Access-Control-Request-Method")            \
+  XX(Age, "Age")                                                             \
+  XX(Allow, "Allow")                                                         \
+  XX(Alpn, "ALPN")                                                           \
+  XX(AltSvc, "Alt-Svc")                                                      \
+  XX(AltUsed, "Alt-Used")                                                    \
+  XX(Alternates, "Alternates")                                               \
+  XX(AmpCacheTransform, "AMP-Cache-Transform")                               \
+  XX(ApplyToRedirectRef, "Apply-To-Redirect-Ref")                            \
+  XX(AuthenticationControl, "Authentication-Control")                        \
+  XX(AuthenticationInfo, "Authentication-Info")                              \
+  XX(Authorization, "Authorization")                                         \
+  XX(CExt, "C-Ext")                                                          \
+  XX(CMan, "C-Man")                                                          \
+  XX(COpt, "C-Opt")                                                          \
+  XX(CPep, "C-PEP")                                                          \
+  XX(CPepInfo, "C-PEP-Info")                                                 \
+  XX(CacheControl, "Cache-Control")                                          \
+  XX(CacheStatus, "Cache-Status")                                            \
+  XX(CalManagedId, "Cal-Managed-ID")                                         \
+  XX(CalDavTimezones, "CalDAV-Timezones")                                    \
+  XX(CapsuleProtocol, "Capsule-Protocol")                                    \
+  XX(CdnCacheControl, "CDN-Cache-Control")                                   \
+  XX(CdnLoop, "CDN-Loop")                                                    \
+  XX(CertNotAfter, "Cert-Not-After")                                         \
+  XX(CertNotBefore, "Cert-Not-Before")                                       \
+  XX(ClearSiteData, "Clear-Site-Data")                                       \
+  XX(ClientCert, "Client-Cert")                                              \
+  XX(ClientCertChain, "Client-Cert-Chain")                                   \
+  XX(Close, "Close")                                                         \
+  XX(ConfigurationContext, "Configuration-Context")                          \
+  XX(Connection, "Connection")                                               \
+  XX(ContentBase, "Content-Base")                                            \
+  XX(ContentDigest, "Content-Digest")                                        \
+  XX(ContentDisposition, "Content-Disposition")                              \
+  XX(ContentEncoding, "Content-Encoding")                                    \
+  XX(ContentId, "Content-ID")                                                \
+  XX(ContentLanguage, "Content-Language")                                    \
+  XX(ContentLength, "Content-Length")                                        \
+  XX(ContentLocation, "Content-Location")                                    \
+  XX(ContentMd5, "Content-MD5")                                              \
+  XX(ContentRange, "Content-Range")                                          \
+  XX(ContentScriptType, "Content-Script-Type")                               \
+  XX(ContentSecurityPolicy, "Content-Security-Policy")                       \
+  XX(ContentSecurityPolicyReportOnly, "Content-Security-Policy-Report-Only") \
+  XX(ContentStyleType, "Content-Style-Type")                                 \
+  XX(ContentType, "Content-Type")                                            \
+  XX(ContentVersion, "Content-Version")                                      \
+  XX(Cookie, "Cookie")                                                       \
+  XX(Cookie2, "Cookie2")                                                     \
+  XX(CrossOriginEmbedderPolicy, "Cross-Origin-Embedder-Policy")              \
+  XX(CrossOriginEmbedderPolicyReportOnly,                                    \
+     "Cross-Origin-Embedder-Policy-Report-Only")                             \
+  XX(CrossOriginOpenerPolicy, "Cross-Origin-Opener-Policy")                  \
+  XX(CrossOriginOpenerPolicyReportOnly,                                      \
+     "Cross-Origin-Opener-Policy-Report-Only")                               \
+  XX(CrossOriginResourcePolicy, "Cross-Origin-Resource-Policy")              \
+  XX(Dasl, "DASL")                                                           \
+  XX(Date, "Date")                                                           \
+  XX(Dav, "DAV")                                                             \
+  XX(DefaultStyle, "Default-Style")                                          \
+  XX(DeltaBase, "Delta-Base")                                                \
+  XX(Depth, "Depth")                                                         \
+  XX(DerivedFrom, "Derived-From")                                            \
+  XX(Destination, "Destination")                                             \
+  XX(DifferentialId, "Differential-ID")                                      \
+  XX(Digest, "Digest")                                                       \
+  XX(EarlyData, "Early-Data")                                                \
+  XX(EdiintFeatures, "EDIINT-Features")                                      \
+  XX(ETag, "ETag")                                                           \
+  XX(Expect, "Expect")                                                       \
+  XX(ExpectCt, "Expect-CT")                                                  \
+  XX(Expires, "Expires")                                                     \
+  XX(Ext, "Ext")                                                             \
+  XX(Forwarded, "Forwarded")                                                 \
+  XX(From, "From")                                                           \
+  XX(GetProfile, "GetProfile")                                               \
+  XX(Hobareg, "Hobareg")                                                     \
+  XX(Host, "Host")                                                           \
+  XX(Http2Settings, "HTTP2-Settings")                                        \
+  XX(If, "If")                                                               \
+  XX(IfMatch, "If-Match")                                                    \
+  XX(IfModifiedSince, "If-Modified-Since")                                   \
+  XX(IfNoneMatch, "If-None-Match")                                           \
+  XX(IfRange, "If-Range")                                                    \
+  XX(IfScheduleTagMatch, "If-Schedule-Tag-Match")                            \
+  XX(IfUnmodifiedSince, "If-Unmodified-Since")                               \
+  XX(Im, "IM")                                                               \
+  XX(IncludeReferredTokenBindingId, "Include-Referred-Token-Binding-ID")     \
+  XX(Isolation, "Isolation")                                                 \
+  XX(KeepAlive, "Keep-Alive")                                                \
+  XX(Label, "Label")                                                         \
+  XX(LastEventId, "Last-Event-ID")                                           \
+  XX(LastModified, "Last-Modified")                                          \
+  XX(Link, "Link")                                                           \
+  XX(Location, "Location")                                                   \
+  XX(LockToken, "Lock-Token")                                                \
+  XX(Man, "Man")                                                             \
+  XX(MaxForwards, "Max-Forwards")                                            \
+  XX(MementoDatetime, "Memento-Datetime")                                    \
+  XX(Meter, "Meter")                                                         \
+  XX(MethodCheck, "Method-Check")                                            \
+  XX(MethodCheckExpires, "Method-Check-Expires")                             \
+  XX(MimeVersion, "MIME-Version")                                            \
+  XX(Negotiate, "Negotiate")                                                 \
+  XX(Nel, "NEL")                                                             \
+  XX(ODataEntityId, "OData-EntityId")                                        \
+  XX(ODataIsolation, "OData-Isolation")                                      \
+  XX(ODataMaxVersion, "OData-MaxVersion")                                    \
+  XX(ODataVersion, "OData-Version")                                          \
+  XX(Opt, "Opt")                                                             \
+  XX(OptionalWwwAuthenticate, "Optional-WWW-Authenticate")                   \
+  XX(OrderingType, "Ordering-Type")                                          \
+  XX(Origin, "Origin")                                                       \
+  XX(OriginAgentCluster, "Origin-Agent-Cluster")                             \
+  XX(Oscore, "OSCORE")                                                       \
+  XX(OslcCoreVersion, "OSLC-Core-Version")                                   \
+  XX(Overwrite, "Overwrite")                                                 \
+  XX(P3p, "P3P")                                                             \
+  XX(Pep, "PEP")                                                             \
+  XX(PepInfo, "PEP-Info")                                                    \
+  XX(PermissionsPolicy, "Permissions-Policy")                                \
+  XX(PicsLabel, "PICS-Label")                                                \
+  XX(PingFrom, "Ping-From")                                                  \
+  XX(PingTo, "Ping-To")                                                      \
+  XX(Position, "Position")                                                   \
+  XX(Pragma, "Pragma")                                                       \
+  XX(Prefer, "Prefer")                                                       \
+  XX(PreferenceApplied, "Preference-Applied")                                \
+  XX(Priority, "Priority")                                                   \
+  XX(ProfileObject, "ProfileObject")                                         \
+  XX(Protocol, "Protocol")                                                   \
+  XX(ProtocolInfo, "Protocol-Info")                                          \
+  XX(ProtocolQuery, "Protocol-Query")                                        \
+  XX(ProtocolRequest, "Protocol-Request")                                    \
+  XX(ProxyAuthenticate, "Proxy-Authenticate")                                \
+  XX(ProxyAuthenticationInfo, "Proxy-Authentication-Info")                   \
+  XX(ProxyAuthorization, "Proxy-Authorization")                              \
+  XX(ProxyFeatures, "Proxy-Features")                                        \
+  XX(ProxyInstruction, "Proxy-Instruction")                                  \
+  XX(ProxyStatus, "Proxy-Status")                                            \
+  XX(Public, "Public")                                                       \
+  XX(PublicKeyPins, "Public-Key-Pins")                                       \
+  XX(PublicKeyPinsReportOnly, "Public-Key-Pins-Report-Only")                 \
+  XX(Range, "Range")                                                         \
+  XX(RedirectRef, "Redirect-Ref")                                            \
+  XX(Referer, "Referer")                                                     \
+  XX(RefererRoot, "Referer-Root")                                            \
+  XX(Refresh, "Refresh")                                                     \
+  XX(RepeatabilityClientId, "Repeatability-Client-ID")                       \
+  XX(RepeatabilityFirstSent, "Repeatability-First-Sent")                     \
+  XX(RepeatabilityRequestId, "Repeatability-Request-ID")                     \
+  XX(RepeatabilityResult, "Repeatability-Result")                            \
+  XX(ReplayNonce, "Replay-Nonce")                                            \
+  XX(ReportingEndpoints, "Reporting-Endpoints")                              \
+  XX(ReprDigest, "Repr-Digest")                                              \
+  XX(RetryAfter, "Retry-After")                                              \
+  XX(Safe, "Safe")                                                           \
+  XX(ScheduleReply, "Schedule-Reply")                                        \
+  XX(ScheduleTag, "Schedule-Tag")                                            \
+  XX(SecGpc, "Sec-GPC")                                                      \
+  XX(SecPurpose, "Sec-Purpose")                                              \
+  XX(SecTokenBinding, "Sec-Token-Binding")                                   \
+  XX(SecWebSocketAccept, "Sec-WebSocket-Accept")                             \
+  XX(SecWebSocketExtensions, "Sec-WebSocket-Extensions")                     \
+  XX(SecWebSocketKey, "Sec-WebSocket-Key")                                   \
+  XX(SecWebSocketProtocol, "Sec-WebSocket-Protocol")                         \
+  XX(SecWebSocketVersion, "Sec-WebSocket-Version")                           \
+  XX(SecurityScheme, "Security-Scheme")                                      \
+  XX(Server, "Server")                                                       \
+  XX(ServerTiming, "Server-Timing")                                          \
+  XX(SetCookie, "Set-Cookie")                                                \
+  XX(SetCookie2, "Set-Cookie2")                                              \
+  XX(SetProfile, "SetProfile")                                               \
+  XX(Signature, "Signature")                                                 \
+  XX(SignatureInput, "Signature-Input")                                      \
+  XX(Slug, "SLUG")                                                           \
+  XX(SoapAction, "SoapAction")                                               \
+  XX(StatusUri, "Status-URI")                                                \
+  XX(StrictTransportSecurity, "Strict-Transport-Security")                   \
+  XX(Sunset, "Sunset")                                                       \
+  XX(SurrogateCapability, "Surrogate-Capability")                            \
+  XX(SurrogateControl, "Surrogate-Control")                                  \
+  XX(Tcn, "TCN")                                                             \
+  XX(Te, "TE")                                                               \
+  XX(Timeout, "Timeout")                                                     \
+  XX(TimingAllowOrigin, "Timing-Allow-Origin")                               \
+  XX(Topic, "Topic")                                                         \
+  XX(Traceparent, "Traceparent")                                             \
+  XX(Tracestate, "Tracestate")                                               \
+  XX(Trailer, "Trailer")                                                     \
+  XX(TransferEncoding, "Transfer-Encoding")                                  \
+  XX(Ttl, "TTL")                                                             \
+  XX(Upgrade, "Upgrade")                                                     \
+  XX(Urgency, "Urgency")                                                     \
+  XX(Uri, "URI")                                                             \
+  XX(UserAgent, "User-Agent")                                                \
+  XX(VariantVary, "Variant-Vary")                                            \
+  XX(Vary, "Vary")                                                           \
+  XX(Via, "Via")                                                             \
+  XX(WantContentDigest, "Want-Content-Digest")                               \
+  XX(WantDigest, "Want-Digest")                                              \
+  XX(WantReprDigest, "Want-Repr-Digest")                                     \
+  XX(Warning, "Warning")                                                     \
+  XX(WwwAuthenticate, "WWW-Authenticate")                                    \
+  XX(XContentTypeOptions, "X-Content-Type-Options")                          \
+  XX(XFrameOptions, "X-Frame-Options")                                       \
+  /* Not registered, but sent by browsers and proxies all the time */        \
+  XX(Dnt, "DNT")                                                             \
+  XX(SecChUa, "Sec-CH-UA")                                                   \
+  XX(SecChUaMobile, "Sec-CH-UA-Mobile")                                      \
+  XX(SecChUaPlatform, "Sec-CH-UA-Platform")                                  \
+  XX(SecFetchDest, "Sec-Fetch-Dest")                                         \
+  XX(SecFetchMode, "Sec-Fetch-Mode")                                         \
+  XX(SecFetchSite, "Sec-Fetch-Site")                                         \
+  XX(SecFetchUser, "Sec-Fetch-User")                                         \
+  XX(UpgradeInsecureRequests, "Upgrade-Insecure-Requests")                   \
+  XX(XForwardedFor, "X-Forwarded-For")                                       \
+  XX(XForwardedHost, "X-Forwarded-Host")                                     \
+  XX(XForwardedProto, "X-Forwarded-Proto")                                   \
+  XX(XRealIp, "X-Real-IP")                                                   \
+  XX(XRequestedWith, "X-Requested-With")
+
 namespace awsim
 {
     struct HttpRequest
     {
-        static const char *fieldStrings[];
-
-        enum class Field
+        enum class Field : uint8_t
         {
-            Host = 0,
-            UserAgent = 1,
-            Accept = 2,
-            AcceptLanguage = 3,
-            AcceptEncoding = 4,
-            Connection = 5,
-            UpgradeInsecureRequests = 6,
-            Unknown = 7
+            #define AWSIM_FIELD_ENUM(field, name) field,
+            AWSIM_HTTP_FIELD_MAP(AWSIM_FIELD_ENUM)
+            #undef AWSIM_FIELD_ENUM
+            Unknown
         };
 
+        static const size_t NUMBER_OF_FIELDS = (size_t)Field::Unknown;
+        // By Field, in the case of the registry
+        static const char *const fieldStrings[];
+        // By Method
+        static const char *methodStrings[];
+
         enum class Method
         {
             DELETE = 0,
@@ -56,15 +311,131 @@ namespace awsim
             bool set = false;
         };
 
+        // A header without a Field, both slices of the read buffer
+        struct Header
+        {
+            Value name;
+            Value value;
+        };
+
+        // A ":name" or "*name" in the route of a dynamic page, and the part
+        // of the URL it captured
+        struct Param
+        {
+            const char *name = nullptr;
+            size_t nameLength = 0;
+            Value value;
+        };
+
+        // A key of the query string or a cookie, and its value
+        struct Pair
+        {
+            Value name;
+            Value value;
+        };
+
+        // Further headers, and further pairs of the query string or the
+        // Cookie header, are dropped. The first INLINE_PAIRS pairs are kept
+        // in the request, room for the rest is allocated the first time a
+        // request has more.
+        static const unsigned MAX_FIELD_VALUES = 32;
+        static const unsigned INLINE_PAIRS = 8;
+        static const unsigned MAX_PAIRS = 32;
+        static const unsigned MAX_PARAMS = 8;
+        static const unsigned MAX_UNKNOWN_HEADERS = 16;
+        // Longer paths could not be opened anyway
+        static const size_t MAX_PATH_LENGTH = PATH_MAX;
+        // The decoded path, then the decoded keys and values of the query.
+        // Pairs that do not fit are dropped. Allocated by the first
+        // normalize_url(), so that a Client stays small.
+        static const size_t SCRATCH_SIZE = 2 * MAX_PATH_LENGTH;
+
+        // The pairs of the query string or of the Cookie header, split the
+        // first time a dynamic page asks for one. pairs points to
+        // inlinePairs until more than INLINE_PAIRS are split.
+        struct Pairs
+        {
+            Pair *pairs = inlinePairs;
+            unsigned numberOfPairs = 0;
+            bool split = false;
+            Pair inlinePairs[INLINE_PAIRS];
+        };
+
         Method method;
         Value url;
-        Value host;
-        Value userAgent;
-        Value accept;
-        Value acceptLanguage;
-        Value acceptEncoding;
-        Value connection;
-        Value upgradeInsecureRequests;
+        // Set by normalize_url(). The path is decoded into scratch, the
+        // query and fragment are slices of url without their '?' and '#'.
+        Value path;
+        Value query;
+        Value fragment;
+        // The whole body, for dynamic pages without a body handler. Unset
+        // when the request has none.
+        Value body;
+        // The whole body in an unnamed file with its offset at 0, when it
+        // was long enough to be spooled (see ServerInfo) or did not fit in
+        // the read buffer. Unset body and -1 otherwise. The worker closes it once the page returns, so a page
+        // that keeps the upload links it into place with linkat() through
+        // /proc/self/fd.
+        int bodyFd;
+        // Left to a page with a body handler, see DynamicPageBody
+        void *pageData;
+        // One more than the index in fieldValues of the value of each
+        // Field, 0 when the request has no such header. Only fieldSlots
+        // is cleared between requests.
+        uint8_t fieldSlots[NUMBER_OF_FIELDS];
+        Value fieldValues[MAX_FIELD_VALUES];
+        unsigned numberOfFieldValues;
+        Header unknownHeaders[MAX_UNKNOWN_HEADERS];
+        unsigned numberOfUnknownHeaders;
+        // Only set while a dynamic page is called
+        Param params[MAX_PARAMS];
+        unsigned numberOfParams;
+        // Only split for the dynamic pages that ask, through the const
+        // getters they have. Only split is cleared between requests.
+        mutable Pairs queryPairs;
+        mutable Pairs cookies;
+        mutable char *scratch;
+        mutable size_t scratchLength;
+
+        HttpRequest();
+        // The pairs point into the request, so it is never copied
+        HttpRequest(const HttpRequest&) = delete;
+        HttpRequest& operator=(const HttpRequest&) = delete;
+        ~HttpRequest();
+
+        // A new value for the header, nullptr when there is no room left
+        Value* add_field(Field field);
+        Header* add_unknown_header();
+        // Forgets the URL, headers, params and body, for the next request
+        void clear();
+        // The Field of a header name, ignoring case. Unknown when the name
+        // has none.
+        static Field find_field(const char *name, size_t length);
+        // The value of a cookie, without the quotes around it, nullptr when
+        // the Cookie header has none of that name
+        const Value* get_cookie(const char *name) const;
+        // Every cookie, in the order of the Cookie header
+        const Pairs& get_cookies() const;
+        // An unset Value when the request has no such header
+        const Value& get_field(Field field) const;
+        // Any header by name, ignoring case, nullptr when the request has
+        // none of that name
+        const Value* get_header(const char *name) const;
+        // The value a parameter of the route captured, nullptr when the
+        // route has no parameter of that name
+        const Value* get_param(const char *name) const;
+        // Every key of the query string and its value, decoded, in order.
+        // A key without '=' has an empty value.
+        const Pairs& get_query_pairs() const;
+        // The decoded value of the first such key of the query string,
+        // nullptr when the query has none
+        const Value* get_query_value(const char *name) const;
+        // Splits url into path, query and fragment in one pass over it,
+        // decoding %XX escapes, collapsing repeated slashes and resolving
+        // "." and ".." segments of the path, escaped ones included. False
+        // when the path climbs above the root, has a malformed escape or an
+        // escaped '/' or NUL, or is longer than MAX_PATH_LENGTH.
+        bool normalize_url();
     };
 }
 
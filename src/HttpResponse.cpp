@@ -1,5 +1,8 @@
 #include "HttpResponse.h"
 
+const char *awsim::HttpResponse::BYTERANGES_BOUNDARY =
+    "awsim-3f9d2c7a81e6b054";
+
 template<class T>
 bool awsim::HttpResponse::Header<T>::is_set() const
 {
@@ -7,13 +10,13 @@ bool awsim::HttpResponse::Header<T>::is_set() const
 }
 
 template<class T>
-T awsim::HttpResponse::Header<T>::get() const
+const T& awsim::HttpResponse::Header<T>::get() const
 {
     return value;
 }
 
 template<class T>
-void awsim::HttpResponse::Header<T>::set(T value)
+void awsim::HttpResponse::Header<T>::set(const T &value)
 {
     isSet = true;
     this->value = value;
@@ -28,6 +31,93 @@ awsim::HttpResponse::HttpResponse(uint8_t httpMajorVersion,
 
 }
 
+awsim::HttpResponse::MimeType awsim::HttpResponse::get_mime_type(
+    const std::string &path, MimeType unknown)
+{
+    static const struct
+    {
+        const char *extension;
+        MimeType mimeType;
+    } extensions[] = {
+        {"css", MimeType::Text_CSS},
+        {"gif", MimeType::Image_GIF},
+        {"htm", MimeType::Text_HTML},
+        {"html", MimeType::Text_HTML},
+        {"jpeg", MimeType::Image_JPEG},
+        {"jpg", MimeType::Image_JPEG},
+        {"js", MimeType::Application_Javascript},
+        {"json", MimeType::Application_JSON},
+        {"png", MimeType::Image_PNG},
+        {"svg", MimeType::Image_SVG_Plus_XML},
+        {"txt", MimeType::Text_Plain}
+    };
+    size_t dot = path.find_last_of("./");
+
+    if (dot == std::string::npos || path[dot] != '.')
+    {
+        return unknown;
+    }
+    for (const auto &entry : extensions)
+    {
+        if (strcasecmp(path.c_str() + dot + 1, entry.extension) == 0)
+        {
+            return entry.mimeType;
+        }
+    }
+    return unknown;
+}
+
+const char* awsim::HttpResponse::get_status(StatusCode statusCode)
+{
+    switch (statusCode)
+    {
+        case StatusCode::OK_200:
+            return "200 OK";
+        case StatusCode::PartialContent_206:
+            return "206 Partial Content";
+        case StatusCode::NotModified_304:
+            return "304 Not Modified";
+        case StatusCode::BadRequest_400:
+            return "400 Bad Request";
+        case StatusCode::Forbidden_403:
+            return "403 Forbidden";
+        case StatusCode::NotFound_404:
+            return "404 Not Found";
+        case StatusCode::MethodNotAllowed_405:
+            return "405 Method Not Allowed";
+        case StatusCode::PayloadTooLarge_413:
+            return "413 Payload Too Large";
+        case StatusCode::RangeNotSatisfiable_416:
+            return "416 Range Not Satisfiable";
+        case StatusCode::RequestHeaderFieldsTooLarge_431:
+            return "431 Request Header Fields Too Large";
+        case StatusCode::InternalServerError_500:
+            return "500 Internal Server Error";
+        case StatusCode::ServiceUnavailable_503:
+            return "503 Service Unavailable";
+    }
+    return "500 Internal Server Error";
+}
+
+bool awsim::HttpResponse::is_compressible() const
+{
+    if (!contentType.is_set())
+    {
+        // Dynamic pages are text unless they say otherwise
+        return true;
+    }
+    switch (contentType.get())
+    {
+        case MimeType::Application_Octet_Stream:
+        case MimeType::Image_GIF:
+        case MimeType::Image_JPEG:
+        case MimeType::Image_PNG:
+            return false;
+        default:
+            return true;
+    }
+}
+
 #define COPY_STR_AND_MOVE_OFFSET(str) \
     memcpy(buf + offset, str, sizeof(str) - 1); \
     offset += sizeof(str) - 1;
@@ -37,15 +127,110 @@ awsim::HttpResponse::HttpResponse(uint8_t httpMajorVersion,
     buf[offset + 1] = '\n'; \
     offset += 2;
 
-void awsim::HttpResponse::send_to(int sock) const
+void awsim::HttpResponse::send_to(Client *client) const
+{
+    char buf[4096];
+
+    client->queue(buf, write_to(buf));
+}
+
+void awsim::HttpResponse::send_to(Client *client, const void *body,
+    size_t length) const
+{
+    HttpResponse response = *this;
+    Compressor::Format format;
+
+    // Pages answer HEAD as they would GET. The body is left out, as
+    // anything after the headers would be taken for the next response on
+    // the connection, and so is the work of compressing it.
+    if (client->request.method == HttpRequest::Method::HEAD)
+    {
+        response.set_content_length(length);
+        response.send_to(client);
+        return;
+    }
+    if (client->compressor != nullptr && !contentEncoding.is_set()
+        && length >= Compressor::MINIMUM_SIZE && is_compressible())
+    {
+        // Shared caches must not hand either version to every client
+        response.set_vary(Vary::AcceptEncoding);
+        if (Compressor::choose_format(AcceptEncoding(
+            client->request.get_field(HttpRequest::Field::AcceptEncoding)),
+            format)
+            && client->compressor->compress(format, body, length))
+        {
+            response.set_content_encoding(format == Compressor::Format::Gzip
+                ? ContentEncoding::Gzip : ContentEncoding::Deflate);
+            body = client->compressor->get_output();
+            length = client->compressor->get_output_length();
+        }
+    }
+    response.set_content_length(length);
+    response.send_to(client);
+    client->queue(body, length);
+}
+
+std::string awsim::HttpResponse::to_string() const
 {
     char buf[4096];
+
+    return std::string(buf, write_to(buf));
+}
+
+size_t awsim::HttpResponse::write_to(char *buf) const
+{
+    const char *status = get_status(statusCode);
     int offset = 0;
 
     memcpy(buf, "HTTP/", sizeof("HTTP/") - 1);
     buf[sizeof("HTTP/") - 1] = httpMajorVersion + '0';
+    buf[sizeof("HTTP/0") - 1] = '.';
     buf[sizeof("HTTP/0.") - 1] = httpMinorVersion + '0';
-    offset = sizeof("HTTP/0.0\n") - 1;
+    offset = sizeof("HTTP/0.0") - 1;
+    buf[offset++] = ' ';
+    memcpy(buf + offset, status, strlen(status));
+    offset += strlen(status);
+    ADD_NEW_LINE()
+
+    if (acceptRanges.is_set())
+    {
+        COPY_STR_AND_MOVE_OFFSET("Accept-Ranges: ")
+        switch (acceptRanges.get())
+        {
+            case AcceptRanges::Bytes:
+                COPY_STR_AND_MOVE_OFFSET("bytes")
+                break;
+        }
+        ADD_NEW_LINE()
+    }
+
+    if (allow.is_set())
+    {
+        COPY_STR_AND_MOVE_OFFSET("Allow: ")
+        switch (allow.get())
+        {
+            case Allow::Get_Head:
+                COPY_STR_AND_MOVE_OFFSET("GET, HEAD")
+                break;
+        }
+        ADD_NEW_LINE()
+    }
+
+    if (connection.is_set())
+    {
+        COPY_STR_AND_MOVE_OFFSET("Connection: ")
+        switch (connection.get())
+        {
+            case Connection::Close:
+                COPY_STR_AND_MOVE_OFFSET("close")
+                break;
+            case Connection::KeepAlive:
+                COPY_STR_AND_MOVE_OFFSET("keep-alive")
+                break;
+        }
+        ADD_NEW_LINE()
+    }
+
     if (contentEncoding.is_set())
     {
         COPY_STR_AND_MOVE_OFFSET("Content-Encoding: ")
@@ -58,6 +243,12 @@ void awsim::HttpResponse::send_to(int sock) const
             case ContentEncoding::Deflate:
                 COPY_STR_AND_MOVE_OFFSET("deflate")
                 break;
+            case ContentEncoding::Brotli:
+                COPY_STR_AND_MOVE_OFFSET("br")
+                break;
+            case ContentEncoding::Zstd:
+                COPY_STR_AND_MOVE_OFFSET("zstd")
+                break;
         }
         ADD_NEW_LINE()
     }
@@ -69,6 +260,23 @@ void awsim::HttpResponse::send_to(int sock) const
         ADD_NEW_LINE()
     }
 
+    if (contentRange.is_set())
+    {
+        const ContentRange &contentRange = this->contentRange.get();
+
+        COPY_STR_AND_MOVE_OFFSET("Content-Range: bytes ")
+        if (contentRange.satisfiable)
+        {
+            offset += sprintf(buf + offset, "%" PRIu64 "-%" PRIu64 "/%" PRIu64,
+                contentRange.first, contentRange.last, contentRange.size);
+        }
+        else
+        {
+            offset += sprintf(buf + offset, "*/%" PRIu64, contentRange.size);
+        }
+        ADD_NEW_LINE()
+    }
+
     if (contentType.is_set())
     {
         COPY_STR_AND_MOVE_OFFSET("Content-Type: ")
@@ -96,6 +304,12 @@ void awsim::HttpResponse::send_to(int sock) const
             case MimeType::Image_SVG_Plus_XML:
                 COPY_STR_AND_MOVE_OFFSET("image/svg+xml")
                 break;
+            case MimeType::Multipart_Byteranges:
+                COPY_STR_AND_MOVE_OFFSET("multipart/byteranges; boundary=")
+                memcpy(buf + offset, BYTERANGES_BOUNDARY,
+                    strlen(BYTERANGES_BOUNDARY));
+                offset += strlen(BYTERANGES_BOUNDARY);
+                break;
             case MimeType::Text_CSS:
                 COPY_STR_AND_MOVE_OFFSET("text/css")
                 break;
@@ -109,12 +323,55 @@ void awsim::HttpResponse::send_to(int sock) const
         ADD_NEW_LINE()
     }
 
-    ADD_NEW_LINE()
-    if (send(sock, buf, offset, 0) == -1)
+    if (etag.is_set())
     {
-        throw std::runtime_error("send(" + std::to_string(sock) + ", buf, "
-            + std::to_string(offset) + ", 0) failed -> " + strerror(errno));
+        COPY_STR_AND_MOVE_OFFSET("ETag: ")
+        memcpy(buf + offset, etag.get().data(), etag.get().size());
+        offset += etag.get().size();
+        ADD_NEW_LINE()
     }
+
+    if (lastModified.is_set())
+    {
+        time_t time = lastModified.get();
+        tm date;
+
+        COPY_STR_AND_MOVE_OFFSET("Last-Modified: ")
+        gmtime_r(&time, &date);
+        offset += strftime(buf + offset, 64, "%a, %d %b %Y %H:%M:%S GMT",
+            &date);
+        ADD_NEW_LINE()
+    }
+
+    if (vary.is_set())
+    {
+        COPY_STR_AND_MOVE_OFFSET("Vary: ")
+        switch (vary.get())
+        {
+            case Vary::AcceptEncoding:
+                COPY_STR_AND_MOVE_OFFSET("Accept-Encoding")
+                break;
+        }
+        ADD_NEW_LINE()
+    }
+
+    ADD_NEW_LINE()
+    return offset;
+}
+
+void awsim::HttpResponse::set_accept_ranges(AcceptRanges acceptRanges)
+{
+    this->acceptRanges.set(acceptRanges);
+}
+
+void awsim::HttpResponse::set_allow(Allow allow)
+{
+    this->allow.set(allow);
+}
+
+void awsim::HttpResponse::set_connection(Connection connection)
+{
+    this->connection.set(connection);
 }
 
 void awsim::HttpResponse::set_content_encoding(ContentEncoding contentEncoding)
@@ -127,7 +384,33 @@ void awsim::HttpResponse::set_content_length(uint64_t contentLength)
     this->contentLength.set(contentLength);
 }
 
+void awsim::HttpResponse::set_content_range(uint64_t first, uint64_t last,
+    uint64_t size)
+{
+    contentRange.set(ContentRange{first, last, size, true});
+}
+
+void awsim::HttpResponse::set_content_range(uint64_t size)
+{
+    contentRange.set(ContentRange{0, 0, size, false});
+}
+
 void awsim::HttpResponse::set_content_type(MimeType contentType)
 {
     this->contentType.set(contentType);
 }
+
+void awsim::HttpResponse::set_etag(const std::string &etag)
+{
+    this->etag.set(etag);
+}
+
+void awsim::HttpResponse::set_last_modified(time_t lastModified)
+{
+    this->lastModified.set(lastModified);
+}
+
+void awsim::HttpResponse::set_vary(Vary vary)
+{
+    this->vary.set(vary);
+}
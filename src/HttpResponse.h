@@ -7,22 +7,63 @@
 #include <stdio.h>
 #include <string>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
+#include <time.h>
+
+#include "AcceptEncoding.h"
+#include "Client.h"
+#include "Compressor.h"
 
 namespace awsim
 {
     class HttpResponse
     {
     public:
+        // Separates the parts of a multipart/byteranges body
+        static const char *BYTERANGES_BOUNDARY;
+
+        // In numerical order, the errors start at BadRequest_400
         enum class StatusCode
         {
-            OK_200
+            OK_200,
+            PartialContent_206,
+            NotModified_304,
+            BadRequest_400,
+            Forbidden_403,
+            NotFound_404,
+            MethodNotAllowed_405,
+            PayloadTooLarge_413,
+            RangeNotSatisfiable_416,
+            RequestHeaderFieldsTooLarge_431,
+            InternalServerError_500,
+            ServiceUnavailable_503
+        };
+
+        static const uint8_t NUMBER_OF_STATUS_CODES = 12;
+
+        enum class AcceptRanges
+        {
+            Bytes
+        };
+
+        enum class Allow
+        {
+            Get_Head
+        };
+
+        enum class Connection
+        {
+            Close,
+            KeepAlive
         };
 
         enum class ContentEncoding
         {
             Gzip,
-            Deflate
+            Deflate,
+            Brotli,
+            Zstd
         };
 
         enum class MimeType
@@ -34,38 +75,92 @@ namespace awsim
             Image_JPEG,
             Image_PNG,
             Image_SVG_Plus_XML,
+            Multipart_Byteranges,
             Text_CSS,
             Text_HTML,
             Text_Plain,
         };
 
+        enum class Vary
+        {
+            AcceptEncoding
+        };
+
         HttpResponse(uint8_t httpMajorVersion, uint8_t httpMinorVersion,
             StatusCode statusCode);
 
-        void send_to(int sock) const;
+        // The type of a file by the extension of its path, ignoring case.
+        // unknown when the extension is none of the types above.
+        static MimeType get_mime_type(const std::string &path,
+            MimeType unknown);
+        // The code and reason phrase of the status line, "404 Not Found"
+        static const char* get_status(StatusCode statusCode);
+        // Queues the status line and headers on the client, they are written
+        // out by the worker once the handler returns
+        void send_to(Client *client) const;
+        // Queues the response with body, setting Content-Length. Unless
+        // Content-Encoding has been set, a body of a compressible type is
+        // compressed when the client accepts gzip or deflate. A request
+        // for HEAD gets the headers only, with the length of the body.
+        void send_to(Client *client, const void *body, size_t length) const;
+        void set_accept_ranges(AcceptRanges acceptRanges);
+        void set_allow(Allow allow);
+        void set_connection(Connection connection);
         void set_content_encoding(ContentEncoding contentEncoding);
         void set_content_length(uint64_t contentLength);
+        // Content-Range of a 206 response, the range is inclusive
+        void set_content_range(uint64_t first, uint64_t last, uint64_t size);
+        // Content-Range of a 416 response
+        void set_content_range(uint64_t size);
         void set_content_type(MimeType contentType);
+        // etag is sent as it is, quotes and weakness prefix included
+        void set_etag(const std::string &etag);
+        void set_last_modified(time_t lastModified);
+        void set_vary(Vary vary);
+        // The status line and headers as send_to() queues them
+        std::string to_string() const;
     private:
+        struct ContentRange
+        {
+            uint64_t first;
+            uint64_t last;
+            uint64_t size;
+            bool satisfiable;
+        };
+
         template<class T>
         class Header
         {
         public:
             bool is_set() const;
-            T get() const;
-            void set(T value);
+            const T& get() const;
+            void set(const T &value);
 
         private:
             T value;
             bool isSet = false;
         };
 
+        Header<AcceptRanges> acceptRanges;
+        Header<Allow> allow;
+        Header<Connection> connection;
         Header<ContentEncoding> contentEncoding;
         Header<uint64_t> contentLength;
+        Header<ContentRange> contentRange;
         Header<MimeType> contentType;
+        Header<std::string> etag;
+        Header<time_t> lastModified;
+        Header<Vary> vary;
         uint8_t httpMajorVersion;
         uint8_t httpMinorVersion;
         StatusCode statusCode;
+
+        // Whether bodies of the content type are worth compressing, which
+        // they are unless the type is compressed already
+        bool is_compressible() const;
+        // Writes the status line and headers to buf, which has room for 4096
+        // bytes, and returns their length
+        size_t write_to(char *buf) const;
     };
 }
 
@@ -0,0 +1,329 @@
+#include "IoUring.h"
+
+#define LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+awsim::IoUring::IoUring() :
+    fd(-1),
+    ringMemory(MAP_FAILED),
+    ringMemorySize(0),
+    sqes((io_uring_sqe*)MAP_FAILED),
+    sqesSize(0),
+    bufferRing((io_uring_buf_ring*)MAP_FAILED),
+    bufferRingSize(0),
+    buffers(nullptr),
+    bufferCount(0),
+    bufferSize(0),
+    bufferTail(0)
+{
+}
+
+awsim::IoUring::~IoUring()
+{
+    deinit();
+}
+
+void awsim::IoUring::advance()
+{
+    STORE_RELEASE(cqHead, *cqHead + 1);
+}
+
+void awsim::IoUring::deinit()
+{
+    // Closing the ring drops the registered files and buffers with it
+    if (fd != -1)
+    {
+        close(fd);
+        fd = -1;
+    }
+    if (bufferRing != MAP_FAILED)
+    {
+        munmap(bufferRing, bufferRingSize);
+        bufferRing = (io_uring_buf_ring*)MAP_FAILED;
+    }
+    free(buffers);
+    buffers = nullptr;
+    if (sqes != MAP_FAILED)
+    {
+        munmap(sqes, sqesSize);
+        sqes = (io_uring_sqe*)MAP_FAILED;
+    }
+    if (ringMemory != MAP_FAILED)
+    {
+        munmap(ringMemory, ringMemorySize);
+        ringMemory = MAP_FAILED;
+    }
+}
+
+int awsim::IoUring::enter(unsigned toSubmit, unsigned minComplete,
+    unsigned flags, const void *arg, size_t argSize)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags,
+        arg, argSize);
+}
+
+char* awsim::IoUring::get_buffer(uint16_t bufferID) const
+{
+    return buffers + (size_t)bufferID * bufferSize;
+}
+
+unsigned awsim::IoUring::get_buffer_size() const
+{
+    return bufferSize;
+}
+
+io_uring_sqe* awsim::IoUring::get_sqe()
+{
+    io_uring_sqe *sqe;
+
+    if (sqLocalTail - LOAD_ACQUIRE(sqHead) >= sqEntries)
+    {
+        submit();
+        if (sqLocalTail - LOAD_ACQUIRE(sqHead) >= sqEntries)
+        {
+            throw std::runtime_error("The submission ring is full");
+        }
+    }
+    sqe = &sqes[sqLocalTail & sqMask];
+    sqLocalTail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void awsim::IoUring::init(unsigned entries, unsigned completionEntries,
+    unsigned fixedFiles, unsigned bufferCount, unsigned bufferSize)
+{
+    io_uring_params params;
+    io_uring_rsrc_register files;
+    io_uring_buf_reg bufferRegistration;
+    unsigned *array;
+    uint8_t *ring;
+
+    if (bufferCount == 0 || (bufferCount & (bufferCount - 1)) != 0
+        || bufferCount > 32768)
+    {
+        throw std::runtime_error("The number of provided buffers must be a "
+            "power of 2 no larger than 32768, got "
+            + std::to_string(bufferCount));
+    }
+
+    // Only the worker thread ever touches its ring, which lets the kernel
+    // defer completion work until the worker asks for completions. Older
+    // kernels do not know these flags.
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL
+        | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    params.cq_entries = completionEntries;
+    fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd == -1 && errno == EINVAL)
+    {
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+        params.cq_entries = completionEntries;
+        fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    }
+    if (fd == -1)
+    {
+        throw std::runtime_error("io_uring_setup(" + std::to_string(entries)
+            + ", &params) failed -> " + strerror(errno));
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)
+        || !(params.features & IORING_FEAT_NODROP)
+        || !(params.features & IORING_FEAT_EXT_ARG))
+    {
+        deinit();
+        throw std::runtime_error("io_uring lacks required features, has "
+            + std::to_string(params.features));
+    }
+
+    ringMemorySize = std::max(
+        params.sq_off.array + params.sq_entries * sizeof(unsigned),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    ringMemory = mmap(nullptr, ringMemorySize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ringMemory == MAP_FAILED)
+    {
+        int error = errno;
+
+        deinit();
+        throw std::runtime_error("mmap(nullptr, "
+            + std::to_string(ringMemorySize) + ", PROT_READ | PROT_WRITE, "
+            "MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING) failed -> "
+            + strerror(error));
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = (io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        int error = errno;
+
+        deinit();
+        throw std::runtime_error("mmap(nullptr, " + std::to_string(sqesSize)
+            + ", PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, "
+            "IORING_OFF_SQES) failed -> " + strerror(error));
+    }
+
+    ring = (uint8_t*)ringMemory;
+    sqHead = (unsigned*)(ring + params.sq_off.head);
+    sqTail = (unsigned*)(ring + params.sq_off.tail);
+    sqMask = *(unsigned*)(ring + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    sqLocalTail = *sqTail;
+    // Entries are always handed over in ring order
+    array = (unsigned*)(ring + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries; ++i)
+    {
+        array[i] = i;
+    }
+    cqHead = (unsigned*)(ring + params.cq_off.head);
+    cqTail = (unsigned*)(ring + params.cq_off.tail);
+    cqMask = *(unsigned*)(ring + params.cq_off.ring_mask);
+    cqes = (io_uring_cqe*)(ring + params.cq_off.cqes);
+
+    memset(&files, 0, sizeof(files));
+    files.nr = fixedFiles;
+    files.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_FILES2, &files,
+        sizeof(files)) == -1)
+    {
+        int error = errno;
+
+        deinit();
+        throw std::runtime_error("io_uring_register(ring, "
+            "IORING_REGISTER_FILES2, &files, " + std::to_string(sizeof(files))
+            + ") failed -> " + strerror(error));
+    }
+
+    this->bufferCount = bufferCount;
+    this->bufferSize = bufferSize;
+    bufferRingSize = bufferCount * sizeof(io_uring_buf);
+    bufferRing = (io_uring_buf_ring*)mmap(nullptr, bufferRingSize,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufferRing == MAP_FAILED)
+    {
+        int error = errno;
+
+        deinit();
+        throw std::runtime_error("mmap(nullptr, "
+            + std::to_string(bufferRingSize) + ", PROT_READ | PROT_WRITE, "
+            "MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) failed -> "
+            + strerror(error));
+    }
+    buffers = (char*)malloc((size_t)bufferCount * bufferSize);
+    if (buffers == nullptr)
+    {
+        int error = errno;
+
+        deinit();
+        throw std::runtime_error("malloc("
+            + std::to_string((size_t)bufferCount * bufferSize)
+            + ") failed -> " + strerror(error));
+    }
+    memset(&bufferRegistration, 0, sizeof(bufferRegistration));
+    bufferRegistration.ring_addr = (uint64_t)(uintptr_t)bufferRing;
+    bufferRegistration.ring_entries = bufferCount;
+    bufferRegistration.bgid = BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PBUF_RING,
+        &bufferRegistration, 1) == -1)
+    {
+        int error = errno;
+
+        deinit();
+        throw std::runtime_error("io_uring_register(ring, "
+            "IORING_REGISTER_PBUF_RING, &bufferRegistration, 1) failed -> "
+            + std::string(strerror(error)));
+    }
+    bufferTail = 0;
+    for (unsigned i = 0; i < bufferCount; ++i)
+    {
+        recycle_buffer((uint16_t)i);
+    }
+    publish();
+}
+
+bool awsim::IoUring::is_initialized() const
+{
+    return fd != -1;
+}
+
+io_uring_cqe* awsim::IoUring::peek()
+{
+    unsigned head = *cqHead;
+
+    if (head == LOAD_ACQUIRE(cqTail))
+    {
+        return nullptr;
+    }
+    return &cqes[head & cqMask];
+}
+
+void awsim::IoUring::publish()
+{
+    STORE_RELEASE(sqTail, sqLocalTail);
+    STORE_RELEASE(&bufferRing->tail, bufferTail);
+}
+
+void awsim::IoUring::recycle_buffer(uint16_t bufferID)
+{
+    // Not bufferRing->bufs, in C++ the empty struct in front of that flexible
+    // array takes up space and moves it off the start of the ring
+    io_uring_buf *buffer =
+        &((io_uring_buf*)bufferRing)[bufferTail & (bufferCount - 1)];
+
+    buffer->addr = (uint64_t)(uintptr_t)get_buffer(bufferID);
+    buffer->len = bufferSize;
+    buffer->bid = bufferID;
+    bufferTail++;
+}
+
+void awsim::IoUring::submit()
+{
+    unsigned toSubmit;
+
+    publish();
+    toSubmit = sqLocalTail - LOAD_ACQUIRE(sqHead);
+    while (toSubmit > 0 && enter(toSubmit, 0, 0, nullptr, 0) == -1)
+    {
+        // EBUSY means the completions have to be reaped first, whatever was
+        // not taken stays in the ring for the next call
+        if (errno == EBUSY || errno == EAGAIN)
+        {
+            return;
+        }
+        if (errno != EINTR)
+        {
+            throw std::runtime_error("io_uring_enter(ring, "
+                + std::to_string(toSubmit) + ", 0, 0, nullptr, 0) failed -> "
+                + strerror(errno));
+        }
+    }
+}
+
+void awsim::IoUring::submit_and_wait(int timeoutMilliseconds)
+{
+    io_uring_getevents_arg arg;
+    __kernel_timespec timeout;
+    unsigned toSubmit;
+    unsigned flags = IORING_ENTER_GETEVENTS;
+
+    publish();
+    toSubmit = sqLocalTail - LOAD_ACQUIRE(sqHead);
+    memset(&arg, 0, sizeof(arg));
+    if (timeoutMilliseconds >= 0)
+    {
+        timeout.tv_sec = timeoutMilliseconds / 1000;
+        timeout.tv_nsec = (long long)(timeoutMilliseconds % 1000) * 1000000;
+        arg.ts = (uint64_t)(uintptr_t)&timeout;
+    }
+    flags |= IORING_ENTER_EXT_ARG;
+    if (enter(toSubmit, 1, flags, &arg, sizeof(arg)) == -1
+        && errno != ETIME && errno != EINTR && errno != EBUSY
+        && errno != EAGAIN)
+    {
+        throw std::runtime_error("io_uring_enter(ring, "
+            + std::to_string(toSubmit) + ", 1, IORING_ENTER_GETEVENTS | "
+            "IORING_ENTER_EXT_ARG, &arg, " + std::to_string(sizeof(arg))
+            + ") failed -> " + strerror(errno));
+    }
+}
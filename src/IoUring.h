@@ -0,0 +1,88 @@
+#ifndef AWSIM_IOURING_H
+#define AWSIM_IOURING_H
+
+#include <algorithm>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace awsim
+{
+    // Thin wrapper around the io_uring syscalls, there is no liburing to lean
+    // on. Besides the two rings it owns a sparse table of direct descriptors
+    // and a single ring of provided receive buffers (group 0).
+    //
+    // Submissions are only made visible to the kernel by submit() and
+    // submit_and_wait(), so a whole batch of completions can be handled
+    // before anything is entered.
+    class IoUring
+    {
+    public:
+        static const uint16_t BUFFER_GROUP = 0;
+
+        IoUring();
+        ~IoUring();
+
+        void deinit();
+        void init(unsigned entries, unsigned completionEntries,
+            unsigned fixedFiles, unsigned bufferCount, unsigned bufferSize);
+        bool is_initialized() const;
+
+        // The returned entry is zeroed. When the submission ring is full the
+        // pending entries are submitted first to make room.
+        io_uring_sqe* get_sqe();
+        void submit();
+        // Submits and waits for at least one completion, or until
+        // timeoutMilliseconds (-1 waits forever)
+        void submit_and_wait(int timeoutMilliseconds);
+
+        // Returns nullptr once the completion ring is empty. The entry stays
+        // valid until advance() is called.
+        io_uring_cqe* peek();
+        void advance();
+
+        char* get_buffer(uint16_t bufferID) const;
+        unsigned get_buffer_size() const;
+        // Recycled buffers are handed back to the kernel by submit()
+        void recycle_buffer(uint16_t bufferID);
+
+    private:
+        int fd;
+
+        void *ringMemory;
+        size_t ringMemorySize;
+        io_uring_sqe *sqes;
+        size_t sqesSize;
+
+        unsigned *sqHead;
+        unsigned *sqTail;
+        unsigned sqMask;
+        unsigned sqEntries;
+        unsigned sqLocalTail;
+
+        unsigned *cqHead;
+        unsigned *cqTail;
+        unsigned cqMask;
+        io_uring_cqe *cqes;
+
+        io_uring_buf_ring *bufferRing;
+        size_t bufferRingSize;
+        char *buffers;
+        unsigned bufferCount;
+        unsigned bufferSize;
+        uint16_t bufferTail;
+
+        int enter(unsigned toSubmit, unsigned minComplete, unsigned flags,
+            const void *arg, size_t argSize);
+        void publish();
+    };
+}
+
+#endif
@@ -1,48 +1,69 @@
 #include "ParserDetails.h"
 
-awsim::ParserDetails::ParserDetails(
-   const std::unordered_map<std::string, Domain> &domains,
-   std::unordered_map<std::string, Domain>::iterator localhostDomain) :
-   domains(domains),
-   localhostDomain(localhostDomain)
+awsim::ParserDetails::ParserDetails(const Routing &routing,
+   FileCache &fileCache, uint64_t maxBodySize,
+   uint64_t minimumSizeOfSpooledBodies) :
+   routing(routing),
+   hosts(routing.get_hosts()),
+   fileCache(fileCache),
+   maxBodySize(maxBodySize),
+   minimumSizeOfSpooledBodies(minimumSizeOfSpooledBodies)
 {
 
 }
 
-void awsim::ParserDetails::get_resource(const HttpRequest::Value &url,
-   const HttpRequest::Value &host)
+uint64_t awsim::ParserDetails::get_max_body_size() const
 {
-   std::string hostString = std::string(host.buffer, host.length);
-   const auto &it = domains.find(hostString);
-   if (it == domains.end())
+   return maxBodySize;
+}
+
+uint64_t awsim::ParserDetails::get_minimum_size_of_spooled_bodies() const
+{
+   return minimumSizeOfSpooledBodies;
+}
+
+void awsim::ParserDetails::get_resource(const HttpRequest::Value &path,
+   const HttpRequest::Value &host, HttpRequest::Method method)
+{
+   resourceNotFound = false;
+   resourceForbidden = false;
+   if (!host.set)
    {
-      if (hostString == "localhost")
-      {
-         domain = &(localhostDomain->second);
-      }
-      else
-      {
-         throw DomainNotFound();
-      }
+      domain = hosts.get_localhost();
    }
    else
    {
-      domain = &(it->second);
+      domain = hosts.find(std::string_view(host.buffer, host.length));
+      if (domain == nullptr)
+      {
+         throw DomainNotFound();
+      }
    }
 
+   get_resource(path, method);
+}
+
+void awsim::ParserDetails::get_resource(const HttpRequest::Value &path,
+   HttpRequest::Method method)
+{
    try
    {
-      domain->get_resource(std::string(url.buffer, url.length), resource);
+      domain->get_resource(std::string(path.buffer, path.length), method,
+         resource, fileCache);
    }
    catch (const Resource::FileForbiddenException &ex)
    {
-      resourceNotFound = true;
+      resourceForbidden = true;
    }
    catch (const Resource::FileNotFoundException &ex)
    {
-      resourceForbidden = true;
+      resourceNotFound = true;
    }
+}
 
+const awsim::Routing* awsim::ParserDetails::get_routing() const
+{
+   return &routing;
 }
 
 void awsim::ParserDetails::respond(HttpRequest *request, Client *client)
@@ -55,4 +76,24 @@ void awsim::ParserDetails::respond(HttpRequest *request, Client *client)
    {
       domain->send_403(request, client);
    }
+   else if (resource.is_static()
+      && request->method != HttpRequest::Method::GET
+      && request->method != HttpRequest::Method::HEAD)
+   {
+      domain->send_405(client);
+   }
+   else
+   {
+      resource.respond(request, client);
+   }
+}
+
+bool awsim::ParserDetails::takes_body(DynamicPageBody &bodyHandler)
+{
+   if (resourceNotFound || resourceForbidden || resource.is_static())
+   {
+      return false;
+   }
+   bodyHandler = resource.get_dynamic_page_body();
+   return true;
 }
@@ -1,12 +1,15 @@
 #ifndef AWSIM_PARSERDETAILS_H
 #define AWSIM_PARSERDETAILS_H
 
-#include <unordered_map>
+#include <string_view>
 
 #include "Domain.h"
 #include "DynamicPage.h"
+#include "FileCache.h"
+#include "HostTable.h"
 #include "HttpRequest.h"
 #include "Resource.h"
+#include "Routing.h"
 
 namespace awsim
 {
@@ -14,22 +17,33 @@ namespace awsim
     public:
         class DomainNotFound : public std::exception {};
 
-        HttpRequest::Field currentHeaderField = HttpRequest::Field::Unknown;
+        ParserDetails(const Routing &routing, FileCache &fileCache,
+            uint64_t maxBodySize, uint64_t minimumSizeOfSpooledBodies);
 
-        ParserDetails(const std::unordered_map<std::string, Domain> &domains,
-            std::unordered_map<std::string, Domain>::iterator localhostDomain);
-
-        void get_resource(const HttpRequest::Value &url,
-            const HttpRequest::Value &host);
+        uint64_t get_max_body_size() const;
+        uint64_t get_minimum_size_of_spooled_bodies() const;
+        void get_resource(const HttpRequest::Value &path,
+            const HttpRequest::Value &host, HttpRequest::Method method);
+        const Routing* get_routing() const;
         void respond(HttpRequest *request, Client *client);
+        // Whether the resource get_resource() found takes the body of the
+        // request, which only dynamic pages do. bodyHandler is set to the
+        // body handler of the page, nullptr when it has none.
+        bool takes_body(DynamicPageBody &bodyHandler);
 
     private:
         bool resourceNotFound = false;
         bool resourceForbidden = false;
         Resource resource;
-        const std::unordered_map<std::string, Domain> domains;
-        const std::unordered_map<std::string, Domain>::iterator localhostDomain;
+        const Routing &routing;
+        const HostTable &hosts;
         const Domain *domain;
+        FileCache &fileCache;
+        uint64_t maxBodySize;
+        uint64_t minimumSizeOfSpooledBodies;
+
+        void get_resource(const HttpRequest::Value &path,
+            HttpRequest::Method method);
     };
 }
 
@@ -1,53 +1,263 @@
 #include "Resource.h"
 
-void awsim::Resource::get_static_file(const std::string &url,
-    int rootDirectoryFd)
+static awsim::FileCache::Encoding choose_encoding(
+    const awsim::AcceptEncoding &accepted, uint8_t variants);
+static int duplicate_fd(int fd);
+static bool has_etag(const awsim::HttpRequest::Value &ifNoneMatch,
+    const std::string &etag);
+static bool if_range_matches(const awsim::HttpRequest *request,
+    const awsim::FileCache::File &file);
+static bool is_not_modified(const awsim::HttpRequest *request,
+    const awsim::FileCache::File &file);
+static bool parse_http_date(const awsim::HttpRequest::Value &value,
+    time_t &time);
+
+static awsim::FileCache::Encoding choose_encoding(
+    const awsim::AcceptEncoding &accepted, uint8_t variants)
+{
+    // Coding of each encoding that has siblings, after Identity
+    static const awsim::AcceptEncoding::Coding codings[] = {
+        awsim::AcceptEncoding::Coding::Brotli,
+        awsim::AcceptEncoding::Coding::Zstd,
+        awsim::AcceptEncoding::Coding::Gzip
+    };
+    awsim::FileCache::Encoding best = awsim::FileCache::Encoding::Identity;
+    int bestQuality = 0;
+
+    // The encodings are listed in order of preference, so ties go to the
+    // first one
+    for (uint8_t i = 1; i < awsim::FileCache::NUMBER_OF_ENCODINGS; ++i)
+    {
+        int quality = accepted.get_quality(codings[i - 1]);
+
+        if ((variants & (1 << i)) && quality > bestQuality)
+        {
+            best = (awsim::FileCache::Encoding)i;
+            bestQuality = quality;
+        }
+    }
+    return best;
+}
+
+static int duplicate_fd(int fd)
 {
-    struct stat s;
+    int duplicate = dup(fd);
 
-    staticFileFd = openat(rootDirectoryFd, url.c_str(), 0,
-        O_RDONLY | O_NOATIME);
-    if (staticFileFd == -1)
+    if (duplicate == -1)
     {
-        switch (errno)
+        if (errno == EMFILE || errno == ENFILE)
         {
-            case EACCES:
-                throw FileForbiddenException();
-            case ENOENT:
-            case ENOTDIR:
-            case EFAULT:
-                isStatic = false;
-                // File is missing; it may be a dynamic page
-                return;
-            default:
-                throw std::runtime_error("openat("
-                    + std::to_string(rootDirectoryFd) + ", \"" + url
-                    + "\", 0, O_RDONLY | O_NOATIME) failed -> "
-                    + strerror(errno));
+            throw awsim::UnavailableException("dup(" + std::to_string(fd)
+                + ") failed -> " + strerror(errno));
         }
+        throw std::runtime_error("dup(" + std::to_string(fd)
+            + ") failed -> " + strerror(errno));
     }
+    return duplicate;
+}
 
-    if (fstat(staticFileFd, &s) == -1)
+// Whether the list of entity tags in If-None-Match has etag, comparing them
+// weakly as the header asks for
+static bool has_etag(const awsim::HttpRequest::Value &ifNoneMatch,
+    const std::string &etag)
+{
+    const char *it = ifNoneMatch.buffer;
+    const char *end = it + ifNoneMatch.length;
+
+    // If-None-Match: W/"1f-5e0c-d20", "2a-5e0c-d20"
+    while (it < end)
     {
-        throw std::runtime_error("fstat(" + std::to_string(staticFileFd)
-            + ", &s) failed -> " + strerror(errno));
+        const char *tag;
+
+        while (it < end && (*it == ' ' || *it == '\t' || *it == ','))
+        {
+            ++it;
+        }
+        if (it < end && *it == '*')
+        {
+            return true;
+        }
+        if (end - it > 2 && it[0] == 'W' && it[1] == '/')
+        {
+            it += 2;
+        }
+        tag = it;
+        if (it < end && *it == '"')
+        {
+            ++it;
+            while (it < end && *it != '"')
+            {
+                ++it;
+            }
+            if (it < end)
+            {
+                ++it;
+            }
+        }
+        if ((size_t)(it - tag) == etag.size()
+            && memcmp(tag, etag.data(), etag.size()) == 0)
+        {
+            return true;
+        }
+        while (it < end && *it != ',')
+        {
+            ++it;
+        }
     }
+    return false;
+}
 
-    staticFileSize = s.st_size;
-    isStatic = true;
+// Whether the file is still the version If-Range names, so that the client
+// can put the ranges together with what it has
+static bool if_range_matches(const awsim::HttpRequest *request,
+    const awsim::FileCache::File &file)
+{
+    const awsim::HttpRequest::Value &ifRange =
+        request->get_field(awsim::HttpRequest::Field::IfRange);
+    time_t date;
+
+    if (!ifRange.set)
+    {
+        return true;
+    }
+    // Only strong entity tags count, weak ones start with W/
+    if (ifRange.length > 0 && ifRange.buffer[0] == '"')
+    {
+        return ifRange.length == file.etag.size()
+            && memcmp(ifRange.buffer, file.etag.data(), ifRange.length) == 0;
+    }
+    return parse_http_date(ifRange, date) && date == file.modified.tv_sec;
 }
 
-void awsim::Resource::init(const std::string &url, int rootDirectoryFd,
-    const DynamicPages &dynamicPages)
+static bool is_not_modified(const awsim::HttpRequest *request,
+    const awsim::FileCache::File &file)
 {
-    get_static_file(url, rootDirectoryFd);
-    if (!isStatic)
+    const awsim::HttpRequest::Value &ifNoneMatch =
+        request->get_field(awsim::HttpRequest::Field::IfNoneMatch);
+    const awsim::HttpRequest::Value &ifModifiedSince =
+        request->get_field(awsim::HttpRequest::Field::IfModifiedSince);
+    time_t since;
+
+    if (request->method != awsim::HttpRequest::Method::GET
+        && request->method != awsim::HttpRequest::Method::HEAD)
     {
-        dynamicPage = dynamicPages.get_dynamic_page(url);
-        if (dynamicPage == nullptr)
+        return false;
+    }
+    // If-Modified-Since only counts when there is no If-None-Match
+    if (ifNoneMatch.set)
+    {
+        return has_etag(ifNoneMatch, file.etag);
+    }
+    return ifModifiedSince.set && parse_http_date(ifModifiedSince, since)
+        && file.modified.tv_sec <= since;
+}
+
+// Parses an IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT"), the only format
+// that is sent nowadays
+static bool parse_http_date(const awsim::HttpRequest::Value &value,
+    time_t &time)
+{
+    char buf[64];
+    tm date;
+
+    if (value.length >= sizeof(buf))
+    {
+        return false;
+    }
+    memcpy(buf, value.buffer, value.length);
+    buf[value.length] = '\0';
+    memset(&date, 0, sizeof(date));
+    if (strptime(buf, "%a, %d %b %Y %H:%M:%S GMT", &date) == nullptr)
+    {
+        return false;
+    }
+    time = timegm(&date);
+    return true;
+}
+
+std::string awsim::Resource::get_contents() const
+{
+    std::string contents(staticFile->size, '\0');
+    size_t done = 0;
+
+    while (done < contents.size())
+    {
+        ssize_t count = pread(staticFile->fd, &contents[done],
+            contents.size() - done, done);
+
+        if (count == -1 && errno == EINTR)
         {
-            throw FileNotFoundException();
+            continue;
         }
+        if (count <= 0)
+        {
+            throw std::runtime_error("pread(" + std::to_string(staticFile->fd)
+                + ", ...) failed -> " + (count == 0 ? "File shrank"
+                : strerror(errno)));
+        }
+        done += count;
+    }
+    return contents;
+}
+
+awsim::DynamicPage awsim::Resource::get_dynamic_page() const
+{
+    return match.dynamicPage;
+}
+
+awsim::DynamicPageBody awsim::Resource::get_dynamic_page_body() const
+{
+    return match.dynamicPageBody;
+}
+
+void awsim::Resource::get_static_file(const std::string &url,
+    int rootDirectoryFd, FileCache *fileCache)
+{
+    const char *path = url.c_str();
+
+    // URLs are absolute, but the file is opened beneath the directory fd,
+    // which only takes relative paths
+    while (*path == '/')
+    {
+        ++path;
+    }
+    if (*path == '\0')
+    {
+        isStatic = false;
+        return;
+    }
+
+    this->fileCache = fileCache;
+    this->rootDirectoryFd = rootDirectoryFd;
+    if (fileCache != nullptr)
+    {
+        staticFile = fileCache->get(rootDirectoryFd, path,
+            FileCache::Encoding::Identity);
+        staticPath = path;
+    }
+    else
+    {
+        ownFile.open(rootDirectoryFd, path, FileCache::Encoding::Identity);
+        staticFile = &ownFile;
+    }
+    if (staticFile->forbidden)
+    {
+        isStatic = false;
+        throw FileForbiddenException();
+    }
+    // A missing file may be a dynamic page
+    isStatic = staticFile->fd != -1;
+}
+
+void awsim::Resource::init(const std::string &url,
+    HttpRequest::Method method, int rootDirectoryFd,
+    const DynamicPages &dynamicPages, FileCache *fileCache)
+{
+    ownFile.close();
+    get_static_file(url, rootDirectoryFd, fileCache);
+    if (!isStatic && !dynamicPages.get_dynamic_page(url, method, match))
+    {
+        throw FileNotFoundException();
     }
 }
 
@@ -56,62 +266,270 @@ bool awsim::Resource::is_static()
     return isStatic;
 }
 
-awsim::Resource::Resource()
+awsim::Resource::Resource() :
+    isStatic(false),
+    match(),
+    staticFile(nullptr),
+    fileCache(nullptr),
+    rootDirectoryFd(-1)
 {
-
+    ownFile.fd = -1;
 }
 
-awsim::Resource::Resource(const std::string &url, int rootDirectoryFd,
-    const DynamicPages &dynamicPages)
+awsim::Resource::Resource(const std::string &url,
+    HttpRequest::Method method, int rootDirectoryFd,
+    const DynamicPages &dynamicPages) :
+    isStatic(false),
+    match(),
+    staticFile(nullptr),
+    fileCache(nullptr),
+    rootDirectoryFd(-1)
 {
-    init(url, rootDirectoryFd, dynamicPages);
+    ownFile.fd = -1;
+    init(url, method, rootDirectoryFd, dynamicPages, nullptr);
 }
 
 awsim::Resource::~Resource()
 {
-    if (isStatic)
-    {
-        close(staticFileFd);
-    }
+    ownFile.close();
 }
 
 void awsim::Resource::respond(HttpRequest *request, Client *client) const
 {
     if (isStatic)
     {
-        send_static_file(client->sock);
+        send_static_file(request, client);
     }
     else
     {
-        dynamicPage(request, client);
+        // The path the route matched is the one of the request
+        request->numberOfParams = match.numberOfCaptures;
+        for (unsigned i = 0; i < match.numberOfCaptures; ++i)
+        {
+            const Router::Capture &capture = match.captures[i];
+            HttpRequest::Param &param = request->params[i];
+
+            param.name = capture.name.data();
+            param.nameLength = capture.name.size();
+            param.value.buffer = request->path.buffer + capture.offset;
+            param.value.length = capture.length;
+            param.value.set = true;
+        }
+        match.dynamicPage(request, client);
     }
 }
 
-void awsim::Resource::send_static_file(int sock) const
+void awsim::Resource::send_ranges(const FileCache::File &file,
+    const ByteRanges &ranges, bool headersOnly, Client *client)
 {
-    HttpResponse response(1, 1, HttpResponse::StatusCode::OK_200);
-    response.set_content_length(staticFileSize);
-    try
+    HttpResponse response(1, 1, HttpResponse::StatusCode::PartialContent_206);
+    ByteRanges::Range range = ranges.get_bounds();
+    char part[128];
+    uint64_t length = 0;
+    uint64_t read = 0;
+    int fd;
+
+    response.set_connection(client->keepAlive
+        ? HttpResponse::Connection::KeepAlive
+        : HttpResponse::Connection::Close);
+    if (file.variants != 0 || file.compressible)
     {
-        response.send_to(sock);
+        response.set_vary(HttpResponse::Vary::AcceptEncoding);
     }
-    catch (const std::exception &ex)
+    if (ranges.get_status() == ByteRanges::Status::NotSatisfiable)
     {
-        throw std::runtime_error(
-            std::string("Failed to send HTTP response -> ")
-            + ex.what());
+        HttpResponse notSatisfiable(1, 1,
+            HttpResponse::StatusCode::RangeNotSatisfiable_416);
+
+        notSatisfiable.set_connection(client->keepAlive
+            ? HttpResponse::Connection::KeepAlive
+            : HttpResponse::Connection::Close);
+        notSatisfiable.set_content_length(0);
+        notSatisfiable.set_content_range(file.size);
+        notSatisfiable.send_to(client);
+        return;
     }
-    size_t sent = 0;
-    while (sent < staticFileSize)
+    response.set_etag(file.etag);
+    response.set_last_modified(file.modified.tv_sec);
+
+    if (ranges.get_count() > 1 && !ranges.is_truncated())
     {
-        ssize_t tmp = sendfile(sock, staticFileFd, nullptr, staticFileSize);
-        if (tmp == -1)
+        for (uint8_t i = 0; i < ranges.get_count(); ++i)
         {
-            throw std::runtime_error("sendfile("
-                + std::to_string(sock) + ", " + std::to_string(staticFileFd)
-                + ", nullptr, " + std::to_string(staticFileSize)
-                + ") failed -> " + strerror(errno));
+            const ByteRanges::Range &current = ranges.get(i);
+
+            length += snprintf(part, sizeof(part), "\r\n--%s\r\n"
+                "Content-Range: bytes %" PRIu64 "-%" PRIu64 "/%zu\r\n\r\n",
+                HttpResponse::BYTERANGES_BOUNDARY, current.first,
+                current.last, file.size);
+            length += current.last - current.first + 1;
+            read += current.last - current.first + 1;
+        }
+        length += snprintf(part, sizeof(part), "\r\n--%s--\r\n",
+            HttpResponse::BYTERANGES_BOUNDARY);
+    }
+    if (length == 0 || (!file.inMemory && read > MULTIPART_READ_LIMIT))
+    {
+        // A single range, or one covering all of them, goes out like a
+        // whole file
+        length = range.last - range.first + 1;
+        response.set_content_range(range.first, range.last, file.size);
+        response.set_content_length(length);
+        response.send_to(client);
+        if (headersOnly)
+        {
+            return;
+        }
+        if (file.inMemory)
+        {
+            client->queue(file.contents.data() + range.first, length);
+            return;
         }
-        sent += tmp;
+        fd = duplicate_fd(file.fd);
+        client->queue_file(fd, range.first, length);
+        return;
     }
+
+    response.set_content_type(HttpResponse::MimeType::Multipart_Byteranges);
+    response.set_content_length(length);
+    response.send_to(client);
+    if (headersOnly)
+    {
+        return;
+    }
+    for (uint8_t i = 0; i < ranges.get_count(); ++i)
+    {
+        const ByteRanges::Range &current = ranges.get(i);
+
+        client->queue(part, snprintf(part, sizeof(part), "\r\n--%s\r\n"
+            "Content-Range: bytes %" PRIu64 "-%" PRIu64 "/%zu\r\n\r\n",
+            HttpResponse::BYTERANGES_BOUNDARY, current.first, current.last,
+            file.size));
+        if (file.inMemory)
+        {
+            client->queue(file.contents.data() + current.first,
+                current.last - current.first + 1);
+        }
+        else
+        {
+            client->queue_from_file(file.fd, current.first,
+                current.last - current.first + 1);
+        }
+    }
+    client->queue(part, snprintf(part, sizeof(part), "\r\n--%s--\r\n",
+        HttpResponse::BYTERANGES_BOUNDARY));
+}
+
+void awsim::Resource::send_static_file(HttpRequest *request,
+    Client *client) const
+{
+    const FileCache::File *file = staticFile;
+    const HttpRequest::Value &range =
+        request->get_field(HttpRequest::Field::Range);
+    AcceptEncoding accepted(
+        request->get_field(HttpRequest::Field::AcceptEncoding));
+    Compressor::Format format;
+    bool compressOnTheFly;
+    const char *compressed;
+    size_t compressedLength;
+    const std::string *headers;
+    // HEAD gets the headers GET would, on every path below. Anything more
+    // would be taken for the start of the next response on the connection.
+    bool headersOnly = request->method == HttpRequest::Method::HEAD;
+    int fd;
+
+    // Ranges are served from the file itself, never from a sibling or
+    // compressed on the fly. A conditional request that the file satisfies
+    // as a whole gets its 304 below.
+    if (fileCache != nullptr && range.set
+        && (request->method == HttpRequest::Method::GET || headersOnly)
+        && !is_not_modified(request, *file)
+        && if_range_matches(request, *file))
+    {
+        ByteRanges ranges(range, file->size);
+
+        if (ranges.get_status() != ByteRanges::Status::Ignored)
+        {
+            send_ranges(*file, ranges, headersOnly, client);
+            return;
+        }
+    }
+
+    if (file->variants != 0)
+    {
+        FileCache::Encoding encoding = choose_encoding(accepted,
+            file->variants);
+
+        if (encoding != FileCache::Encoding::Identity)
+        {
+            file = fileCache->get(rootDirectoryFd, staticPath.c_str(),
+                encoding);
+            if (file->fd == -1)
+            {
+                // Removed since the siblings were last looked for
+                file = fileCache->get(rootDirectoryFd, staticPath.c_str(),
+                    FileCache::Encoding::Identity);
+            }
+        }
+    }
+
+    // Without a sibling the client takes, files in memory are compressed on
+    // the fly, once, as the cache keeps the output. The others are large
+    // ones that go out by sendfile.
+    compressOnTheFly = file->encoding == FileCache::Encoding::Identity
+        && file->compressible && file->inMemory
+        && client->compressor != nullptr
+        && Compressor::choose_format(accepted, format);
+
+    // The error pages of domains are not cached, and are not answered with
+    // 304 either
+    if (fileCache != nullptr && is_not_modified(request, *file))
+    {
+        headers = &file->notModified[compressOnTheFly][client->keepAlive];
+        client->queue(headers->data(), headers->size());
+        return;
+    }
+
+    if (compressOnTheFly && fileCache->compress(rootDirectoryFd,
+        staticPath.c_str(), format, *client->compressor, compressed,
+        compressedLength))
+    {
+        HttpResponse response(1, 1, HttpResponse::StatusCode::OK_200);
+
+        response.set_connection(client->keepAlive
+            ? HttpResponse::Connection::KeepAlive
+            : HttpResponse::Connection::Close);
+        response.set_content_encoding(format == Compressor::Format::Gzip
+            ? HttpResponse::ContentEncoding::Gzip
+            : HttpResponse::ContentEncoding::Deflate);
+        response.set_etag("W/" + file->etag);
+        response.set_last_modified(file->modified.tv_sec);
+        response.set_vary(HttpResponse::Vary::AcceptEncoding);
+        if (headersOnly)
+        {
+            response.set_content_length(compressedLength);
+            response.send_to(client);
+            return;
+        }
+        response.send_to(client, compressed, compressedLength);
+        return;
+    }
+
+    headers = &file->headers[client->keepAlive];
+    client->queue(headers->data(), headers->size());
+    if (headersOnly)
+    {
+        return;
+    }
+    if (file->inMemory)
+    {
+        // Goes out with the headers in a single send
+        client->queue(file->contents.data(), file->size);
+        return;
+    }
+
+    // The body may still be going out after the file has left the cache, so
+    // the client gets a descriptor of its own
+    fd = duplicate_fd(file->fd);
+    client->queue_file(fd, 0, file->size);
 }
@@ -3,13 +3,20 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
 #include <string>
 #include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "AcceptEncoding.h"
+#include "ByteRanges.h"
+#include "Compressor.h"
 #include "DynamicPage.h"
 #include "DynamicPages.h"
+#include "FileCache.h"
 #include "HttpResponse.h"
 
 namespace awsim
@@ -17,27 +24,53 @@ namespace awsim
     class Resource
     {
     public:
+        // Parts of a multipart/byteranges response that are not in memory
+        // are read into the client's output. Past this many bytes the
+        // ranges are sent as one range that covers them all.
+        static const uint64_t MULTIPART_READ_LIMIT = 1048576;
+
         struct FileForbiddenException : public std::exception {};
 
         struct FileNotFoundException : public std::exception {};
 
-        Resource(const std::string &url, int rootDirectoryFd,
-            const DynamicPages &dynamicPages);
+        Resource(const std::string &url, HttpRequest::Method method,
+            int rootDirectoryFd, const DynamicPages &dynamicPages);
         Resource();
         ~Resource();
 
+        // The whole static file, for responses that are built once
+        std::string get_contents() const;
+        // Only set for dynamic pages
+        DynamicPage get_dynamic_page() const;
+        // nullptr as well for dynamic pages without a body handler
+        DynamicPageBody get_dynamic_page_body() const;
+        // Dynamic pages find what their route captured in the params of
+        // request
         void respond(HttpRequest *request, Client *client) const;
-        void init(const std::string &url, int rootDirectoryFd,
-            const DynamicPages &dynamicPages);
+        // Static files are taken from fileCache, and stay valid until its
+        // next lookup. Without a cache the resource opens and owns the file,
+        // and precompressed siblings are not served. A URL that is no file
+        // goes to the route of method.
+        void init(const std::string &url, HttpRequest::Method method,
+            int rootDirectoryFd, const DynamicPages &dynamicPages,
+            FileCache *fileCache);
         bool is_static();
     private:
         bool isStatic;
-        DynamicPage dynamicPage;
-        int staticFileFd;
-        size_t staticFileSize;
+        // Captures are offsets into the URL
+        Router::Match match;
+        const FileCache::File *staticFile;
+        FileCache::File ownFile;
+        // Where the precompressed siblings of a static file are looked up
+        FileCache *fileCache;
+        int rootDirectoryFd;
+        std::string staticPath;
 
-        void get_static_file(const std::string &url, int rootDirectoryFd);
-        void send_static_file(int sock) const;
+        void get_static_file(const std::string &url, int rootDirectoryFd,
+            FileCache *fileCache);
+        static void send_ranges(const FileCache::File &file,
+            const ByteRanges &ranges, bool headersOnly, Client *client);
+        void send_static_file(HttpRequest *request, Client *client) const;
     };
 }
 
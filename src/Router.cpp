@@ -0,0 +1,342 @@
+#include "Router.h"
+
+awsim::Router::Router() :
+    count(0)
+{
+    init({});
+}
+
+void awsim::Router::add_route(std::vector<BuildRoute> &routes,
+    BuildRoute &&route)
+{
+    for (const BuildRoute &existing : routes)
+    {
+        if (existing.entry.anyMethod == route.entry.anyMethod
+            && (route.entry.anyMethod
+            || existing.entry.method == route.entry.method))
+        {
+            throw std::runtime_error("Route \""
+                + std::string(route.entry.pattern) + "\" exists already");
+        }
+    }
+    routes.push_back(std::move(route));
+}
+
+uint32_t awsim::Router::add_text(std::string_view part)
+{
+    uint32_t offset = text.size();
+
+    text.append(part);
+    return offset;
+}
+
+const awsim::Router::Route* awsim::Router::find_route(const Node &node,
+    bool wildcard, HttpRequest::Method method) const
+{
+    const Route *anyMethod = nullptr;
+    const Route *get = nullptr;
+    uint32_t first = node.firstRoute + (wildcard ? node.numberOfRoutes : 0);
+    uint32_t end = first + (wildcard ? node.numberOfWildcards
+        : node.numberOfRoutes);
+
+    for (uint32_t i = first; i < end; ++i)
+    {
+        const Route &route = routes[i];
+
+        if (route.anyMethod)
+        {
+            anyMethod = &route;
+        }
+        else if (route.method == method)
+        {
+            return &route;
+        }
+        else if (route.method == HttpRequest::Method::GET
+            && method == HttpRequest::Method::HEAD)
+        {
+            get = &route;
+        }
+    }
+    return get != nullptr ? get : anyMethod;
+}
+
+void awsim::Router::init(const std::vector<Entry> &entries)
+{
+    BuildNode root;
+
+    nodes.clear();
+    firstBytes.clear();
+    text.clear();
+    routes.clear();
+    names.clear();
+    count = 0;
+    for (const Entry &entry : entries)
+    {
+        insert(root, entry);
+    }
+    lay_out(root);
+    count = entries.size();
+}
+
+void awsim::Router::insert(BuildNode &root, const Entry &entry)
+{
+    std::string_view pattern = entry.pattern;
+    BuildRoute route{entry, {}};
+    BuildNode *node = &root;
+    bool wildcard = false;
+    size_t i = 0;
+
+    if (pattern.empty() || pattern[0] != '/')
+    {
+        throw std::runtime_error("Route \"" + std::string(pattern)
+            + "\" does not start with '/'");
+    }
+
+    while (i < pattern.size())
+    {
+        size_t start = i;
+        size_t nameStart;
+        char kind;
+
+        // Captures take whole segments, a ':' or '*' elsewhere is text
+        while (i < pattern.size() && !((pattern[i] == ':'
+            || pattern[i] == '*') && pattern[i - 1] == '/'))
+        {
+            ++i;
+        }
+        node = insert_static(node, pattern.substr(start, i - start));
+        if (i == pattern.size())
+        {
+            break;
+        }
+
+        kind = pattern[i++];
+        nameStart = i;
+        while (i < pattern.size() && pattern[i] != '/')
+        {
+            ++i;
+        }
+        if (i == nameStart)
+        {
+            throw std::runtime_error("Route \"" + std::string(pattern)
+                + "\" has a capture without a name");
+        }
+        if (route.names.size() == MAX_CAPTURES)
+        {
+            throw std::runtime_error("Route \"" + std::string(pattern)
+                + "\" has more than " + std::to_string(MAX_CAPTURES)
+                + " captures");
+        }
+        route.names.push_back(pattern.substr(nameStart, i - nameStart));
+        if (kind == '*')
+        {
+            if (i != pattern.size())
+            {
+                throw std::runtime_error("Route \"" + std::string(pattern)
+                    + "\" goes on after its wildcard");
+            }
+            wildcard = true;
+            break;
+        }
+        if (node->param == nullptr)
+        {
+            node->param = std::make_unique<BuildNode>();
+        }
+        node = node->param.get();
+    }
+
+    add_route(wildcard ? node->wildcards : node->routes, std::move(route));
+}
+
+awsim::Router::BuildNode* awsim::Router::insert_static(BuildNode *node,
+    std::string_view text)
+{
+    while (!text.empty())
+    {
+        BuildNode *child = nullptr;
+        size_t common = 0;
+        size_t i = 0;
+
+        for (; i < node->children.size(); ++i)
+        {
+            if (node->children[i]->prefix[0] == text[0])
+            {
+                child = node->children[i].get();
+                break;
+            }
+        }
+        if (child == nullptr)
+        {
+            node->children.push_back(std::make_unique<BuildNode>());
+            node->children.back()->prefix = text;
+            return node->children.back().get();
+        }
+
+        while (common < child->prefix.size() && common < text.size()
+            && child->prefix[common] == text[common])
+        {
+            ++common;
+        }
+        if (common < child->prefix.size())
+        {
+            // The text leaves the prefix of the child halfway, the shared
+            // part becomes a node of its own
+            std::unique_ptr<BuildNode> split = std::make_unique<BuildNode>();
+
+            split->prefix = child->prefix.substr(0, common);
+            child->prefix.erase(0, common);
+            split->children.push_back(std::move(node->children[i]));
+            node->children[i] = std::move(split);
+            child = node->children[i].get();
+        }
+        text.remove_prefix(common);
+        node = child;
+    }
+    return node;
+}
+
+void awsim::Router::lay_out(const BuildNode &root)
+{
+    std::vector<const BuildNode*> queue{&root};
+
+    // Breadth first, so that the children of a node end up next to each
+    // other, with the index of every node its place in the queue
+    for (size_t i = 0; i < queue.size(); ++i)
+    {
+        const BuildNode &build = *queue[i];
+        Node node;
+
+        node.prefixOffset = add_text(build.prefix);
+        node.prefixLength = build.prefix.size();
+        node.firstRoute = routes.size();
+        node.numberOfRoutes = build.routes.size();
+        node.numberOfWildcards = build.wildcards.size();
+        for (const std::vector<BuildRoute> *list
+            : {&build.routes, &build.wildcards})
+        {
+            for (const BuildRoute &route : *list)
+            {
+                routes.push_back({route.entry.anyMethod, route.entry.method,
+                    route.entry.dynamicPage, route.entry.dynamicPageBody,
+                    (uint32_t)names.size()});
+                for (std::string_view name : route.names)
+                {
+                    names.push_back({add_text(name), (uint32_t)name.size()});
+                }
+            }
+        }
+
+        node.firstChild = queue.size();
+        node.numberOfChildren = build.children.size();
+        for (const std::unique_ptr<BuildNode> &child : build.children)
+        {
+            queue.push_back(child.get());
+        }
+        node.param = NO_NODE;
+        if (build.param != nullptr)
+        {
+            node.param = queue.size();
+            queue.push_back(build.param.get());
+        }
+
+        nodes.push_back(node);
+        firstBytes += build.prefix.empty() ? '\0' : build.prefix[0];
+    }
+}
+
+bool awsim::Router::match(std::string_view path, HttpRequest::Method method,
+    Match &match) const
+{
+    match.dynamicPage = nullptr;
+    match.dynamicPageBody = nullptr;
+    match.numberOfCaptures = 0;
+    return match_node(nodes[0], path, 0, method, 0, match);
+}
+
+bool awsim::Router::match_node(const Node &node, std::string_view path,
+    size_t position, HttpRequest::Method method, unsigned depth,
+    Match &match) const
+{
+    const Route *route;
+
+    if (position == path.size())
+    {
+        route = find_route(node, false, method);
+        if (route != nullptr)
+        {
+            set_match(*route, depth, match);
+            return true;
+        }
+    }
+    else
+    {
+        const char *first = firstBytes.data() + node.firstChild;
+
+        for (uint32_t i = 0; i < node.numberOfChildren; ++i)
+        {
+            if (first[i] == path[position])
+            {
+                const Node &child = nodes[node.firstChild + i];
+
+                if (path.size() - position >= child.prefixLength
+                    && memcmp(path.data() + position,
+                    text.data() + child.prefixOffset, child.prefixLength) == 0
+                    && match_node(child, path, position + child.prefixLength,
+                    method, depth, match))
+                {
+                    return true;
+                }
+                break;
+            }
+        }
+        if (node.param != NO_NODE)
+        {
+            size_t end = path.find('/', position);
+
+            if (end == std::string_view::npos)
+            {
+                end = path.size();
+            }
+            if (end > position)
+            {
+                match.captures[depth].offset = position;
+                match.captures[depth].length = end - position;
+                if (match_node(nodes[node.param], path, end, method,
+                    depth + 1, match))
+                {
+                    return true;
+                }
+            }
+        }
+    }
+
+    route = find_route(node, true, method);
+    if (route != nullptr)
+    {
+        match.captures[depth].offset = position;
+        match.captures[depth].length = path.size() - position;
+        set_match(*route, depth + 1, match);
+        return true;
+    }
+    return false;
+}
+
+void awsim::Router::set_match(const Route &route, unsigned depth,
+    Match &match) const
+{
+    match.dynamicPage = route.dynamicPage;
+    match.dynamicPageBody = route.dynamicPageBody;
+    match.numberOfCaptures = depth;
+    for (unsigned i = 0; i < depth; ++i)
+    {
+        const Name &name = names[route.firstName + i];
+
+        match.captures[i].name = std::string_view(text.data() + name.offset,
+            name.length);
+    }
+}
+
+size_t awsim::Router::size() const
+{
+    return count;
+}
@@ -0,0 +1,152 @@
+#ifndef AWSIM_ROUTER_H
+#define AWSIM_ROUTER_H
+
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <string.h>
+#include <vector>
+
+#include "DynamicPage.h"
+#include "HttpRequest.h"
+
+namespace awsim
+{
+    // Finds the dynamic page of a URL path. A route is static text with
+    // ":name" segments, which capture up to the next '/', and may end in a
+    // "*name" that captures the rest of the path, like
+    // "/users/:id/posts/*rest". Static text wins over a ":name", and a
+    // ":name" over a "*name".
+    //
+    // The static text of all routes is kept in a radix tree, one node per
+    // run of text that routes share, so a lookup reads every byte of the
+    // path about once and only steps back to try a capture when the static
+    // text leads nowhere. The tree is built once and laid out flat: nodes
+    // sit in one array with the children of a node next to each other,
+    // the first bytes of their text in another, and all text in a third.
+    //
+    // A route may be limited to one method, and routes for GET answer HEAD
+    // too. A lookup never allocates: captures are offsets into the path,
+    // named by the route.
+    class Router
+    {
+    public:
+        static const unsigned MAX_CAPTURES = HttpRequest::MAX_PARAMS;
+
+        struct Capture
+        {
+            std::string_view name;
+            size_t offset;
+            size_t length;
+        };
+
+        struct Match
+        {
+            DynamicPage dynamicPage;
+            // nullptr when the page has no body handler
+            DynamicPageBody dynamicPageBody;
+            unsigned numberOfCaptures;
+            Capture captures[MAX_CAPTURES];
+        };
+
+        // Entries for any method leave method unused
+        struct Entry
+        {
+            std::string_view pattern;
+            bool anyMethod;
+            HttpRequest::Method method;
+            DynamicPage dynamicPage;
+            DynamicPageBody dynamicPageBody;
+        };
+
+        Router();
+
+        // Replaces the routes. Throws when a pattern is malformed or two
+        // entries have the same route.
+        void init(const std::vector<Entry> &entries);
+        // Matches a normalized path, without its query. Returns false when
+        // no route does.
+        bool match(std::string_view path, HttpRequest::Method method,
+            Match &match) const;
+        size_t size() const;
+
+    private:
+        static const uint32_t NO_NODE = UINT32_MAX;
+
+        struct Route
+        {
+            bool anyMethod;
+            HttpRequest::Method method;
+            DynamicPage dynamicPage;
+            DynamicPageBody dynamicPageBody;
+            // Of the captures, in order, in names
+            uint32_t firstName;
+        };
+
+        struct Name
+        {
+            uint32_t offset;
+            uint32_t length;
+        };
+
+        struct Node
+        {
+            // Static text between the parent and this node, in text
+            uint32_t prefixOffset;
+            uint32_t prefixLength;
+            uint32_t firstChild;
+            uint32_t numberOfChildren;
+            // Follows a ":name" segment
+            uint32_t param;
+            // The routes that end here, then the ones whose "*name" starts
+            // here
+            uint32_t firstRoute;
+            uint16_t numberOfRoutes;
+            uint16_t numberOfWildcards;
+        };
+
+        // The tree while it is built, before it is laid out
+        struct BuildRoute
+        {
+            Entry entry;
+            std::vector<std::string_view> names;
+        };
+
+        struct BuildNode
+        {
+            std::string prefix;
+            std::vector<std::unique_ptr<BuildNode>> children;
+            std::unique_ptr<BuildNode> param;
+            std::vector<BuildRoute> routes;
+            std::vector<BuildRoute> wildcards;
+        };
+
+        std::vector<Node> nodes;
+        // First byte of the prefix of each node
+        std::string firstBytes;
+        // Prefixes and capture names
+        std::string text;
+        std::vector<Route> routes;
+        std::vector<Name> names;
+        size_t count;
+
+        static void add_route(std::vector<BuildRoute> &routes,
+            BuildRoute &&route);
+        uint32_t add_text(std::string_view part);
+        const Route* find_route(const Node &node, bool wildcard,
+            HttpRequest::Method method) const;
+        static void insert(BuildNode &root, const Entry &entry);
+        static BuildNode* insert_static(BuildNode *node,
+            std::string_view text);
+        void lay_out(const BuildNode &root);
+        bool match_node(const Node &node, std::string_view path,
+            size_t position, HttpRequest::Method method, unsigned depth,
+            Match &match) const;
+        void set_match(const Route &route, unsigned depth,
+            Match &match) const;
+    };
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "Routing.h"
+
+awsim::Routing::Routing(const Config &config) :
+    epoch(0)
+{
+    std::vector<std::pair<std::string_view, const Domain*>> names;
+    const Domain *localhostDomain = nullptr;
+
+    for (const Config::Domain &domain : config.domains)
+    {
+        #ifdef AWSIM_DEBUG
+            syslog(LOG_DEBUG, "Adding domain \"%s\"", domain.name.c_str());
+        #endif
+        try
+        {
+            domains.emplace(std::piecewise_construct,
+                std::forward_as_tuple(domain.name),
+                std::forward_as_tuple(domain));
+        }
+        catch (const std::exception &ex)
+        {
+            throw std::runtime_error("Failed to add domain \"" + domain.name
+                + "\" -> " + ex.what());
+        }
+    }
+
+    names.reserve(domains.size());
+    for (const auto &entry : domains)
+    {
+        names.emplace_back(entry.second.name, &entry.second);
+        if (entry.second.name == config.localhostDomainName)
+        {
+            #ifdef AWSIM_DEBUG
+                syslog(LOG_DEBUG, "localhost domain is \"%s\"",
+                    entry.second.name.c_str());
+            #endif
+            localhostDomain = &entry.second;
+        }
+    }
+    hosts.init(names, localhostDomain);
+}
+
+uint64_t awsim::Routing::get_epoch() const
+{
+    return epoch;
+}
+
+const awsim::HostTable& awsim::Routing::get_hosts() const
+{
+    return hosts;
+}
+
+size_t awsim::Routing::get_number_of_domains() const
+{
+    return domains.size();
+}
+
+void awsim::Routing::set_epoch(uint64_t epoch)
+{
+    this->epoch = epoch;
+}
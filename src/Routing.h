@@ -0,0 +1,46 @@
+#ifndef AWSIM_ROUTING_H
+#define AWSIM_ROUTING_H
+
+#include <string>
+#include <string_view>
+#include <syslog.h>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Config.h"
+#include "Domain.h"
+#include "HostTable.h"
+
+namespace awsim
+{
+    // The domains of a configuration and the table that finds them by Host
+    // header. A snapshot does not change once it is built, so the workers
+    // read it without locking. Reloading the configuration builds a new
+    // snapshot and publishes it through ServerInfo. The old one is deleted
+    // once every worker has either moved on to the new one or is waiting
+    // for events, which is the only time a worker holds no pointers into
+    // a snapshot.
+    class Routing
+    {
+    public:
+        Routing(const Config &config);
+
+        // The epoch of ServerInfo the snapshot was published at. Unlike its
+        // address, which a later snapshot may be allocated at, it tells
+        // snapshots apart even after this one is deleted.
+        uint64_t get_epoch() const;
+        const HostTable& get_hosts() const;
+        size_t get_number_of_domains() const;
+        // Only before the snapshot is published
+        void set_epoch(uint64_t epoch);
+
+    private:
+        std::unordered_map<std::string, Domain> domains;
+        uint64_t epoch;
+        HostTable hosts;
+    };
+}
+
+#endif
@@ -3,14 +3,16 @@
 #define WORKERS_PIPE_BUFFER_LENGTH 1024
 
 const std::string awsim::Server::CONFIG_FILE_PATH = "/etc/awsimd.conf";
+const uint64_t awsim::Server::NO_OWNER;
 
 //static void change_directory(const std::string &directory);
 static int create_epoll(int consoleSocket, int signalsfd,
     int workersReadfd);
 static int create_remote_host_internet_socket(sockaddr_storage *address,
-    uint16_t port);
+    uint16_t port, bool reusePort);
 static int create_remote_host_unix_socket(const std::string &path);
 static int create_signal_fd();
+static int open_spool_directory(const std::string &path);
 static void create_worker_pipe(int *readfd, int *writefd);
 static void delete_fd_from_epoll(int epollfd, int fd);
 static ssize_t get_message_from_console(int epollfd, int consoleSocket,
@@ -40,9 +42,25 @@ void awsim::Server::accept_console()
 
 void awsim::Server::add_worker()
 {
+    int httpSocket = info.httpSocket;
+
+    if (reusePort)
+    {
+        try
+        {
+            httpSocket = take_http_socket();
+        }
+        catch (const std::exception &ex)
+        {
+            throw std::runtime_error(
+                std::string("Failed to get an HTTP socket for worker -> ")
+                + ex.what());
+        }
+        httpSocketOwners[httpSocket] = nextWorkerID;
+    }
     workers.emplace(
         std::piecewise_construct, std::make_tuple(nextWorkerID),
-        std::forward_as_tuple(nextWorkerID, info));
+        std::forward_as_tuple(nextWorkerID, info, httpSocket));
     nextWorkerID++;
 }
 
@@ -68,6 +86,22 @@ void awsim::Server::add_worker()
     }
 }*/
 
+void awsim::Server::close_http_sockets()
+{
+    if (reusePort)
+    {
+        for (const auto &entry : httpSocketOwners)
+        {
+            close(entry.first);
+        }
+        httpSocketOwners.clear();
+    }
+    else
+    {
+        close(info.httpSocket);
+    }
+}
+
 static int create_epoll(int consoleSocket, int signalsfd,
     int workersReadfd)
 {
@@ -115,7 +149,7 @@ static int create_epoll(int consoleSocket, int signalsfd,
 }
 
 static int create_remote_host_internet_socket(sockaddr_storage *address,
-    uint16_t port)
+    uint16_t port, bool reusePort)
 {
     addrinfo hints;
     addrinfo *results;
@@ -136,9 +170,12 @@ static int create_remote_host_internet_socket(sockaddr_storage *address,
 
     for (addrinfo *ai = results; ai != nullptr; ai = ai->ai_next)
     {
+        int lowWatermark;
         size_t size;
 
-        fd = socket(results->ai_family, results->ai_socktype,
+        // Non-blocking, as a worker can be woken for a connection another
+        // worker has already accepted
+        fd = socket(results->ai_family, results->ai_socktype | SOCK_NONBLOCK,
             results->ai_protocol);
         size = results->ai_family == AF_INET ? sizeof(sockaddr_in)
             : sizeof(sockaddr_in6);
@@ -151,6 +188,35 @@ static int create_remote_host_internet_socket(sockaddr_storage *address,
                 + std::to_string(results->ai_protocol) + " failed -> "
                 + strerror(errno));
         }
+        if (reusePort)
+        {
+            int enable = 1;
+
+            if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable,
+                sizeof(enable)) == -1)
+            {
+                syslog(LOG_ERR, "setsockopt(%d, SOL_SOCKET, SO_REUSEPORT, "
+                    "&enable, %zu) failed -> %s.", fd, sizeof(enable),
+                    strerror(errno));
+                close(fd);
+                fd = -1;
+                continue;
+            }
+        }
+        // Accepted sockets inherit it, which saves a syscall per connection
+        // and covers the io_uring backend, whose direct descriptors cannot be
+        // passed to setsockopt
+        lowWatermark = awsim::Worker::NOT_SENT_LOW_WATERMARK;
+        if (setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowWatermark,
+            sizeof(lowWatermark)) == -1)
+        {
+            syslog(LOG_ERR, "setsockopt(%d, IPPROTO_TCP, TCP_NOTSENT_LOWAT, "
+                "&lowWatermark, %zu) failed -> %s.", fd, sizeof(lowWatermark),
+                strerror(errno));
+            close(fd);
+            fd = -1;
+            continue;
+        }
         if (bind(fd, results->ai_addr, size) == -1)
         {
             char addrstr[MAX(INET_ADDRSTRLEN, INET6_ADDRSTRLEN)];
@@ -239,6 +305,13 @@ static int create_signal_fd()
             std::string("sigemptyset(&sigset) failed -> ") + strerror(errno));
     }
 
+    if (sigaddset(&sigset, SIGHUP) == -1)
+    {
+        throw std::runtime_error(
+            std::string("sigaddset(&sigset, SIGHUP) failed -> ")
+            + strerror(errno));
+    }
+
     if (sigaddset(&sigset, SIGINT) == -1)
     {
         throw std::runtime_error(
@@ -267,6 +340,15 @@ static int create_signal_fd()
             + strerror(errno));
     }
 
+    // A client that goes away while a response is still being written should
+    // only fail that write, sendfile has no MSG_NOSIGNAL
+    if (signal(SIGPIPE, SIG_IGN) == SIG_ERR)
+    {
+        throw std::runtime_error(
+            std::string("signal(SIGPIPE, SIG_IGN) failed -> ")
+            + strerror(errno));
+    }
+
     fd = signalfd(-1, &sigset, 0);
     if (fd == -1)
     {
@@ -303,11 +385,11 @@ void awsim::Server::end()
 {
     syslog(LOG_INFO, "Ending.");
     end_workers();
-    close(info.httpSocket);
+    close_http_sockets();
     close(consoleSocket);
     close(epollfd);
     unlink(consoleSocketPath.c_str());
-    info.domains.clear();
+    delete info.routing.exchange(nullptr);
     syslog(LOG_INFO, "Ended.");
 }
 
@@ -470,6 +552,9 @@ bool awsim::Server::handle_signal()
 
     switch (siginfo.ssi_signo)
     {
+        case SIGHUP:
+            reload();
+            return false;
         case SIGINT:
             end();
             return true;
@@ -488,15 +573,13 @@ void awsim::Server::handle_workers()
     char buffer[WORKERS_PIPE_BUFFER_LENGTH];
     char *offset;
     ssize_t length;
-    WorkersPipeHeader header;
+    WorkerAndServerFlags::ToServerHeader header;
 
     length = read_fd(workersReadfd, buffer, sizeof(buffer));
     offset = buffer;
-    while ((size_t)length >= sizeof(WorkersPipeHeader))
+    while ((size_t)length >= sizeof(header))
     {
-        header.workerID = ((uint64_t*)buffer)[0];
-        header.flag = (WorkerAndServerFlags::ToServerFlags)((uint16_t*)(buffer
-            + sizeof(uint64_t)))[0];
+        memcpy(&header, offset, sizeof(header));
 
         #ifdef AWSIM_DEBUG
             syslog(LOG_DEBUG, "Received %s from worker %" PRIu64,
@@ -510,8 +593,8 @@ void awsim::Server::handle_workers()
             throw std::runtime_error(
                 "Received message from worker with invalid ID");
         }
-        length -= sizeof(WorkersPipeHeader);
-        offset += sizeof(WorkersPipeHeader);
+        length -= sizeof(header);
+        offset += sizeof(header);
 
         switch(header.flag)
         {
@@ -522,8 +605,19 @@ void awsim::Server::handle_workers()
                 #endif
                 workers.erase(header.workerID);
                 break;
+            case WorkerAndServerFlags::ToServerFlags::Crashed:
+                // The kernel would go on handing its listening sockets their
+                // share of new connections, with nobody to accept them
+                syslog(LOG_ERR, "Removing crashed worker %" PRIu64,
+                    header.workerID);
+                workers.erase(header.workerID);
+                if (reusePort)
+                {
+                    hand_over_http_sockets(header.workerID);
+                }
+                break;
             case WorkerAndServerFlags::ToServerFlags::NumberOfClients:
-                worker->second.numberOfClients = ((uint64_t*)buffer)[0];
+                worker->second.numberOfClients = ((uint64_t*)offset)[0];
                 length -= sizeof(uint64_t);
                 offset += sizeof(uint64_t);
                 break;
@@ -536,29 +630,34 @@ void awsim::Server::handle_workers()
 
 awsim::Server::Server()
 {
-    start();
-
+    // The signals have to be blocked before the workers are started, the
+    // threads inherit the mask and would otherwise take them
     try
     {
-        create_worker_pipe(&workersReadfd, &info.workersWritefd);
+        signalsfd = create_signal_fd();
     }
     catch (const std::exception &ex)
     {
         throw std::runtime_error(
-            std::string("Failed to create workers pipe -> ") + ex.what());
+            std::string("Failed to create a signal file descriptor -> ")
+            + ex.what());
     }
 
+    // The first snapshot is published at epoch 1
+    info.routing = nullptr;
+    info.routingEpoch = 0;
     try
     {
-        signalsfd = create_signal_fd();
+        create_worker_pipe(&workersReadfd, &info.workersWritefd);
     }
     catch (const std::exception &ex)
     {
         throw std::runtime_error(
-            std::string("Failed to create a signal file descriptor -> ")
-            + ex.what());
+            std::string("Failed to create workers pipe -> ") + ex.what());
     }
 
+    start();
+
     try
     {
         consoleSocket = create_remote_host_unix_socket(consoleSocketPath);
@@ -585,6 +684,56 @@ awsim::Server::Server()
     loop();
 }
 
+void awsim::Server::hand_over_http_sockets(uint64_t workerID)
+{
+    std::unordered_map<uint64_t, uint64_t> counts;
+
+    for (const auto &entry : workers)
+    {
+        if (!entry.second.weakStopRequested)
+        {
+            counts[entry.first] = 0;
+        }
+    }
+    for (const auto &entry : httpSocketOwners)
+    {
+        if (counts.count(entry.second) != 0)
+        {
+            counts[entry.second]++;
+        }
+    }
+
+    for (auto &entry : httpSocketOwners)
+    {
+        uint64_t adopter = NO_OWNER;
+
+        if (entry.second != workerID)
+        {
+            continue;
+        }
+        for (const auto &count : counts)
+        {
+            if (adopter == NO_OWNER || count.second < counts[adopter])
+            {
+                adopter = count.first;
+            }
+        }
+
+        // Without an adopter the socket waits, queue and all, for the next
+        // worker to be started
+        entry.second = adopter;
+        if (adopter != NO_OWNER)
+        {
+            #ifdef AWSIM_DEBUG
+                syslog(LOG_DEBUG, "Handing HTTP socket %d from worker %" PRIu64
+                    " to worker %" PRIu64, entry.first, workerID, adopter);
+            #endif
+            workers.at(adopter).request_add_http_socket(entry.first);
+            counts[adopter]++;
+        }
+    }
+}
+
 void awsim::Server::loop()
 {
     epoll_event events[NUMBER_OF_EPOLL_EVENTS];
@@ -609,6 +758,32 @@ void awsim::Server::loop()
     }
 }
 
+static int open_spool_directory(const std::string &path)
+{
+    int fd = open(path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    int file;
+
+    if (fd == -1)
+    {
+        throw std::runtime_error("open(" + path + ", O_PATH | O_DIRECTORY | "
+            "O_CLOEXEC) failed -> " + strerror(errno));
+    }
+    // Find out now rather than on the first large upload whether the file
+    // system has unnamed files
+    file = openat(fd, ".", O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (file == -1)
+    {
+        int error = errno;
+
+        close(fd);
+        throw std::runtime_error("openat(" + path + ", \".\", O_TMPFILE | "
+            "O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR) failed -> "
+            + strerror(error));
+    }
+    close(file);
+    return fd;
+}
+
 static ssize_t read_fd(int fd, void *buffer, size_t length)
 {
     ssize_t result;
@@ -622,6 +797,51 @@ static ssize_t read_fd(int fd, void *buffer, size_t length)
     return result;
 }
 
+void awsim::Server::publish_routing(Routing *routing)
+{
+    // Only this thread publishes, so the epoch is known up front
+    uint64_t epoch = info.routingEpoch.load() + 1;
+    const Routing *previous;
+
+    routing->set_epoch(epoch);
+    previous = info.routing.exchange(routing);
+    info.routingEpoch = epoch;
+
+    // A worker that is waiting for events holds no pointers into the
+    // previous snapshot, and one that saw the new epoch has taken the new
+    // snapshot. Workers finish their batch of events quickly, so waiting
+    // here beats keeping track of retired snapshots.
+    for (auto &entry : workers)
+    {
+        uint64_t seen;
+
+        while ((seen = entry.second.routingEpoch.load())
+            != Worker::QUIESCENT_ROUTING_EPOCH && seen < epoch)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    delete previous;
+}
+
+void awsim::Server::reload()
+{
+    syslog(LOG_INFO, "Reloading domains.");
+    try
+    {
+        Config config(CONFIG_FILE_PATH);
+
+        publish_routing(new Routing(config));
+    }
+    catch (const std::exception &ex)
+    {
+        // The domains in use stay as they are
+        syslog(LOG_ERR, "Failed to reload domains -> %s", ex.what());
+        return;
+    }
+    syslog(LOG_INFO, "Reloaded domains.");
+}
+
 void awsim::Server::restart()
 {
     syslog(LOG_INFO, "Restarting.");
@@ -633,6 +853,8 @@ static std::string signo_to_string(uint32_t signal)
 {
     switch(signal)
     {
+        case SIGHUP:
+            return "SIGHUP";
         case SIGINT:
             return "SIGINT";
         case SIGQUIT:
@@ -657,7 +879,19 @@ void awsim::Server::start()
     numberOfWorkers = 0;
     staticNumberOfWorkers = config.staticNumberOfWorkers;
     dynamicNumberOfWorkers = config.dynamicNumberOfWorkers;
+    info.compression = config.compression;
+    info.eventLoop = config.eventLoop;
+    info.fileCacheEntries = config.fileCacheEntries;
+    info.fileCacheMemory = config.fileCacheMemory;
+    info.fileCacheTtl = config.fileCacheTtl;
+    info.keepAliveTimeout = config.keepAliveTimeout;
+    info.maxBodySize = config.maxBodySize;
     info.minimumSizeOfLargeFiles = config.minimumSizeOfLargeFiles;
+    info.minimumSizeOfSpooledBodies = config.minimumSizeOfSpooledBodies;
+    httpPort = config.httpPort;
+    reusePort = config.reusePort;
+    info.requestHeaderTimeout = config.requestHeaderTimeout;
+    info.writeTimeout = config.writeTimeout;
     percentOfCoresForWorkers = config.percentOfCoresForWorkers;
 
     /*try
@@ -670,37 +904,22 @@ void awsim::Server::start()
             + ex.what());
     }*/
 
-    for (Config::Domain &domain : config.domains)
-    {
-        #ifdef AWSIM_DEBUG
-            syslog(LOG_DEBUG, "Adding domain \"%s\"", domain.name.c_str());
-        #endif
-        try
-        {
-            info.domains.emplace(std::piecewise_construct,
-                std::forward_as_tuple(domain.name),
-                std::forward_as_tuple(domain));
-        }
-        catch (const std::exception &ex)
-        {
-            throw std::runtime_error("Failed to add domain \"" + domain.name
-                + "\" -> " + ex.what());
-        }
+    publish_routing(new Routing(config));
 
-        if (domain.name == config.localhostDomainName)
-        {
-            #ifdef AWSIM_DEBUG
-                syslog(LOG_DEBUG, "localhost domain is \"%s\"",
-                    domain.name.c_str());
-            #endif
-            info.localhostDomain = info.domains.find(domain.name);
-        }
+    try
+    {
+        info.spoolDirectoryFd = open_spool_directory(config.spoolDirectory);
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(std::string("Failed to open spool directory "
+            "-> ") + ex.what());
     }
 
     try
     {
         info.httpSocket = create_remote_host_internet_socket(&info.address,
-            config.httpPort);
+            config.httpPort, reusePort);
     }
     catch (const std::exception &ex)
     {
@@ -708,6 +927,12 @@ void awsim::Server::start()
             + ex.what());
     }
 
+    if (reusePort)
+    {
+        // Handed to the first worker
+        httpSocketOwners.emplace(info.httpSocket, NO_OWNER);
+    }
+
     start_workers();
 
     inet_ntop(info.address.ss_family, &info.address, addrstr,
@@ -719,7 +944,15 @@ void awsim::Server::start()
 void awsim::Server::start_workers()
 {
     uint64_t count = staticNumberOfWorkers;
-    auto size = workers.size();
+    uint64_t size = 0;
+
+    for (const auto &entry : workers)
+    {
+        if (!entry.second.weakStopRequested)
+        {
+            size++;
+        }
+    }
 
     if (dynamicNumberOfWorkers)
     {
@@ -742,10 +975,19 @@ void awsim::Server::start_workers()
         #ifdef AWSIM_DEBUG
             syslog(LOG_DEBUG, "Removing %lu workers.", size - count);
         #endif
-        for (uint64_t i = size - count; i > 0; --i)
+        for (uint64_t i = size - count; i > 0; ++it)
         {
+            if (it->second.weakStopRequested)
+            {
+                continue;
+            }
+            it->second.weakStopRequested = true;
             it->second.request_weak_stop();
-            ++it;
+            if (reusePort)
+            {
+                hand_over_http_sockets(it->first);
+            }
+            --i;
         }
     }
 }
@@ -754,6 +996,39 @@ void awsim::Server::stop()
 {
     syslog(LOG_INFO, "Stopping.");
     end_workers();
-    info.domains.clear();
-    close(info.httpSocket);
+    delete info.routing.exchange(nullptr);
+    close_http_sockets();
+    close(info.spoolDirectoryFd);
+}
+
+int awsim::Server::take_http_socket()
+{
+    std::unordered_map<uint64_t, uint64_t> counts;
+    sockaddr_storage address;
+    int sock;
+
+    for (const auto &entry : httpSocketOwners)
+    {
+        if (entry.second == NO_OWNER)
+        {
+            return entry.first;
+        }
+        counts[entry.second]++;
+    }
+
+    // Take back a socket that a worker adopted from a stopped one. The
+    // adopter keeps accepting from it until its request is handled, and the
+    // queue survives the gap either way.
+    for (const auto &entry : httpSocketOwners)
+    {
+        if (counts[entry.second] > 1)
+        {
+            workers.at(entry.second).request_remove_http_socket(entry.first);
+            return entry.first;
+        }
+    }
+
+    sock = create_remote_host_internet_socket(&address, httpPort, true);
+    httpSocketOwners.emplace(sock, NO_OWNER);
+    return sock;
 }
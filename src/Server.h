@@ -2,14 +2,17 @@
 #define AWSIM_SERVER_H
 
 #include <atomic>
+#include <chrono>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
 #include <limits.h>
 #include <list>
 #include <math.h>
 #include <netdb.h>
+#include <netinet/tcp.h>
 #include <pwd.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -61,26 +64,28 @@ namespace awsim
         static const uint64_t CONSOLE_BUFFER_SIZE = 1024;
         static const uint64_t NUMBER_OF_EPOLL_EVENTS = 64;
         static const uint64_t INTERNET_BACKLOG = 1024;
+        static const uint64_t NO_OWNER = UINT64_MAX;
 
         Server();
 
     private:
-        struct WorkersPipeHeader
-        {
-            uint64_t workerID;
-            WorkerAndServerFlags::ToServerFlags flag;
-        };
-
         int consoleSocket;
         std::string consoleSocketPath;
         bool dynamicNumberOfWorkers;
         int epollfd;
+        // With SO_REUSEPORT every listening socket of the port and the
+        // worker that accepts from it. A socket keeps its queue for as long
+        // as it is open, so sockets move between workers instead of being
+        // closed.
+        std::unordered_map<int, uint64_t> httpSocketOwners;
+        uint16_t httpPort;
         ServerInfo info;
         uint64_t nextWorkerID;
         uint64_t numberOfConnectedConsoles;
         uint64_t numberOfWorkers;
         double percentOfCoresForWorkers;
         bool quit;
+        bool reusePort;
         int signalsfd;
         uint64_t staticNumberOfWorkers;
         int workersReadfd;
@@ -88,17 +93,26 @@ namespace awsim
 
         void accept_console();
         void add_worker();
+        void close_http_sockets();
         void end();
         void end_workers();
         bool handle_console(int consoleSocket);
         bool handle_epoll_events(int count, epoll_event *events);
         bool handle_signal();
         void handle_workers();
+        void hand_over_http_sockets(uint64_t workerID);
         void loop();
+        // Replaces the routing snapshot of the workers and deletes the
+        // previous one once none of them can be using it
+        void publish_routing(Routing *routing);
+        // Rereads the domains of the configuration, on SIGHUP. Everything
+        // else in it takes a restart.
+        void reload();
         void restart();
         void start();
         void start_workers();
         void stop();
+        int take_http_socket();
     };
 };
 
@@ -1,24 +1,47 @@
 #ifndef AWSIM_SERVERINFO_H
 #define AWSIM_SERVERINFO_H
 
+#include <atomic>
 #include <sys/socket.h>
 #include <string>
 #include <stdint.h>
-#include <unordered_map>
 
-#include "Domain.h"
+#include "Config.h"
+#include "ErrorResponses.h"
+#include "Routing.h"
 
 namespace awsim
 {
     struct ServerInfo
     {
         sockaddr_storage address;
-        std::unordered_map<std::string, Domain> domains;
-        std::unordered_map<std::string, Domain>::iterator localhostDomain;
+        bool compression;
+        // For requests that fail before they reach a domain
+        ErrorResponses errorResponses;
+        Config::EventLoop eventLoop;
+        uint64_t fileCacheEntries;
+        uint64_t fileCacheMemory;
+        uint64_t fileCacheTtl;
         int httpSocket;
         int httpsSocket;
+        uint64_t keepAliveTimeout;
+        // Longer request bodies are answered with 413
+        uint64_t maxBodySize;
         uint64_t minimumSizeOfLargeFiles;
+        // Bodies at least this long go to an unnamed file in the spool
+        // directory instead of the read buffer, see HttpRequest::bodyFd.
+        // So do shorter ones that turn out not to fit in it.
+        uint64_t minimumSizeOfSpooledBodies;
+        uint64_t requestHeaderTimeout;
+        // The published routing snapshot, and the number of snapshots
+        // published so far. Workers record the count they saw before taking
+        // the snapshot, see Routing.
+        std::atomic<const Routing*> routing;
+        std::atomic<uint64_t> routingEpoch;
+        // O_PATH descriptor of the spool directory
+        int spoolDirectoryFd;
         int workersWritefd;
+        uint64_t writeTimeout;
     };
 }
 
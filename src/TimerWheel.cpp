@@ -0,0 +1,212 @@
+#include "TimerWheel.h"
+
+#define SLOT_MASK (awsim::TimerWheel::SLOTS - 1)
+#define LEVEL_SHIFT(level) ((level) * awsim::TimerWheel::SLOT_BITS)
+#define LEVEL_SPAN(level) ((uint64_t)1 << LEVEL_SHIFT(level))
+#define ROTATE_RIGHT(x, r) (((x) >> (r)) | ((x) << ((64 - (r)) & 63)))
+
+static_assert(awsim::TimerWheel::SLOTS == 64,
+    "Slot occupancy is tracked in a single 64 bit word per level");
+
+awsim::TimerWheel::TimerWheel()
+{
+    clear(0);
+}
+
+awsim::TimerWheel::Timer* awsim::TimerWheel::advance(uint64_t now)
+{
+    Timer *expired = nullptr;
+
+    while (current < now)
+    {
+        uint64_t level;
+        uint64_t index;
+        Timer *timer;
+
+        if (occupied[0] == 0)
+        {
+            // Nothing can expire before level 0 wraps around, skip ahead to
+            // the next cascade
+            uint64_t wrap = current | SLOT_MASK;
+            if (wrap >= now)
+            {
+                current = now;
+                break;
+            }
+            current = wrap;
+        }
+        current++;
+
+        // Cascade the higher levels first so their timers can fall all the
+        // way down to level 0 on this tick
+        level = 1;
+        while (level < LEVELS && (current & (LEVEL_SPAN(level) - 1)) == 0)
+        {
+            level++;
+        }
+        while (--level > 0)
+        {
+            cascade(level);
+        }
+
+        index = current & SLOT_MASK;
+        timer = slots[0][index];
+        slots[0][index] = nullptr;
+        occupied[0] &= ~((uint64_t)1 << index);
+        while (timer != nullptr)
+        {
+            Timer *next = timer->next;
+
+            timer->scheduled = false;
+            timer->prev = nullptr;
+            timer->next = expired;
+            expired = timer;
+            timer = next;
+        }
+    }
+
+    return expired;
+}
+
+void awsim::TimerWheel::cancel(Timer *timer)
+{
+    if (timer->scheduled)
+    {
+        unlink(timer);
+        timer->scheduled = false;
+    }
+}
+
+void awsim::TimerWheel::cascade(uint64_t level)
+{
+    uint64_t index = (current >> LEVEL_SHIFT(level)) & SLOT_MASK;
+    Timer *timer = slots[level][index];
+
+    slots[level][index] = nullptr;
+    occupied[level] &= ~((uint64_t)1 << index);
+    while (timer != nullptr)
+    {
+        Timer *next = timer->next;
+
+        insert(timer);
+        timer = next;
+    }
+}
+
+void awsim::TimerWheel::clear(uint64_t now)
+{
+    current = now;
+    for (uint64_t level = 0; level < LEVELS; ++level)
+    {
+        occupied[level] = 0;
+        for (uint64_t index = 0; index < SLOTS; ++index)
+        {
+            slots[level][index] = nullptr;
+        }
+    }
+}
+
+uint64_t awsim::TimerWheel::get_current_tick() const
+{
+    return current;
+}
+
+int64_t awsim::TimerWheel::get_ticks_until_next_expiry() const
+{
+    int64_t ticks = -1;
+
+    for (uint64_t level = 0; level < LEVELS; ++level)
+    {
+        uint64_t index;
+        uint64_t distance;
+        uint64_t rotated;
+        int64_t tmp;
+
+        if (occupied[level] == 0)
+        {
+            continue;
+        }
+
+        // Bit n of rotated is the slot n positions after the current one, a
+        // timer in the current slot of a higher level is a full turn away
+        index = (current >> LEVEL_SHIFT(level)) & SLOT_MASK;
+        rotated = ROTATE_RIGHT(occupied[level], index);
+        distance = (rotated & ~(uint64_t)1) != 0
+            ? __builtin_ctzll(rotated & ~(uint64_t)1) : SLOTS;
+
+        tmp = (int64_t)((((current >> LEVEL_SHIFT(level)) + distance)
+            << LEVEL_SHIFT(level)) - current);
+        if (ticks == -1 || tmp < ticks)
+        {
+            ticks = tmp;
+        }
+    }
+
+    return ticks;
+}
+
+void awsim::TimerWheel::insert(Timer *timer)
+{
+    uint64_t delta = timer->expiry - current;
+    uint64_t level = 0;
+    uint64_t index;
+
+    while (level < LEVELS - 1 && delta >= LEVEL_SPAN(level + 1))
+    {
+        level++;
+    }
+    index = (timer->expiry >> LEVEL_SHIFT(level)) & SLOT_MASK;
+
+    timer->level = (uint8_t)level;
+    timer->slot = (uint8_t)index;
+    timer->prev = nullptr;
+    timer->next = slots[level][index];
+    if (timer->next != nullptr)
+    {
+        timer->next->prev = timer;
+    }
+    slots[level][index] = timer;
+    occupied[level] |= (uint64_t)1 << index;
+}
+
+void awsim::TimerWheel::schedule(Timer *timer, uint64_t expiry)
+{
+    if (timer->scheduled)
+    {
+        unlink(timer);
+    }
+    if (expiry <= current)
+    {
+        expiry = current + 1;
+    }
+    else if (expiry - current >= MAX_TICKS)
+    {
+        expiry = current + MAX_TICKS - 1;
+    }
+
+    timer->expiry = expiry;
+    timer->scheduled = true;
+    insert(timer);
+}
+
+void awsim::TimerWheel::unlink(Timer *timer)
+{
+    if (timer->prev != nullptr)
+    {
+        timer->prev->next = timer->next;
+    }
+    else
+    {
+        slots[timer->level][timer->slot] = timer->next;
+        if (timer->next == nullptr)
+        {
+            occupied[timer->level] &= ~((uint64_t)1 << timer->slot);
+        }
+    }
+    if (timer->next != nullptr)
+    {
+        timer->next->prev = timer->prev;
+    }
+    timer->next = nullptr;
+    timer->prev = nullptr;
+}
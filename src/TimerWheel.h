@@ -0,0 +1,55 @@
+#ifndef AWSIM_TIMERWHEEL_H
+#define AWSIM_TIMERWHEEL_H
+
+#include <stdint.h>
+
+namespace awsim
+{
+    // Hierarchical timer wheel. Timers are intrusive, so scheduling,
+    // cancelling and expiring a timer are O(1) and never allocate. Time is
+    // measured in ticks, the owner decides how long a tick is.
+    class TimerWheel
+    {
+    public:
+        static const uint64_t LEVELS = 4;
+        static const uint64_t SLOT_BITS = 6;
+        static const uint64_t SLOTS = 1 << SLOT_BITS;
+        static const uint64_t MAX_TICKS = (uint64_t)1 << (SLOT_BITS * LEVELS);
+
+        struct Timer
+        {
+            Timer *next;
+            Timer *prev;
+            uint64_t expiry;
+            bool scheduled;
+            uint8_t level;
+            uint8_t slot;
+            void *data;
+        };
+
+        TimerWheel();
+
+        // Moves the wheel forward to now and returns the timers that expired
+        // on the way as a list linked through next. They are no longer
+        // scheduled when they are returned.
+        Timer* advance(uint64_t now);
+        void cancel(Timer *timer);
+        void clear(uint64_t now);
+        uint64_t get_current_tick() const;
+        // Returns how many ticks can pass before a timer may have to be
+        // expired (or cascaded), or -1 if no timer is scheduled
+        int64_t get_ticks_until_next_expiry() const;
+        void schedule(Timer *timer, uint64_t expiry);
+
+    private:
+        uint64_t current;
+        uint64_t occupied[LEVELS];
+        Timer *slots[LEVELS][SLOTS];
+
+        void cascade(uint64_t level);
+        void insert(Timer *timer);
+        void unlink(Timer *timer);
+    };
+}
+
+#endif
@@ -0,0 +1,8 @@
+#include "UnavailableException.h"
+
+awsim::UnavailableException::UnavailableException(
+    const std::string &message) :
+    std::runtime_error(message)
+{
+
+}
@@ -0,0 +1,19 @@
+#ifndef AWSIM_UNAVAILABLEEXCEPTION_H
+#define AWSIM_UNAVAILABLEEXCEPTION_H
+
+#include <stdexcept>
+#include <string>
+
+namespace awsim
+{
+    // The server ran short of something, such as file descriptors, while
+    // answering a request that is fine in itself. The client is told to
+    // try again later rather than that the server failed.
+    class UnavailableException : public std::runtime_error
+    {
+    public:
+        UnavailableException(const std::string &message);
+    };
+}
+
+#endif
@@ -3,7 +3,6 @@
 #define SERVER_PIPE_PTR (void*)0x0
 #define HTTP_REMOTE_HOST_PTR (void*)0x1
 #define HTTPS_REMOTE_HOST_PTR (void*)0x2
-#define HTTP_HEADER_BUFFER_SIZE 8192
 #define UNUSED(x) (void)(x)
 #define NO_FLAGS 0
 #define NUMBER_OF_EPOLL_EVENTS 1024
@@ -13,6 +12,16 @@
 #define IS_IN_ACTIVE_STATE(state) ((state) == State::Running \
     || (state) == State::WeakStopPending)
 
+// The io_uring backend tags every submission with the operation, the index
+// of the client in the slab and the generation of that slot
+#define GENERATION_MASK 0xffffff
+#define USER_DATA(operation, index, generation) \
+    (((uint64_t)(generation) << 40) | ((uint64_t)(uint32_t)(index) << 8) \
+    | (uint64_t)(operation))
+#define USER_DATA_GENERATION(userData) ((uint32_t)((userData) >> 40))
+#define USER_DATA_INDEX(userData) ((uint32_t)((userData) >> 8))
+#define USER_DATA_OPERATION(userData) ((RingOperation)((userData) & 0xff))
+
 static int on_message_begin(awsim::HttpRequest *request,
     awsim::ParserDetails *details, awsim::HttpParser *parser);
 static int on_url(awsim::HttpRequest *request, awsim::ParserDetails *details,
@@ -52,8 +61,17 @@ awsim::HttpParserSettings awsim::Worker::httpParserSettings =
 
 static int create_epoll(int httpSocket, int serverReadfd);
 static void create_pipe(int *readfd, int *writefd);
+static uint64_t get_nanoseconds();
+static uint64_t get_tick();
+static bool has_token(const awsim::HttpRequest::Value &value,
+    const char *token);
+static int open_body_file(int spoolDirectoryFd);
 static ssize_t read_fd(int fd, void *buffer, size_t length);
 static void remove_fd_from_epoll(int fd, int epollfd);
+static bool should_keep_alive(const awsim::HttpParser *parser,
+    const awsim::HttpRequest *request);
+static void write_body(int fd, const char *data, size_t length,
+    uint64_t offset);
 
 static int on_message_begin(awsim::HttpRequest *request,
     awsim::ParserDetails *details, awsim::HttpParser *parser)
@@ -64,32 +82,29 @@ static int on_message_begin(awsim::HttpRequest *request,
     return 0;
 }
 
-static int on_url(awsim::HttpRequest *request, awsim::ParserDetails *details,
-    awsim::HttpParser *parser, const char *at, size_t length)
+static void append_to_value(awsim::Client *client,
+    awsim::HttpRequest::Value &value, const char *at, size_t length)
 {
-    UNUSED(parser);
-    UNUSED(details);
-    bool foundPeriod = false;
-
-    request->url.buffer = at;
-    request->url.length = length;
-
-    for (size_t i = 0; i < length; ++i)
+    if (!value.set)
     {
-        if (at[i] == '.')
-        {
-            if (foundPeriod)
-            {
-                return -1;
-            }
-            foundPeriod = true;
-        }
-        else
-        {
-            foundPeriod = false;
-        }
+        value.buffer = at;
+        value.length = length;
+        value.set = true;
+    }
+    else if (at >= client->readBuffer
+        && at < client->readBuffer + awsim::Client::READ_BUFFER_SIZE)
+    {
+        // The slice was split across reads (or folded), everything in between
+        // is still in the read buffer
+        value.length = at + length - value.buffer;
     }
+}
 
+static int on_url(awsim::HttpRequest *request, awsim::ParserDetails *details,
+    awsim::HttpParser *parser, const char *at, size_t length)
+{
+    UNUSED(details);
+    append_to_value((awsim::Client*)parser->data, request->url, at, length);
     return 0;
 }
 
@@ -97,90 +112,19 @@ static int on_header_field(awsim::HttpRequest *request,
     awsim::ParserDetails *details, awsim::HttpParser *parser, const char *at,
     size_t length)
 {
-    const char *fieldString;
+    awsim::Client *client = (awsim::Client*)parser->data;
 
     UNUSED(request);
-    UNUSED(parser);
-
-    details->currentHeaderField = awsim::HttpRequest::Field::Unknown;
-    if (length > 0)
-    {
-        switch (at[0])
-        {
-            case 'H':
-                details->currentHeaderField = awsim::HttpRequest::Field::Host;
-                break;
-            case 'A':
-                // or maybe Accept-Language or Accept-Encoding
-                details->currentHeaderField = awsim::HttpRequest::Field::Accept;
-                break;
-            case 'C':
-                details->currentHeaderField = awsim::HttpRequest::Field::Connection;
-                break;
-            case 'U':
-                // or maybe Upgrade-Insecure-Requests
-                details->currentHeaderField = awsim::HttpRequest::Field::UserAgent;
-                break;
-            default:
-                details->currentHeaderField = awsim::HttpRequest::Field::Unknown;
-                break;
-        }
-    }
+    UNUSED(details);
 
-    if (details->currentHeaderField != awsim::HttpRequest::Field::Unknown)
+    if (client->headersComplete)
     {
-        fieldString = awsim::HttpRequest::fieldStrings[(int)details->currentHeaderField];
-        for (size_t i = 0; i < length; ++i)
-        {
-            char actual = at[i];
-            char desired = fieldString[i];
-
-            if (actual != desired)
-            {
-                if (details->currentHeaderField == awsim::HttpRequest::Field::Accept)
-                {
-                    details->currentHeaderField = awsim::HttpRequest::Field::AcceptEncoding;
-                    fieldString =
-                        awsim::HttpRequest::fieldStrings[(int)details->currentHeaderField];
-                    --i;
-                }
-                else if (details->currentHeaderField ==
-                    awsim::HttpRequest::Field::AcceptEncoding)
-                {
-                    details->currentHeaderField = awsim::HttpRequest::Field::AcceptLanguage;
-                    fieldString =
-                        awsim::HttpRequest::fieldStrings[(int)details->currentHeaderField];
-                    --i;
-                }
-                else if (details->currentHeaderField == awsim::HttpRequest::Field::UserAgent)
-                {
-                    details->currentHeaderField =
-                        awsim::HttpRequest::Field::UpgradeInsecureRequests;
-                    fieldString =
-                        awsim::HttpRequest::fieldStrings[(int)details->currentHeaderField];
-                    --i;
-                }
-                else
-                {
-                    details->currentHeaderField = awsim::HttpRequest::Field::Unknown;
-                    break;
-                }
-            }
-            else if (i == length - 1 && fieldString[i + 1] != '\0')
-            {
-                details->currentHeaderField = awsim::HttpRequest::Field::Unknown;
-                break;
-            }
-        }
+        // Trailers of a chunked body, the header is already handled
+        return 0;
     }
-
-    #ifdef AWSIM_DEBUG
-        if (details->currentHeaderField  == awsim::HttpRequest::Field::Unknown)
-        {
-            syslog(LOG_DEBUG, "Unknown header field \"%.*s\"", (int)length, at);
-        }
-    #endif
-
+    // The name is only matched once its value starts, it may still be split
+    // across reads
+    append_to_value(client, client->headerField, at, length);
     return 0;
 }
 
@@ -188,78 +132,83 @@ static int on_header_value(awsim::HttpRequest *request,
     awsim::ParserDetails *details, awsim::HttpParser *parser, const char *at,
     size_t length)
 {
-    UNUSED(parser);
+    awsim::Client *client = (awsim::Client*)parser->data;
+
     UNUSED(details);
 
-    switch (details->currentHeaderField)
+    if (client->headersComplete)
+    {
+        return 0;
+    }
+    if (client->headerField.set)
     {
-        case awsim::HttpRequest::Field::Host:
+        awsim::HttpRequest::Field field = awsim::HttpRequest::find_field(
+            client->headerField.buffer, client->headerField.length);
+
+        if (field != awsim::HttpRequest::Field::Unknown)
         {
-            request->host.buffer = at;
-            request->host.length = length;
-            request->host.set = true;
-            try
+            client->headerValue = request->add_field(field);
+        }
+        else
+        {
+            awsim::HttpRequest::Header *header =
+                request->add_unknown_header();
+
+            client->headerValue = nullptr;
+            if (header != nullptr)
             {
-                details->get_resource(request->url, request->host);
+                header->name = client->headerField;
+                client->headerValue = &header->value;
             }
-            catch (const awsim::ParserDetails::DomainNotFound &ex)
+        }
+        #ifdef AWSIM_DEBUG
+            if (client->headerValue == nullptr)
             {
-                #ifndef AWSIM_DEBUG
-                    syslog(LOG_DEBUG,
-                        "Client HTTP request included unknown host \"%.*s\"",
-                        length, at);
-                #endif
-                return -1;
+                syslog(LOG_DEBUG, "Dropped header \"%.*s\"",
+                    (int)client->headerField.length,
+                    client->headerField.buffer);
             }
-            break;
-        }
-        case awsim::HttpRequest::Field::UserAgent:
-            request->userAgent.buffer = at;
-            request->userAgent.length = length;
-            request->userAgent.set = true;
-            break;
-        case awsim::HttpRequest::Field::Accept:
-            request->accept.buffer = at;
-            request->accept.length = length;
-            request->accept.set = true;
-            break;
-        case awsim::HttpRequest::Field::AcceptLanguage:
-            request->acceptLanguage.buffer = at;
-            request->acceptLanguage.length = length;
-            request->acceptLanguage.set = true;
-            break;
-        case awsim::HttpRequest::Field::AcceptEncoding:
-            request->acceptEncoding.buffer = at;
-            request->acceptEncoding.length = length;
-            request->acceptEncoding.set = true;
-            break;
-        case awsim::HttpRequest::Field::Connection:
-            request->connection.buffer = at;
-            request->connection.length = length;
-            request->connection.set = true;
-            break;
-        case awsim::HttpRequest::Field::UpgradeInsecureRequests:
-            request->upgradeInsecureRequests.buffer = at;
-            request->upgradeInsecureRequests.length = length;
-            request->upgradeInsecureRequests.set = true;
-            break;
-        case awsim::HttpRequest::Field::Unknown:
-        default:
-            syslog(LOG_WARNING, "Unknown header value \"%.*s\"", (int)length,
-                at);
-            break;
+        #endif
+        client->headerField = awsim::HttpRequest::Value();
     }
 
+    if (client->headerValue != nullptr)
+    {
+        append_to_value(client, *client->headerValue, at, length);
+    }
     return 0;
 }
 
+static bool resolve_resource(awsim::HttpRequest *request,
+    awsim::ParserDetails *details)
+{
+    const awsim::HttpRequest::Value &host =
+        request->get_field(awsim::HttpRequest::Field::Host);
+
+    try
+    {
+        details->get_resource(request->path, host, request->method);
+    }
+    catch (const awsim::ParserDetails::DomainNotFound &ex)
+    {
+        #ifndef AWSIM_DEBUG
+            syslog(LOG_DEBUG,
+                "Client HTTP request included unknown host \"%.*s\"",
+                (int)host.length, host.buffer);
+        #endif
+        return false;
+    }
+    return true;
+}
+
 static int on_headers_complete(awsim::HttpRequest *request,
     awsim::ParserDetails *details, awsim::HttpParser *parser, const char *at,
     size_t length)
 {
+    awsim::Client *client = (awsim::Client*)parser->data;
+
     UNUSED(at);
     UNUSED(length);
-    UNUSED(details);
 
     switch(parser->method)
     {
@@ -336,26 +285,131 @@ static int on_headers_complete(awsim::HttpRequest *request,
             request->method = awsim::HttpRequest::Method::DELETE;
             break;
     }
+    // The whole URL is in by now
+    if (!request->normalize_url())
+    {
+        #ifdef AWSIM_DEBUG
+            syslog(LOG_DEBUG, "Client HTTP request had an invalid URL "
+                "\"%.*s\"", (int)request->url.length, request->url.buffer);
+        #endif
+        return -1;
+    }
+    client->headersComplete = true;
+
+    if ((parser->flags & awsim::F_CHUNKED) || parser->content_length > 0)
+    {
+        awsim::DynamicPageBody bodyHandler = nullptr;
+
+        if (parser->content_length > 0
+            && (uint64_t)parser->content_length
+            > details->get_max_body_size())
+        {
+            // Refused before any of it is read
+            client->bodyTooLarge = true;
+            return -1;
+        }
+        // Where the body goes has to be known before it arrives. The
+        // resource is looked up again once the body is in, as the details
+        // only last for one pass over the read buffer.
+        if (!resolve_resource(request, details))
+        {
+            return -1;
+        }
+        if (!details->takes_body(bodyHandler))
+        {
+            client->bodyHandling = awsim::Client::BodyHandling::Discard;
+        }
+        else if (bodyHandler != nullptr)
+        {
+            client->bodyHandling = awsim::Client::BodyHandling::Stream;
+            client->bodyHandler = bodyHandler;
+            client->bodyRoutingEpoch = details->get_routing()->get_epoch();
+        }
+        else if (!(parser->flags & awsim::F_CHUNKED)
+            && (uint64_t)parser->content_length
+            >= details->get_minimum_size_of_spooled_bodies())
+        {
+            // The parser is told to skip the body and completes the
+            // request, the body is then moved straight from the socket to
+            // a file by spool_body(). Chunks have to be decoded by the
+            // parser, so they are gathered and spilled to a file once they
+            // fill the read buffer.
+            client->bodyHandling = awsim::Client::BodyHandling::Spool;
+            client->spoolRemaining = parser->content_length;
+            return 1;
+        }
+        else
+        {
+            client->bodyHandling = awsim::Client::BodyHandling::Gather;
+        }
+    }
     return 0;
 }
 
 static int on_body(awsim::HttpRequest *request, awsim::ParserDetails *details,
     awsim::HttpParser *parser, const char *at, size_t length)
 {
-    UNUSED(request);
-    UNUSED(parser);
-    UNUSED(at);
-    UNUSED(length);
-    UNUSED(details);
+    awsim::Client *client = (awsim::Client*)parser->data;
+
+    client->bodyLength += length;
+    if (client->bodyLength > details->get_max_body_size())
+    {
+        // Only chunked bodies get this far, the length of the others is
+        // checked up front
+        client->bodyTooLarge = true;
+        return -1;
+    }
+    if (client->bodyEnd == 0)
+    {
+        client->bodyEnd = at - client->readBuffer;
+    }
+
+    switch (client->bodyHandling)
+    {
+        case awsim::Client::BodyHandling::Gather:
+            // Pieces are separated by the framing of chunks, and by whatever
+            // was dropped after earlier reads
+            memmove(client->readBuffer + client->bodyEnd, at, length);
+            if (!request->body.set)
+            {
+                request->body.buffer = client->readBuffer + client->bodyEnd;
+                request->body.set = true;
+            }
+            request->body.length += length;
+            client->bodyEnd += length;
+            break;
+        case awsim::Client::BodyHandling::SpoolParsed:
+            write_body(request->bodyFd, at, length,
+                client->bodyLength - length);
+            break;
+        case awsim::Client::BodyHandling::Stream:
+            if (!client->bodyHandler(request, client, at, length))
+            {
+                client->bodyTooLarge = true;
+                return -1;
+            }
+            break;
+        case awsim::Client::BodyHandling::Spool:
+        case awsim::Client::BodyHandling::Discard:
+            break;
+    }
     return 0;
 }
 
 static int on_message_complete(awsim::HttpRequest *request,
     awsim::ParserDetails *details, awsim::HttpParser *parser)
 {
-    UNUSED(request);
-    UNUSED(parser);
-    UNUSED(details);
+    awsim::Client *client = (awsim::Client*)parser->data;
+
+    if (!resolve_resource(request, details))
+    {
+        return -1;
+    }
+
+    // Stop here so the request is answered before a pipelined request is
+    // parsed out of the same read buffer
+    client->requestComplete = true;
+    awsim::http_parser_pause(parser, 1);
     return 0;
 }
 
@@ -388,67 +442,199 @@ static int on_chunk_complete(awsim::HttpRequest *request,
     return 0;
 }
 
+void awsim::Worker::AcceptStats::record(uint64_t size, bool exhausted)
+{
+    static_assert((uint64_t)1 << (BUCKETS - 1) == ACCEPT_BUDGET,
+        "The last bucket holds the batches that used up the budget");
+
+    batches++;
+    if (size == 0)
+    {
+        // Woken up, but another worker was faster
+        emptyBatches++;
+        return;
+    }
+    clients += size;
+    if (exhausted)
+    {
+        budgetExhausted++;
+    }
+    if (size > largestBatch)
+    {
+        largestBatch = size;
+    }
+    histogram[std::min((uint64_t)(63 - __builtin_clzll(size)), BUCKETS - 1)]++;
+}
+
+std::string awsim::Worker::AcceptStats::to_string() const
+{
+    std::string string = std::to_string(clients) + " clients in "
+        + std::to_string(batches) + " batches (" + std::to_string(emptyBatches)
+        + " empty, " + std::to_string(budgetExhausted)
+        + " hit the budget, largest " + std::to_string(largestBatch)
+        + "), sizes";
+
+    for (uint64_t i = 0; i < BUCKETS; ++i)
+    {
+        string += " " + std::to_string((uint64_t)1 << i)
+            + (i == BUCKETS - 1 ? "+" : "") + ":" + std::to_string(histogram[i]);
+    }
+    return string;
+}
+
 void awsim::Worker::accept_http_client()
 {
-    int clientSocket;
+    int clientSockets[ACCEPT_BUDGET];
+    uint64_t count = 0;
 
     #ifdef AWSIM_DEBUG
-        syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Accepting HTTP client.", id);
+        syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Accepting HTTP clients.", id);
     #endif
-    clientSocket = accept(serverInfo.httpSocket, nullptr, nullptr);
-    if (clientSocket == -1)
+    // All listening sockets share one epoll marker, the ones that are not
+    // ready just return EAGAIN. Each queue is drained until it is empty or
+    // the budget is used up, whatever is left is reported again by the next
+    // epoll_wait.
+    for (int httpSocket : httpSockets)
     {
-        throw std::runtime_error("accept(" + std::to_string(
-            serverInfo.httpSocket) + ", nullptr, nullptr) failed -> "
-            + strerror(errno));
+        while (count < ACCEPT_BUDGET)
+        {
+            int clientSocket = accept4(httpSocket, nullptr, nullptr,
+                SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+            if (clientSocket == -1)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    break;
+                }
+                if (errno == EINTR || errno == ECONNABORTED)
+                {
+                    continue;
+                }
+                add_http_clients(clientSockets, count);
+                throw std::runtime_error("accept4("
+                    + std::to_string(httpSocket) + ", nullptr, nullptr, "
+                    "SOCK_NONBLOCK | SOCK_CLOEXEC) failed -> "
+                    + strerror(errno));
+            }
+            clientSockets[count++] = clientSocket;
+        }
     }
 
+    acceptStats.record(count, count == ACCEPT_BUDGET);
+    add_http_clients(clientSockets, count);
+}
+
+void awsim::Worker::add_accepted_clients(const int *clientSockets,
+    uint64_t count, bool exhausted)
+{
+    // The io_uring backend collects the connections of its multishot
+    // accepts over a batch of completions
+    acceptStats.record(count, exhausted);
     try
     {
-        add_http_client(clientSocket);
+        add_http_clients(clientSockets, count);
     }
-    catch (const std::exception &ex)
+    catch (const CriticalException &ex)
     {
         throw std::runtime_error(
-            std::string("Could not add HTTP client -> ") + ex.what());
+            std::string("Failed to accept HTTP client -> ") + ex.what());
+    }
+    catch (const std::exception &ex)
+    {
+        syslog(LOG_ERR, "(Worker %" PRIu64 ") Failed to accept HTTP client -> "
+            "%s", id, ex.what());
+    }
+}
+
+void awsim::Worker::add_client_chunk()
+{
+    Client *chunk;
+
+    #ifdef AWSIM_DEBUG
+        syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Increasing max number of "
+            "clients from %" PRIu64 " to %" PRIu64, id, maxNumberOfClients,
+            maxNumberOfClients + CLIENT_CHUNK_SIZE);
+    #endif
+    if (maxNumberOfClients + CLIENT_CHUNK_SIZE > (uint64_t)UINT32_MAX + 1)
+    {
+        throw std::runtime_error("Cannot have more than "
+            + std::to_string((uint64_t)UINT32_MAX + 1) + " clients");
+    }
+    // Chunks never move, so the epoll registrations, the timers and the
+    // lists that point into the existing ones stay valid
+    chunk = (Client*)aligned_alloc(alignof(Client),
+        sizeof(Client) * CLIENT_CHUNK_SIZE);
+    if (chunk == nullptr)
+    {
+        throw CriticalException("aligned_alloc("
+            + std::to_string(alignof(Client)) + ", "
+            + std::to_string(sizeof(Client) * CLIENT_CHUNK_SIZE)
+            + ") failed -> " + strerror(errno));
+    }
+    clientChunks.push_back(chunk);
+
+    // Pushed in reverse so that the lowest index is handed out first
+    for (uint64_t i = CLIENT_CHUNK_SIZE; i-- > 0;)
+    {
+        Client &client = *new (&chunk[i]) Client();
+
+        client.index = (uint32_t)(maxNumberOfClients + i);
+        client.allocated = false;
+        client.readBuffer = nullptr;
+        client.writeBuffer = nullptr;
+        client.writeCapacity = 0;
+        client.timer.scheduled = false;
+        client.generation = 0;
+        client.overflowBuffer = nullptr;
+        client.overflowCapacity = 0;
+        // Closed by reset_request() when set
+        client.request.bodyFd = -1;
+        client.prev = nullptr;
+        client.next = unallocatedList;
+        if (unallocatedList != nullptr)
+        {
+            unallocatedList->prev = &client;
+        }
+        unallocatedList = &client;
     }
+    maxNumberOfClients += CLIENT_CHUNK_SIZE;
 }
 
 void awsim::Worker::add_http_client(int clientSocket)
 {
-    epoll_event event;
     Client *client;
 
     #ifdef AWSIM_DEBUG
         syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Adding HTTP client", id);
     #endif
-    if (_numberOfClients == maxNumberOfClients)
+    // TCP_NOTSENT_LOWAT is inherited from the listening socket. It keeps the
+    // socket from reporting itself writable (and sendfile from filling the
+    // whole send buffer) while plenty is still waiting on the peer's receive
+    // window.
+    client = unallocatedList;
+    if (client->readBuffer == nullptr)
     {
-        try
-        {
-            increase_max_number_of_clients(maxNumberOfClients * 2);
-        }
-        catch (const CriticalException &ex)
-        {
-            throw CriticalException(
-                std::string("Failed to increase max number of clients -> ")
-                + ex.what());
-        }
-        catch (const std::exception &ex)
+        client->readBuffer = (char*)malloc(Client::READ_BUFFER_SIZE);
+        if (client->readBuffer == nullptr)
         {
-            throw std::runtime_error(
-                std::string("Failed to increase max number of clients -> ")
-                + ex.what());
+            throw CriticalException("malloc("
+                + std::to_string(Client::READ_BUFFER_SIZE) + ") failed -> "
+                + strerror(errno));
         }
     }
-    client = unallocatedList;
-    event.events = EPOLLIN;
-    event.data.ptr = client;
-    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, clientSocket, &event) == -1)
+    if (!usingIoUring)
     {
-        throw std::runtime_error("epoll_ctl(" + std::to_string(epollfd)
-            + ", EPOLL_CTL_ADD, " + std::to_string(clientSocket)
-            + ", &event) failed -> " + strerror(errno));
+        epoll_event event;
+
+        event.events = EPOLLIN;
+        event.data.ptr = client;
+        if (epoll_ctl(epollfd, EPOLL_CTL_ADD, clientSocket, &event) == -1)
+        {
+            throw std::runtime_error("epoll_ctl(" + std::to_string(epollfd)
+                + ", EPOLL_CTL_ADD, " + std::to_string(clientSocket)
+                + ", &event) failed -> " + strerror(errno));
+        }
     }
 
     unallocatedList = client->next;
@@ -465,72 +651,350 @@ void awsim::Worker::add_http_client(int clientSocket)
     }
     _numberOfClients++;
     client->init(clientSocket, false);
+    client->compressor = serverInfo.compression ? &compressor : nullptr;
+    http_parser_init(&client->parser, HTTP_REQUEST);
+    client->timer.data = client;
+    set_client_deadline(client, serverInfo.requestHeaderTimeout);
+    if (usingIoUring)
+    {
+        arm_receive(client);
+    }
 }
 
-static int create_epoll(int httpSocket, int serverReadfd)
+void awsim::Worker::add_http_socket(int sock)
 {
-    int epollfd;
     epoll_event event;
 
-    if ((epollfd = epoll_create1(0)) == -1)
+    if (usingIoUring)
     {
-        throw std::runtime_error("epoll_create1(0) failed -> "
-            + std::string(strerror(errno)));
+        arm_accept(sock);
+        httpSockets.push_back(sock);
+        return;
     }
-
     event.events = EPOLLIN | EPOLLEXCLUSIVE;
     event.data.ptr = HTTP_REMOTE_HOST_PTR;
-
-    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, httpSocket, &event))
-    {
-        throw std::runtime_error("epoll_ctl(" + std::to_string(epollfd)
-            + ", EPOLL_CTL_ADD, " + std::to_string(httpSocket)
-            + ", &event) failed -> " + strerror(errno));
-    }
-
-    event.events = EPOLLIN;
-    event.data.ptr = SERVER_PIPE_PTR;
-
-    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, serverReadfd, &event))
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, sock, &event) == -1)
     {
         throw std::runtime_error("epoll_ctl(" + std::to_string(epollfd)
-            + ", EPOLL_CTL_ADD, " + std::to_string(serverReadfd)
-            + ", &event) failed -> " + strerror(errno));
+            + ", EPOLL_CTL_ADD, " + std::to_string(sock) + ", &event) failed -> "
+            + strerror(errno));
     }
-
-    return epollfd;
+    httpSockets.push_back(sock);
 }
 
-static void create_pipe(int *readfd, int *writefd)
+void awsim::Worker::add_http_clients(const int *clientSockets,
+    uint64_t count)
 {
-    int fds[2];
-
-    if (pipe(fds) == -1)
+    if (count == 0)
     {
-        throw std::runtime_error(std::string("pipe(fds) failed -> ")
-            + strerror(errno));
+        return;
     }
 
-    *readfd = fds[0];
-    *writefd = fds[1];
+    try
+    {
+        while (_numberOfClients + count > maxNumberOfClients)
+        {
+            add_client_chunk();
+        }
+    }
+    catch (const std::exception &ex)
+    {
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            close_client_socket(clientSockets[i]);
+        }
+        throw CriticalException(
+            std::string("Failed to increase max number of clients -> ")
+            + ex.what());
+    }
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        try
+        {
+            add_http_client(clientSockets[i]);
+        }
+        catch (const CriticalException &ex)
+        {
+            for (uint64_t j = i; j < count; ++j)
+            {
+                close_client_socket(clientSockets[j]);
+            }
+            throw CriticalException(
+                std::string("Could not add HTTP client -> ") + ex.what());
+        }
+        catch (const std::exception &ex)
+        {
+            close_client_socket(clientSockets[i]);
+            syslog(LOG_ERR, "(Worker %" PRIu64 ") Could not add HTTP client "
+                "-> %s", id, ex.what());
+        }
+    }
+}
+
+void awsim::Worker::arm_accept(int sock)
+{
+    io_uring_sqe *sqe = ring.get_sqe();
+
+    // The connections go straight into the table of direct descriptors, they
+    // never get a regular file descriptor (so no SOCK_CLOEXEC either)
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = sock;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK;
+    sqe->file_index = IORING_FILE_INDEX_ALLOC;
+    sqe->user_data = USER_DATA(RingOperation::Accept, sock, 0);
+}
+
+void awsim::Worker::arm_receive(Client *client)
+{
+    io_uring_sqe *sqe = ring.get_sqe();
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = client->sock;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = IoUring::BUFFER_GROUP;
+    sqe->user_data = USER_DATA(RingOperation::Receive,
+        client->index, client->generation);
+    client->receiving = true;
+    client->receiveCancelled = false;
+}
+
+void awsim::Worker::arm_server_pipe()
+{
+    io_uring_sqe *sqe = ring.get_sqe();
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = serverReadfd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = USER_DATA(RingOperation::ServerPipe, 0, 0);
+}
+
+void awsim::Worker::cancel_receive(Client *client)
+{
+    io_uring_sqe *sqe = ring.get_sqe();
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = USER_DATA(RingOperation::Receive, client->index,
+        client->generation);
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = USER_DATA(RingOperation::Cancel, 0, 0);
+    client->receiveCancelled = true;
+}
+
+void awsim::Worker::close_client_socket(int sock)
+{
+    io_uring_sqe *sqe;
+
+    if (!usingIoUring)
+    {
+        close(sock);
+        return;
+    }
+
+    // Whatever is still pending on the socket holds a reference to it, so
+    // it is cancelled first. The hard link keeps the close even when there
+    // was nothing to cancel.
+    sqe = ring.get_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = sock;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_FD_FIXED
+        | IORING_ASYNC_CANCEL_ALL;
+    sqe->flags = IOSQE_IO_HARDLINK | IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = USER_DATA(RingOperation::Cancel, 0, 0);
+
+    sqe = ring.get_sqe();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = sock + 1;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = USER_DATA(RingOperation::Close, 0, 0);
+}
+
+static int create_epoll(int httpSocket, int serverReadfd)
+{
+    int epollfd;
+    epoll_event event;
+
+    if ((epollfd = epoll_create1(0)) == -1)
+    {
+        throw std::runtime_error("epoll_create1(0) failed -> "
+            + std::string(strerror(errno)));
+    }
+
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.ptr = HTTP_REMOTE_HOST_PTR;
+
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, httpSocket, &event))
+    {
+        throw std::runtime_error("epoll_ctl(" + std::to_string(epollfd)
+            + ", EPOLL_CTL_ADD, " + std::to_string(httpSocket)
+            + ", &event) failed -> " + strerror(errno));
+    }
+
+    event.events = EPOLLIN;
+    event.data.ptr = SERVER_PIPE_PTR;
+
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, serverReadfd, &event))
+    {
+        throw std::runtime_error("epoll_ctl(" + std::to_string(epollfd)
+            + ", EPOLL_CTL_ADD, " + std::to_string(serverReadfd)
+            + ", &event) failed -> " + strerror(errno));
+    }
+
+    return epollfd;
+}
+
+void awsim::Worker::crash()
+{
+    // An armed accept would go on taking connections from the listening
+    // sockets, with nobody left to serve them
+    if (usingIoUring)
+    {
+        ring.deinit();
+    }
+    state = State::Crashed;
+    try
+    {
+        notify_server(WorkerAndServerFlags::ToServerFlags::Crashed);
+    }
+    catch (const std::exception &ex)
+    {
+        syslog(LOG_ALERT, "(Worker %" PRIu64 ") Failed to notify main thread "
+            "of crash -> %s", id, ex.what());
+    }
+}
+
+void awsim::Worker::expire_clients()
+{
+    TimerWheel::Timer *timer = timers.advance(now);
+
+    while (timer != nullptr)
+    {
+        Client *client = (Client*)timer->data;
+
+        timer = timer->next;
+        #ifdef AWSIM_DEBUG
+            syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Client timed out", id);
+        #endif
+        remove_client(client);
+    }
+}
+
+void awsim::Worker::finish_output(Client *client)
+{
+    if (client->fileFd != -1)
+    {
+        close(client->fileFd);
+        client->fileFd = -1;
+    }
+    if (client->splicePipe[0] != -1)
+    {
+        // Drained, so the next file body can go through it
+        sparePipes.emplace_back(client->splicePipe[0], client->splicePipe[1]);
+        client->splicePipe[0] = -1;
+        client->splicePipe[1] = -1;
+    }
+    client->writeLength = 0;
+    client->writeOffset = 0;
+    client->waitingForWrite = false;
+    if (complete_response(client))
+    {
+        process_requests(client);
+        if (client->allocated)
+        {
+            process_overflow(client);
+        }
+        if (client->allocated)
+        {
+            update_receive(client);
+        }
+    }
+}
+
+awsim::Client* awsim::Worker::get_client(uint64_t userData)
+{
+    uint64_t index = USER_DATA_INDEX(userData);
+    Client *client;
+
+    if (index >= maxNumberOfClients)
+    {
+        return nullptr;
+    }
+    client = &clientChunks[index / CLIENT_CHUNK_SIZE]
+        [index % CLIENT_CHUNK_SIZE];
+    if (!client->allocated
+        || client->generation != USER_DATA_GENERATION(userData))
+    {
+        // Completed after the client was removed
+        return nullptr;
+    }
+    return client;
+}
+
+static void create_pipe(int *readfd, int *writefd)
+{
+    int fds[2];
+
+    if (pipe(fds) == -1)
+    {
+        throw std::runtime_error(std::string("pipe(fds) failed -> ")
+            + strerror(errno));
+    }
+
+    *readfd = fds[0];
+    *writefd = fds[1];
+}
+
+bool awsim::Worker::complete_response(Client *client)
+{
+    if (!client->keepAlive)
+    {
+        remove_client(client);
+        return false;
+    }
+
+    // The request has been answered so its slices are no longer needed,
+    // move whatever was pipelined behind it to the front of the buffer
+    client->requestsServed++;
+    client->reset_request();
+    client->release_write_buffer();
+    client->readLength -= client->parsedLength;
+    memmove(client->readBuffer, client->readBuffer + client->parsedLength,
+        client->readLength);
+    client->parsedLength = 0;
+    set_client_deadline(client, client->readLength == 0
+        ? serverInfo.keepAliveTimeout : serverInfo.requestHeaderTimeout);
+    return true;
 }
 
 void awsim::Worker::handle_client(Client *client)
 {
-    char buffer[HTTP_HEADER_BUFFER_SIZE];
     ssize_t length;
-    size_t nparsed;
-    HttpRequest request;
 
     #ifdef AWSIM_DEBUG
         syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Handling a client", id);
     #endif
-    length = recv(client->sock, buffer, 1024, 0);
+    if (client->spoolRemaining > 0)
+    {
+        // The body is spliced out of the socket, it is not read
+        process_requests(client);
+        return;
+    }
+    length = recv(client->sock, client->readBuffer + client->readLength,
+        Client::READ_BUFFER_SIZE - client->readLength, 0);
     if (length == -1)
     {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return;
+        }
         throw std::runtime_error("recv(" + std::to_string(client->sock)
-            + ", buffer, " + std::to_string(sizeof(buffer)) + ", "
-            + std::to_string(NO_FLAGS) + ") failed -> " + strerror(errno));
+            + ", client->readBuffer + " + std::to_string(client->readLength)
+            + ", " + std::to_string(Client::READ_BUFFER_SIZE
+            - client->readLength) + ", " + std::to_string(NO_FLAGS)
+            + ") failed -> " + strerror(errno));
     }
     if (length == 0)
     {
@@ -540,19 +1004,218 @@ void awsim::Worker::handle_client(Client *client)
         remove_client(client);
         return;
     }
+    if (client->readLength == 0)
+    {
+        // A new request is starting, from now on the client only has until
+        // the header deadline to send it, no matter how it trickles in
+        set_client_deadline(client, serverInfo.requestHeaderTimeout);
+    }
+    client->readLength += length;
+
+    process_requests(client);
+}
 
-    ParserDetails details(serverInfo.domains, serverInfo.localhostDomain);
-    nparsed = http_parser_execute(&request, &details, &httpParser,
-        &httpParserSettings, buffer, length);
-    if (nparsed != (size_t)length)
+void awsim::Worker::handle_client_output(Client *client)
+{
+    #ifdef AWSIM_DEBUG
+        syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Writing to a client", id);
+    #endif
+    if (!client->flush())
     {
-        remove_client(client);
-        throw std::runtime_error("Failed to parse HTTP request");
+        // The deadline is on progress, not on the whole response
+        set_client_deadline(client, serverInfo.writeTimeout);
+        return;
+    }
+    set_client_events(client, false);
+    if (complete_response(client))
+    {
+        process_requests(client);
+    }
+}
+
+void awsim::Worker::handle_output_completion(const io_uring_cqe &cqe)
+{
+    RingOperation operation = USER_DATA_OPERATION(cqe.user_data);
+    Client *client = get_client(cqe.user_data);
+
+    if (client == nullptr)
+    {
+        if (operation == RingOperation::Send)
+        {
+            auto it = orphanedWriteBuffers.find(cqe.user_data);
+
+            if (it != orphanedWriteBuffers.end())
+            {
+                free(it->second);
+                orphanedWriteBuffers.erase(it);
+            }
+        }
+        return;
+    }
+
+    client->pendingOutputs--;
+    if (operation == RingOperation::Send)
+    {
+        client->sendPending = false;
+    }
+    if (cqe.res == -ECANCELED || cqe.res == -EAGAIN)
+    {
+        // An earlier operation of the chain came up short (or the socket
+        // filled up again), the rest is submitted again below
+    }
+    else if (cqe.res < 0)
+    {
+        throw std::runtime_error(std::string(operation == RingOperation::Send
+            ? "send" : operation == RingOperation::ReadBody ? "read" : "splice")
+            + " for client " + std::to_string(client->sock) + " failed -> "
+            + strerror(-cqe.res));
+    }
+    else if (cqe.res == 0)
+    {
+        throw std::runtime_error(operation == RingOperation::SpliceIn
+            || operation == RingOperation::ReadBody
+            ? "File " + std::to_string(client->fileFd) + " ended "
+            + std::to_string(client->fileRemaining)
+            + " bytes before the promised length"
+            : "Client " + std::to_string(client->sock) + " took no output");
     }
     else
     {
-        details.respond(&request, client);
+        switch (operation)
+        {
+            case RingOperation::ReadBody:
+                client->writeLength += cqe.res;
+                client->fileOffset += cqe.res;
+                client->fileRemaining -= cqe.res;
+                break;
+            case RingOperation::Send:
+                client->writeOffset += cqe.res;
+                break;
+            case RingOperation::SpliceIn:
+                client->fileOffset += cqe.res;
+                client->fileRemaining -= cqe.res;
+                client->pipeLength += cqe.res;
+                break;
+            default:
+                client->pipeLength -= cqe.res;
+                break;
+        }
+        // The deadline is on progress, not on the whole response
+        set_client_deadline(client, serverInfo.writeTimeout);
+    }
+
+    if (client->pendingOutputs > 0)
+    {
+        return;
+    }
+    if (client->has_pending_output() || client->pipeLength > 0)
+    {
+        send_queued_output(client);
+        return;
+    }
+    finish_output(client);
+}
+
+void awsim::Worker::handle_receive_completion(const io_uring_cqe &cqe)
+{
+    Client *client = get_client(cqe.user_data);
+
+    if (client != nullptr && !(cqe.flags & IORING_CQE_F_MORE))
+    {
+        client->receiving = false;
+    }
+    if (cqe.flags & IORING_CQE_F_BUFFER)
+    {
+        uint16_t bufferID = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+
+        if (client != nullptr && cqe.res > 0)
+        {
+            try
+            {
+                receive_data(client, ring.get_buffer(bufferID),
+                    (size_t)cqe.res);
+            }
+            catch (...)
+            {
+                ring.recycle_buffer(bufferID);
+                throw;
+            }
+        }
+        ring.recycle_buffer(bufferID);
+    }
+    if (client == nullptr || !client->allocated)
+    {
+        return;
+    }
+    if (cqe.res == 0)
+    {
+        #ifdef AWSIM_DEBUG
+            syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Client disconnected", id);
+        #endif
+        remove_client(client);
+        return;
+    }
+    // Running out of provided buffers only ends the multishot receive
+    if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED)
+    {
+        throw std::runtime_error("recv on client "
+            + std::to_string(client->sock) + " failed -> "
+            + strerror(-cqe.res));
     }
+    update_receive(client);
+}
+
+static uint64_t get_nanoseconds()
+{
+    timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+static uint64_t get_tick()
+{
+    timespec time;
+
+    // The coarse clock is read from the vDSO, it does not cost a syscall
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &time);
+    return ((uint64_t)time.tv_sec * 1000 + time.tv_nsec / 1000000)
+        / awsim::Worker::TIMER_TICK_MILLISECONDS;
+}
+
+static bool has_token(const awsim::HttpRequest::Value &value,
+    const char *token)
+{
+    size_t length = strlen(token);
+    const char *p = value.buffer;
+    const char *end = value.buffer + value.length;
+
+    while (p < end)
+    {
+        const char *start;
+        const char *tokenEnd;
+
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ','))
+        {
+            ++p;
+        }
+        start = p;
+        while (p < end && *p != ',')
+        {
+            ++p;
+        }
+        tokenEnd = p;
+        while (tokenEnd > start && (tokenEnd[-1] == ' ' || tokenEnd[-1] == '\t'))
+        {
+            --tokenEnd;
+        }
+        if ((size_t)(tokenEnd - start) == length
+            && strncasecmp(start, token, length) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
 void awsim::Worker::handle_server_pipe()
@@ -585,6 +1248,16 @@ void awsim::Worker::handle_server_pipe()
                 INSERT_FLAG(WorkerAndServerFlags::ToServerFlags::NumberOfClients, buffer);
                 ((uint64_t*)(buffer + sizeof(uint16_t)))[0] = _numberOfClients;
                 break;
+            case WorkerAndServerFlags::ToWorkerFlags::AddHttpSocketRequest:
+                add_http_socket(((int*)offset)[0]);
+                length -= sizeof(int);
+                offset += sizeof(int);
+                break;
+            case WorkerAndServerFlags::ToWorkerFlags::RemoveHttpSocketRequest:
+                remove_http_socket(((int*)offset)[0]);
+                length -= sizeof(int);
+                offset += sizeof(int);
+                break;
             default:
                 throw std::runtime_error("Received unknown flag form worker, "
                     + std::to_string((uint16_t)flag));
@@ -592,99 +1265,288 @@ void awsim::Worker::handle_server_pipe()
     }
 }
 
-void awsim::Worker::increase_max_number_of_clients(
-    uint64_t maxNumberOfClients)
+// An unnamed file in the spool directory, gone once it is closed
+static int open_body_file(int spoolDirectoryFd)
 {
-    #ifdef AWSIM_DEBUG
-        syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Increasing max number of "
-            "clients from %" PRIu64 " to %" PRIu64, id,
-            this->maxNumberOfClients, maxNumberOfClients);
-    #endif
-    if (maxNumberOfClients < this->maxNumberOfClients)
+    int fd = openat(spoolDirectoryFd, ".", O_TMPFILE | O_RDWR | O_CLOEXEC,
+        S_IRUSR | S_IWUSR);
+
+    if (fd == -1)
     {
-        throw std::runtime_error("The new max number of clients must be "
-            "greater than the current value. Current value is "
-            + std::to_string(this->maxNumberOfClients)
-            + " and the new value is "
-            + std::to_string(this->maxNumberOfClients));
+        throw std::runtime_error("openat("
+            + std::to_string(spoolDirectoryFd) + ", \".\", "
+            "O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR) failed -> "
+            + strerror(errno));
     }
+    return fd;
+}
 
-    if (maxNumberOfClients == this->maxNumberOfClients)
+void awsim::Worker::process_overflow(Client *client)
+{
+    while (client->allocated && !client->waitingForWrite
+        && client->overflowLength > 0)
     {
+        size_t length = std::min(client->overflowLength,
+            Client::READ_BUFFER_SIZE - client->readLength);
+
+        if (length == 0)
+        {
+            send_error(client, client->headersComplete
+                ? HttpResponse::StatusCode::PayloadTooLarge_413
+                : HttpResponse::StatusCode::RequestHeaderFieldsTooLarge_431);
+            return;
+        }
+        if (client->readLength == 0)
+        {
+            set_client_deadline(client, serverInfo.requestHeaderTimeout);
+        }
+        memcpy(client->readBuffer + client->readLength, client->overflowBuffer,
+            length);
+        client->readLength += length;
+        client->overflowLength -= length;
+        memmove(client->overflowBuffer, client->overflowBuffer + length,
+            client->overflowLength);
+        process_requests(client);
+    }
+}
+
+void awsim::Worker::process_requests(Client *client)
+{
+    size_t nparsed;
+
+    ParserDetails details(*routing, fileCache, serverInfo.maxBodySize,
+        serverInfo.minimumSizeOfSpooledBodies);
+    client->parser.data = client;
+    if (client->bodyHandling == Client::BodyHandling::Stream
+        && client->bodyRoutingEpoch != routingSnapshotEpoch)
+    {
+        // The configuration was reloaded while the body was streaming, the
+        // page it went to is gone
+        client->bodyHandling = Client::BodyHandling::Discard;
+        send_error(client, HttpResponse::StatusCode::ServiceUnavailable_503);
         return;
     }
-    if (this->maxNumberOfClients == 0)
+    while (client->parsedLength < client->readLength
+        || client->spoolRemaining > 0)
     {
-        clientHeap = (Client*)malloc(sizeof(Client) * maxNumberOfClients);
-        if (clientHeap == nullptr)
+        if (client->spoolRemaining == 0)
         {
-            throw CriticalException("malloc("
-               + std::to_string(sizeof(Client) * maxNumberOfClients)
-                + ") failed -> " + strerror(errno));
+            try
+            {
+                nparsed = http_parser_execute_fast(&client->request,
+                    &details, &client->parser, &httpParserSettings,
+                    client->readBuffer + client->parsedLength,
+                    client->readLength - client->parsedLength);
+            }
+            catch (const std::exception &ex)
+            {
+                // Only writing a spilled body to its file throws
+                syslog(LOG_ERR, "(Worker %" PRIu64 ") Failed to spool a "
+                    "request body -> %s", id, ex.what());
+                send_error(client,
+                    HttpResponse::StatusCode::InternalServerError_500);
+                return;
+            }
+            client->parsedLength += nparsed;
+        }
+        if (!client->requestComplete)
+        {
+            if (HTTP_PARSER_ERRNO(&client->parser) != HPE_OK)
+            {
+                // Scanners send plenty of these, they are not worth a line
+                // in the log each
+                #ifdef AWSIM_DEBUG
+                    syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Failed to parse "
+                        "HTTP request -> %s", id, http_errno_description(
+                        HTTP_PARSER_ERRNO(&client->parser)));
+                #endif
+                send_error(client, client->bodyTooLarge
+                    ? HttpResponse::StatusCode::PayloadTooLarge_413
+                    : HttpResponse::StatusCode::BadRequest_400);
+                return;
+            }
+            if (client->bodyEnd != 0 && client->parsedLength > client->bodyEnd)
+            {
+                // Whatever was parsed of the body has been gathered below
+                // bodyEnd, handed over or dropped, so the rest of it can be
+                // read into the space behind. Each read that gets the body
+                // further buys the client another header timeout.
+                client->readLength -= client->parsedLength - client->bodyEnd;
+                memmove(client->readBuffer + client->bodyEnd,
+                    client->readBuffer + client->parsedLength,
+                    client->readLength - client->bodyEnd);
+                client->parsedLength = client->bodyEnd;
+                set_client_deadline(client, serverInfo.requestHeaderTimeout);
+            }
+            break;
+        }
+        if (client->spoolRemaining > 0)
+        {
+            bool spooled;
+
+            try
+            {
+                spooled = spool_body(client);
+            }
+            catch (const std::exception &ex)
+            {
+                syslog(LOG_ERR, "(Worker %" PRIu64 ") Failed to spool a "
+                    "request body -> %s", id, ex.what());
+                send_error(client,
+                    HttpResponse::StatusCode::InternalServerError_500);
+                return;
+            }
+            // Not complete yet: either the socket ran dry, or SPOOL_BUDGET
+            // chunks were moved and the other clients of the worker get
+            // their turn before the rest. The socket is watched level-
+            // triggered, so the next event reports what is still waiting
+            // and handle_client() comes back here. Under io_uring the rest
+            // comes with the next completions.
+            if (!spooled)
+            {
+                return;
+            }
+            // details only lasts one pass, and the header was parsed by an
+            // earlier one, so the resource is resolved again
+            if (!resolve_resource(&client->request, &details))
+            {
+                send_error(client, HttpResponse::StatusCode::BadRequest_400);
+                return;
+            }
+        }
+
+        http_parser_pause(&client->parser, 0);
+        client->keepAlive = state == State::Running
+            && serverInfo.keepAliveTimeout > 0
+            && should_keep_alive(&client->parser, &client->request);
+        try
+        {
+            details.respond(&client->request, client);
+        }
+        catch (const UnavailableException &ex)
+        {
+            syslog(LOG_ERR, "(Worker %" PRIu64 ") Failed to respond -> %s",
+                id, ex.what());
+            send_error(client, HttpResponse::StatusCode::ServiceUnavailable_503);
+            return;
+        }
+        catch (const std::exception &ex)
+        {
+            syslog(LOG_ERR, "(Worker %" PRIu64 ") Failed to respond -> %s",
+                id, ex.what());
+            send_error(client,
+                HttpResponse::StatusCode::InternalServerError_500);
+            return;
+        }
+        if (!send_response(client))
+        {
+            // Pipelined requests wait in the read buffer until the response
+            // is out, so responses can neither overtake each other nor pile
+            // up
+            return;
+        }
+        if (!complete_response(client))
+        {
+            return;
         }
     }
-    else
+
+    if (client->readLength == Client::READ_BUFFER_SIZE
+        && client->bodyHandling == Client::BodyHandling::Gather
+        && client->request.body.set)
     {
-        clientHeap = (Client*)realloc(clientHeap,
-            sizeof(Client) * maxNumberOfClients);
-        if (clientHeap == nullptr)
+        // The rest of the body goes to the file, and there is room to
+        // read it again
+        try
         {
-            throw CriticalException("realloc(clientHeap, "
-               + std::to_string(sizeof(Client) * maxNumberOfClients)
-                + ") failed -> " + strerror(errno));
+            spill_body(client);
         }
-
+        catch (const std::exception &ex)
+        {
+            syslog(LOG_ERR, "(Worker %" PRIu64 ") Failed to spool a "
+                "request body -> %s", id, ex.what());
+            send_error(client,
+                HttpResponse::StatusCode::InternalServerError_500);
+        }
+        return;
+    }
+    if (client->readLength == Client::READ_BUFFER_SIZE)
+    {
+        // The header does not fit, or not even the start of the body does
+        send_error(client, client->headersComplete
+            ? HttpResponse::StatusCode::PayloadTooLarge_413
+            : HttpResponse::StatusCode::RequestHeaderFieldsTooLarge_431);
     }
+}
 
-    for (uint64_t i = this->maxNumberOfClients; i < maxNumberOfClients; ++i)
+void awsim::Worker::receive_data(Client *client, const char *data,
+    size_t length)
+{
+    if (!client->waitingForWrite && client->overflowLength == 0)
     {
-        clientHeap[i].allocated = false;
+        size_t taken = std::min(length,
+            Client::READ_BUFFER_SIZE - client->readLength);
+
+        if (client->readLength == 0)
+        {
+            // A new request is starting, from now on the client only has
+            // until the header deadline to send it
+            set_client_deadline(client, serverInfo.requestHeaderTimeout);
+        }
+        memcpy(client->readBuffer + client->readLength, data, taken);
+        client->readLength += taken;
+        data += taken;
+        length -= taken;
     }
-    allocatedList = nullptr;
-    unallocatedList = nullptr;
-    for (uint64_t i = 0; i < maxNumberOfClients; ++i)
+    if (length > 0)
     {
-        Client &client = clientHeap[i];
-        if (client.allocated)
+        if (client->overflowLength + length > client->overflowCapacity)
         {
-            epoll_event event;
+            size_t capacity = client->overflowCapacity == 0
+                ? Client::READ_BUFFER_SIZE : client->overflowCapacity;
+            char *tmp;
 
-            event.events = EPOLLIN;
-            event.data.ptr = &client;
-            if (epoll_ctl(epollfd, EPOLL_CTL_MOD, client.sock, &event) == -1)
+            while (capacity < client->overflowLength + length)
             {
-                throw std::runtime_error("epoll_ctl(" + std::to_string(epollfd)
-                    + ", EPOLL_CTL_MOD, " + std::to_string(client.sock)
-                    + "&event) failed -> " + strerror(errno));
+                capacity *= 2;
             }
-
-            client.next = allocatedList;
-            allocatedList = &client;
-            if (client.next != nullptr)
-            {
-                client.next->prev = &client;
-            }
-        }
-        else
-        {
-            client.next = unallocatedList;
-            unallocatedList = &client;
-            if (client.next != nullptr)
+            tmp = (char*)realloc(client->overflowBuffer, capacity);
+            if (tmp == nullptr)
             {
-                client.next->prev = &client;
+                throw std::runtime_error("realloc(client->overflowBuffer, "
+                    + std::to_string(capacity) + ") failed -> "
+                    + strerror(errno));
             }
+            client->overflowBuffer = tmp;
+            client->overflowCapacity = capacity;
         }
+        memcpy(client->overflowBuffer + client->overflowLength, data, length);
+        client->overflowLength += length;
     }
 
-    if (unallocatedList != nullptr)
+    if (!client->waitingForWrite)
     {
-        unallocatedList->prev = nullptr;
+        process_requests(client);
+        process_overflow(client);
     }
-    if (allocatedList != nullptr)
+}
+
+void awsim::Worker::refresh_routing()
+{
+    const Routing *current;
+
+    // The epoch is recorded before the snapshot is taken, so a worker that
+    // records the new epoch is sure to take the new snapshot as well
+    routingEpoch = serverInfo.routingEpoch.load();
+    current = serverInfo.routing.load();
+    if (routing != nullptr && current->get_epoch() != routingSnapshotEpoch)
     {
-        allocatedList->prev = nullptr;
+        // Cached files are keyed by the root directory descriptors of the
+        // previous domains, which are about to be closed and reused
+        fileCache.clear();
     }
-    this->maxNumberOfClients = maxNumberOfClients;
+    routing = current;
+    routingSnapshotEpoch = current->get_epoch();
 }
 
 void awsim::Worker::remove_client(Client *client)
@@ -697,51 +1559,162 @@ void awsim::Worker::remove_client(Client *client)
     {
         client->prev->next = client->next;
     }
+    else
+    {
+        allocatedList = client->next;
+    }
     if (client->next != nullptr)
     {
         client->next->prev = client->prev;
     }
     client->prev = nullptr;
     client->next = unallocatedList;
+    if (unallocatedList != nullptr)
+    {
+        unallocatedList->prev = client;
+    }
     unallocatedList = client;
     client->allocated = false;
+    if (client->fileFd != -1)
+    {
+        close(client->fileFd);
+    }
+    if (client->request.bodyFd != -1)
+    {
+        close(client->request.bodyFd);
+        client->request.bodyFd = -1;
+    }
+    if (client->bodyHandling == Client::BodyHandling::Stream
+        && !client->requestComplete
+        && client->bodyRoutingEpoch == routingSnapshotEpoch)
+    {
+        // Lets the page know the rest of the body is not coming
+        client->bodyHandler(&client->request, client, nullptr, 0);
+    }
+    timers.cancel(&client->timer);
     _numberOfClients--;
-    close(client->sock);
+    if (usingIoUring)
+    {
+        if (client->sendPending)
+        {
+            // The kernel may still be reading from it
+            orphanedWriteBuffers.emplace(USER_DATA(RingOperation::Send,
+                client->index, client->generation), client->writeBuffer);
+            client->writeBuffer = nullptr;
+            client->writeCapacity = 0;
+        }
+        if (client->splicePipe[0] != -1)
+        {
+            // Might still hold part of the body
+            close(client->splicePipe[0]);
+            close(client->splicePipe[1]);
+        }
+        client->generation = (client->generation + 1) & GENERATION_MASK;
+    }
+    // The next connection in the slot starts out small
+    client->release_write_buffer();
+    close_client_socket(client->sock);
+}
+
+static void remove_fd_from_epoll(int fd, int epollfd)
+{
+    if (epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, nullptr) == -1)
+    {
+        throw std::runtime_error("epoll_ctl(" + std::to_string(epollfd)
+            + ", EPOLL_CTL_DEL, " + std::to_string(fd) + ", nullptr) failed -> "
+            + strerror(errno));
+    }
+}
+
+static ssize_t read_fd(int fd, void *buffer, size_t length)
+{
+    ssize_t result;
+
+    result = read(fd, buffer, length);
+    if (result == -1)
+    {
+        throw std::runtime_error("read(" + std::to_string(fd) + ", buffer, "
+            + std::to_string(length) + ") failed -> " + strerror(errno));
+    }
+    return result;
+}
+
+void awsim::Worker::remove_http_socket(int sock)
+{
+    for (auto it = httpSockets.begin(); it != httpSockets.end(); ++it)
+    {
+        if (*it == sock)
+        {
+            httpSockets.erase(it);
+            if (usingIoUring)
+            {
+                io_uring_sqe *sqe = ring.get_sqe();
+
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->addr = USER_DATA(RingOperation::Accept, sock, 0);
+                sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+                sqe->user_data = USER_DATA(RingOperation::Cancel, 0, 0);
+                return;
+            }
+            try
+            {
+                remove_fd_from_epoll(sock, epollfd);
+            }
+            catch (const std::exception &ex)
+            {
+                throw std::runtime_error(
+                    std::string("Failed to remove HTTP socket from epoll -> ")
+                    + ex.what());
+            }
+            return;
+        }
+    }
 }
 
-static void remove_fd_from_epoll(int fd, int epollfd)
+void awsim::Worker::remove_remote_host_sockets()
 {
-    if (epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, nullptr) == -1)
+    // Only this worker stops polling them, the server hands them to another
+    // worker so connections waiting in their queues are not lost
+    while (!httpSockets.empty())
     {
-        throw std::runtime_error("epoll_ctl(" + std::to_string(epollfd)
-            + ", EPOLL_CTL_DEL, " + std::to_string(fd) + ", nullptr) failed -> "
-            + strerror(errno));
+        remove_http_socket(httpSockets.back());
     }
 }
 
-static ssize_t read_fd(int fd, void *buffer, size_t length)
+void awsim::Worker::request_add_http_socket(int sock)
 {
-    ssize_t result;
+    char buffer[sizeof(uint16_t) + sizeof(int)];
 
-    result = read(fd, buffer, length);
-    if (result == -1)
+    INSERT_FLAG(WorkerAndServerFlags::ToWorkerFlags::AddHttpSocketRequest,
+        buffer);
+    memcpy(buffer + sizeof(uint16_t), &sock, sizeof(sock));
+    try
     {
-        throw std::runtime_error("read(" + std::to_string(fd) + ", buffer, "
-            + std::to_string(length) + ") failed -> " + strerror(errno));
+        write_to_pipe(buffer, sizeof(buffer));
+    }
+    catch (const std::exception &ex)
+    {
+        throw std::runtime_error(
+            std::string("Failed to request worker to add HTTP socket -> ")
+            + ex.what());
     }
-    return result;
 }
 
-void awsim::Worker::remove_remote_host_sockets()
+void awsim::Worker::request_remove_http_socket(int sock)
 {
+    char buffer[sizeof(uint16_t) + sizeof(int)];
+
+    INSERT_FLAG(WorkerAndServerFlags::ToWorkerFlags::RemoveHttpSocketRequest,
+        buffer);
+    memcpy(buffer + sizeof(uint16_t), &sock, sizeof(sock));
     try
     {
-        remove_fd_from_epoll(serverInfo.httpSocket, epollfd);
+        write_to_pipe(buffer, sizeof(buffer));
     }
     catch (const std::exception &ex)
     {
         throw std::runtime_error(
-            std::string("Failed to remove HTTP socket from epoll -> ")
+            std::string("Failed to request worker to remove HTTP socket -> ")
             + ex.what());
     }
 }
@@ -776,14 +1749,57 @@ void awsim::Worker::request_weak_stop()
 }
 
 void awsim::Worker::routine_loop()
+{
+    state = State::Running;
+    now = get_tick();
+    timers.clear(now);
+    if (usingIoUring)
+    {
+        routine_loop_io_uring();
+    }
+    else
+    {
+        routine_loop_epoll();
+    }
+
+    if (state == State::WeakStopped)
+    {
+        #ifdef AWSIM_DEBUG
+            syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Weak stop completed", id);
+        #endif
+        // Nothing will be sent on the pipe anymore, the server only joins
+        // the thread once it has been notified
+        stop();
+        try
+        {
+            notify_server(WorkerAndServerFlags::ToServerFlags::WeakStopCompleted);
+        }
+        catch (const std::exception &ex)
+        {
+            throw std::runtime_error(
+                std::string("Failed to notify main thread of weak stop -> ")
+                + ex.what());
+        }
+    }
+}
+
+void awsim::Worker::routine_loop_epoll()
 {
     epoll_event events[NUMBER_OF_EPOLL_EVENTS];
+    uint64_t busySince = get_nanoseconds();
 
-    state = State::Running;
     while (IS_IN_ACTIVE_STATE(state))
     {
-        int nfds = epoll_wait(epollfd, events, NUMBER_OF_EPOLL_EVENTS, -1);
-
+        int64_t ticks = timers.get_ticks_until_next_expiry();
+        int timeout = ticks == -1 ? -1
+            : (int)(ticks * TIMER_TICK_MILLISECONDS);
+        uint64_t waitStart = get_nanoseconds();
+        uint64_t waitEnd;
+        int nfds;
+
+        routingEpoch = QUIESCENT_ROUTING_EPOCH;
+        nfds = epoll_wait(epollfd, events, NUMBER_OF_EPOLL_EVENTS, timeout);
+        refresh_routing();
         if (nfds == -1)
         {
             if (errno == EINTR)
@@ -792,9 +1808,16 @@ void awsim::Worker::routine_loop()
             }
             throw std::runtime_error("epoll_wait(" + std::to_string(epollfd)
                 + ", events, "
-                + std::to_string(NUMBER_OF_EPOLL_EVENTS) + ", -1) failed -> "
+                + std::to_string(NUMBER_OF_EPOLL_EVENTS) + ", "
+                + std::to_string(timeout) + ") failed -> "
                 + strerror(errno));
         }
+        now = get_tick();
+        // The compression level follows the share of time spent outside of
+        // the wait
+        waitEnd = get_nanoseconds();
+        compressor.record_load(waitStart - busySince, waitEnd - waitStart);
+        busySince = waitEnd;
         for (int i = 0; IS_IN_ACTIVE_STATE(state) && i < nfds; ++i)
         {
             epoll_event &event = events[i];
@@ -825,9 +1848,22 @@ void awsim::Worker::routine_loop()
             else
             {
                 Client *client = (Client*)event.data.ptr;
+
+                if (!client->allocated)
+                {
+                    // Removed while handling an earlier event of this batch
+                    continue;
+                }
                 try
                 {
-                    handle_client(client);
+                    if (client->waitingForWrite)
+                    {
+                        handle_client_output(client);
+                    }
+                    else
+                    {
+                        handle_client(client);
+                    }
                 }
                 catch (const std::exception &ex)
                 {
@@ -838,28 +1874,174 @@ void awsim::Worker::routine_loop()
                 }
             }
         }
+        expire_clients();
+        if (state == State::WeakStopPending && _numberOfClients == 0)
+        {
+            state = State::WeakStopped;
+        }
     }
+}
+
+void awsim::Worker::routine_loop_io_uring()
+{
+    int clientSockets[ACCEPT_BUDGET];
+    uint64_t busySince = get_nanoseconds();
 
-    if (state == State::WeakStopPending)
+    arm_server_pipe();
+    for (int httpSocket : httpSockets)
     {
-        uint16_t flag = (uint16_t)WorkerAndServerFlags::ToServerFlags::WeakStopCompleted;
+        arm_accept(httpSocket);
+    }
+    while (IS_IN_ACTIVE_STATE(state))
+    {
+        int64_t ticks = timers.get_ticks_until_next_expiry();
+        int timeout = ticks == -1 ? -1
+            : (int)(ticks * TIMER_TICK_MILLISECONDS);
+        io_uring_cqe *entry;
+        uint64_t count = 0;
+        uint64_t waitStart = get_nanoseconds();
+        uint64_t waitEnd;
+
+        // Everything queued while handling the last batch goes out with the
+        // wait, a busy worker makes a single syscall per batch
+        routingEpoch = QUIESCENT_ROUTING_EPOCH;
+        ring.submit_and_wait(timeout);
+        refresh_routing();
+        now = get_tick();
+        waitEnd = get_nanoseconds();
+        compressor.record_load(waitStart - busySince, waitEnd - waitStart);
+        busySince = waitEnd;
+        while (IS_IN_ACTIVE_STATE(state) && (entry = ring.peek()) != nullptr)
+        {
+            // Copied out, stopping unmaps the ring
+            io_uring_cqe cqe = *entry;
 
-        #ifdef AWSIM_DEBUG
-            syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Weak stop completed", id);
-        #endif
-        try
+            ring.advance();
+            switch (USER_DATA_OPERATION(cqe.user_data))
+            {
+                case RingOperation::Accept:
+                {
+                    int sock = (int)USER_DATA_INDEX(cqe.user_data);
+
+                    if (cqe.res >= 0)
+                    {
+                        clientSockets[count++] = cqe.res;
+                        if (count == ACCEPT_BUDGET)
+                        {
+                            add_accepted_clients(clientSockets, count, true);
+                            count = 0;
+                        }
+                    }
+                    else if (cqe.res == -ECANCELED)
+                    {
+                        // The socket was handed on
+                        break;
+                    }
+                    else if (cqe.res != -ECONNABORTED && cqe.res != -ENFILE
+                        && cqe.res != -EMFILE && cqe.res != -ENOBUFS
+                        && cqe.res != -ENOMEM)
+                    {
+                        throw std::runtime_error("Multishot accept on "
+                            + std::to_string(sock) + " failed -> "
+                            + strerror(-cqe.res));
+                    }
+                    else
+                    {
+                        syslog(LOG_ERR, "(Worker %" PRIu64 ") Failed to accept "
+                            "HTTP client -> %s", id, strerror(-cqe.res));
+                    }
+                    // Errors (like a full table of direct descriptors) end
+                    // a multishot accept
+                    if (!(cqe.flags & IORING_CQE_F_MORE)
+                        && std::find(httpSockets.begin(), httpSockets.end(),
+                        sock) != httpSockets.end())
+                    {
+                        arm_accept(sock);
+                    }
+                    break;
+                }
+                case RingOperation::ServerPipe:
+                    if (cqe.res < 0)
+                    {
+                        throw std::runtime_error(
+                            std::string("Polling the server pipe failed -> ")
+                            + strerror(-cqe.res));
+                    }
+                    handle_server_pipe();
+                    if (IS_IN_ACTIVE_STATE(state)
+                        && !(cqe.flags & IORING_CQE_F_MORE))
+                    {
+                        arm_server_pipe();
+                    }
+                    break;
+                case RingOperation::ReadBody:
+                case RingOperation::Receive:
+                case RingOperation::Send:
+                case RingOperation::SpliceIn:
+                case RingOperation::SpliceOut:
+                    try
+                    {
+                        if (USER_DATA_OPERATION(cqe.user_data)
+                            == RingOperation::Receive)
+                        {
+                            handle_receive_completion(cqe);
+                        }
+                        else
+                        {
+                            handle_output_completion(cqe);
+                        }
+                    }
+                    catch (const std::exception &ex)
+                    {
+                        Client *client = get_client(cqe.user_data);
+
+                        if (client != nullptr)
+                        {
+                            remove_client(client);
+                        }
+                        syslog(LOG_ERR,
+                            "(Worker %" PRIu64 ") Failed to handle client -> %s",
+                            id, ex.what());
+                    }
+                    break;
+                default:
+                    // Only failed cancels, closes and polls complete. Either
+                    // the slot is gone, or the operation linked behind the
+                    // poll reports the failure.
+                    #ifdef AWSIM_DEBUG
+                        syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Operation "
+                            "%d completed with %d", id,
+                            (int)USER_DATA_OPERATION(cqe.user_data), cqe.res);
+                    #endif
+                    break;
+            }
+        }
+        if (!IS_IN_ACTIVE_STATE(state))
         {
-            write_to_server(&flag, sizeof(flag));
+            break;
         }
-        catch (const std::exception &ex)
+        if (count > 0)
         {
-            throw std::runtime_error(
-                std::string("Failed to notify main thread of weak stop -> ")
-                + ex.what());
+            add_accepted_clients(clientSockets, count, false);
+        }
+        expire_clients();
+        if (state == State::WeakStopPending && _numberOfClients == 0)
+        {
+            state = State::WeakStopped;
         }
     }
 }
 
+void awsim::Worker::notify_server(WorkerAndServerFlags::ToServerFlags flag)
+{
+    WorkerAndServerFlags::ToServerHeader header;
+
+    memset(&header, 0, sizeof(header));
+    header.workerID = id;
+    header.flag = flag;
+    write_to_server(&header, sizeof(header));
+}
+
 void awsim::Worker::write_to_server(void *buffer, size_t length)
 {
     if (write(serverInfo.workersWritefd, buffer, length) == -1)
@@ -872,62 +2054,438 @@ void awsim::Worker::write_to_server(void *buffer, size_t length)
 
 void awsim::Worker::routine_start(Worker &worker)
 {
+    worker.usingIoUring = false;
     try
     {
         create_pipe(&worker.serverReadfd, &worker.serverWritefd);
     }
     catch (const std::exception &ex)
     {
-        worker.state = State::Crashed;
         syslog(LOG_ALERT,
             "(Worker %" PRIu64 ") Crashed -> Failed to create a pipe -> %s",
             worker.id, ex.what());
+        worker.crash();
         return;
     }
 
-    try
+    if (worker.serverInfo.eventLoop == Config::EventLoop::IoUring)
     {
-        worker.epollfd = ::create_epoll(worker.serverInfo.httpSocket,
-            worker.serverReadfd);
+        rlimit limit;
+        uint64_t fixedFiles = IO_URING_MAX_FIXED_FILES;
+
+        // Registering more files than RLIMIT_NOFILE allows fails
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0
+            && limit.rlim_cur < fixedFiles)
+        {
+            fixedFiles = limit.rlim_cur;
+        }
+        try
+        {
+            worker.ring.init(IO_URING_ENTRIES, IO_URING_COMPLETION_ENTRIES,
+                fixedFiles, IO_URING_BUFFER_COUNT, IO_URING_BUFFER_SIZE);
+            worker.usingIoUring = true;
+            worker.epollfd = -1;
+        }
+        catch (const std::exception &ex)
+        {
+            syslog(LOG_WARNING, "(Worker %" PRIu64 ") Falling back to epoll "
+                "-> Failed to set up an io_uring -> %s", worker.id, ex.what());
+        }
     }
-    catch (const std::exception &ex)
+
+    if (!worker.usingIoUring)
     {
-        worker.state = State::Crashed;
-        syslog(LOG_ALERT,
-            "(Worker %" PRIu64 ") Crashed -> Failed to setup an epoll -> %s",
-            worker.id, ex.what());
-        return;
+        try
+        {
+            worker.epollfd = ::create_epoll(worker.httpSockets[0],
+                worker.serverReadfd);
+        }
+        catch (const std::exception &ex)
+        {
+            syslog(LOG_ALERT,
+                "(Worker %" PRIu64 ") Crashed -> Failed to setup an epoll -> %s",
+                worker.id, ex.what());
+            worker.crash();
+            return;
+        }
     }
 
     worker.allocatedList = nullptr;
+    worker.routing = nullptr;
+    worker.routingSnapshotEpoch = 0;
+    worker.spoolPipe[0] = -1;
+    worker.spoolPipe[1] = -1;
     worker.unallocatedList = nullptr;
     worker.maxNumberOfClients = 0;
-    worker.clientHeap = nullptr;
+    worker._numberOfClients = 0;
+    worker.acceptStats = AcceptStats();
+    worker.clientChunks.clear();
+    worker.fileCache.init(worker.serverInfo.fileCacheEntries,
+        worker.serverInfo.fileCacheTtl, worker.serverInfo.fileCacheMemory,
+        worker.serverInfo.minimumSizeOfLargeFiles);
+    worker.compressor.init();
 
     try
     {
-        worker.increase_max_number_of_clients(INITIAL_MAX_NUMBER_OF_CLIENTS);
+        worker.add_client_chunk();
     }
     catch (const std::exception &ex)
     {
-        worker.state = State::Crashed;
         syslog(LOG_ALERT, "(Worker %" PRIu64 ") Crashed -> Failed increase "
             "max number of clients -> %s", worker.id, ex.what());
+        worker.crash();
         return;
     }
 
-    http_parser_init(&worker.httpParser, HTTP_REQUEST);
-
     try
     {
         worker.routine_loop();
     }
     catch (const std::exception &ex)
     {
-        worker.state = State::Crashed;
         syslog(LOG_ALERT, "(Worker %" PRIu64 ") Crashed -> %s", worker.id,
             ex.what());
+        worker.routingEpoch = QUIESCENT_ROUTING_EPOCH;
+        worker.crash();
+        return;
+    }
+    worker.routingEpoch = QUIESCENT_ROUTING_EPOCH;
+}
+
+void awsim::Worker::send_error(Client *client,
+    HttpResponse::StatusCode statusCode)
+{
+    const std::string &response = serverInfo.errorResponses.get(statusCode,
+        false);
+
+    // Whatever follows in the read buffer cannot be trusted to be the start
+    // of the next request
+    client->keepAlive = false;
+    client->discard_output();
+    client->queue(response.data(), response.size());
+    if (send_response(client))
+    {
+        complete_response(client);
+    }
+}
+
+void awsim::Worker::send_queued_output(Client *client)
+{
+    uint64_t index = client->index;
+    io_uring_sqe *sqe;
+    size_t length;
+    bool readBody;
+    bool spliceBody;
+
+    client->waitingForWrite = true;
+
+    // Small bodies (or the tail of a large one) are read in behind the
+    // header and go out with it in a single send. Reads from the page cache
+    // complete inline, while every splice takes a trip through the kernel's
+    // worker threads.
+    readBody = client->fileRemaining > 0 && client->pipeLength == 0
+        && client->fileRemaining <= IO_URING_READ_BODY_LIMIT;
+    length = client->writeLength - client->writeOffset;
+    if (readBody)
+    {
+        client->reserve(client->fileRemaining);
+        sqe = ring.get_sqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = client->fileFd;
+        sqe->off = client->fileOffset;
+        sqe->addr = (uint64_t)(uintptr_t)(client->writeBuffer
+            + client->writeLength);
+        sqe->len = client->fileRemaining;
+        // A short read fails the link, the send is cancelled
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = USER_DATA(RingOperation::ReadBody, index,
+            client->generation);
+        client->pendingOutputs++;
+        length += client->fileRemaining;
+    }
+    spliceBody = !readBody
+        && (client->fileRemaining > 0 || client->pipeLength > 0);
+
+    if (length > 0)
+    {
+        sqe = ring.get_sqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = client->sock;
+        sqe->flags = IOSQE_FIXED_FILE;
+        sqe->addr = (uint64_t)(uintptr_t)(client->writeBuffer
+            + client->writeOffset);
+        sqe->len = length;
+        // A short send would not fail the link, and the body would go out
+        // in the middle of the header
+        sqe->msg_flags = MSG_NOSIGNAL
+            | (spliceBody ? MSG_MORE | MSG_WAITALL : 0);
+        sqe->user_data = USER_DATA(RingOperation::Send, index,
+            client->generation);
+        client->pendingOutputs++;
+        client->sendPending = true;
+        if (spliceBody)
+        {
+            sqe->flags |= IOSQE_IO_LINK;
+        }
+    }
+    if (!spliceBody)
+    {
+        return;
+    }
+
+    if (client->pipeLength == 0)
+    {
+        // Larger bodies are spliced from the file into a pipe and from the
+        // pipe into the socket, a chunk at a time. A short splice into the
+        // pipe (the file shrank) cancels the splice out of it.
+        if (client->splicePipe[0] == -1)
+        {
+            if (!sparePipes.empty())
+            {
+                client->splicePipe[0] = sparePipes.back().first;
+                client->splicePipe[1] = sparePipes.back().second;
+                sparePipes.pop_back();
+            }
+            else if (pipe2(client->splicePipe, O_CLOEXEC) == -1)
+            {
+                client->splicePipe[0] = -1;
+                client->splicePipe[1] = -1;
+                throw std::runtime_error(std::string("pipe2(splicePipe, "
+                    "O_CLOEXEC) failed -> ") + strerror(errno));
+            }
+        }
+        length = std::min(client->fileRemaining, (size_t)SPLICE_CHUNK_SIZE);
+
+        sqe = ring.get_sqe();
+        sqe->opcode = IORING_OP_SPLICE;
+        sqe->fd = client->splicePipe[1];
+        sqe->off = (uint64_t)-1;
+        sqe->splice_fd_in = client->fileFd;
+        sqe->splice_off_in = client->fileOffset;
+        sqe->len = length;
+        sqe->splice_flags = SPLICE_F_MOVE;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = USER_DATA(RingOperation::SpliceIn, index,
+            client->generation);
+        client->pendingOutputs++;
+    }
+    else
+    {
+        length = client->pipeLength;
+    }
+
+    // The splice into the socket only runs once the socket is writable. On
+    // the non-blocking socket it then takes what fits and never parks a
+    // kernel worker thread, which could not be cancelled if the client is
+    // removed.
+    sqe = ring.get_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = client->sock;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK | IOSQE_CQE_SKIP_SUCCESS;
+    sqe->poll32_events = POLLOUT;
+    sqe->user_data = USER_DATA(RingOperation::PollOut, index,
+        client->generation);
+
+    sqe = ring.get_sqe();
+    sqe->opcode = IORING_OP_SPLICE;
+    sqe->fd = client->sock;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->off = (uint64_t)-1;
+    sqe->splice_fd_in = client->splicePipe[0];
+    sqe->splice_off_in = (uint64_t)-1;
+    sqe->len = length;
+    sqe->splice_flags = SPLICE_F_MOVE | (client->fileRemaining > length
+        ? SPLICE_F_MORE : 0);
+    sqe->user_data = USER_DATA(RingOperation::SpliceOut, index,
+        client->generation);
+    client->pendingOutputs++;
+}
+
+bool awsim::Worker::send_response(Client *client)
+{
+    if (usingIoUring)
+    {
+        // Everything goes through the ring, the client carries on once the
+        // completions are in
+        send_queued_output(client);
+        set_client_deadline(client, serverInfo.writeTimeout);
+        return false;
+    }
+    if (!client->flush())
+    {
+        set_client_events(client, true);
+        set_client_deadline(client, serverInfo.writeTimeout);
+        return false;
+    }
+    return true;
+}
+
+void awsim::Worker::set_client_deadline(Client *client, uint64_t seconds)
+{
+    timers.schedule(&client->timer,
+        now + seconds * 1000 / TIMER_TICK_MILLISECONDS);
+}
+
+void awsim::Worker::set_client_events(Client *client, bool waitForWrite)
+{
+    epoll_event event;
+
+    if (client->waitingForWrite == waitForWrite)
+    {
+        return;
+    }
+    event.events = waitForWrite ? EPOLLOUT : EPOLLIN;
+    event.data.ptr = client;
+    if (epoll_ctl(epollfd, EPOLL_CTL_MOD, client->sock, &event) == -1)
+    {
+        throw std::runtime_error("epoll_ctl(" + std::to_string(epollfd)
+            + ", EPOLL_CTL_MOD, " + std::to_string(client->sock)
+            + ", &event) failed -> " + strerror(errno));
+    }
+    client->waitingForWrite = waitForWrite;
+}
+
+static bool should_keep_alive(const awsim::HttpParser *parser,
+    const awsim::HttpRequest *request)
+{
+    const awsim::HttpRequest::Value &connection =
+        request->get_field(awsim::HttpRequest::Field::Connection);
+
+    if (parser->upgrade)
+    {
+        return false;
+    }
+    if (connection.set)
+    {
+        if (has_token(connection, "close"))
+        {
+            return false;
+        }
+        if (has_token(connection, "keep-alive"))
+        {
+            return true;
+        }
+    }
+    // Persistent connections are the default from HTTP/1.1 on
+    return parser->http_major > 1
+        || (parser->http_major == 1 && parser->http_minor >= 1);
+}
+
+void awsim::Worker::spill_body(Client *client)
+{
+    HttpRequest &request = client->request;
+    size_t start = request.body.buffer - client->readBuffer;
+
+    request.bodyFd = open_body_file(serverInfo.spoolDirectoryFd);
+    write_body(request.bodyFd, request.body.buffer, request.body.length, 0);
+    // Whatever was read past the body moves down behind the header
+    client->readLength -= client->bodyEnd - start;
+    client->parsedLength -= client->bodyEnd - start;
+    memmove(client->readBuffer + start, client->readBuffer + client->bodyEnd,
+        client->readLength - start);
+    client->bodyEnd = start;
+    request.body = HttpRequest::Value();
+    client->bodyHandling = Client::BodyHandling::SpoolParsed;
+}
+
+bool awsim::Worker::spool_body(Client *client)
+{
+    HttpRequest &request = client->request;
+    size_t length = std::min((uint64_t)(client->readLength
+        - client->parsedLength), client->spoolRemaining);
+    uint64_t budget = SPOOL_BUDGET;
+
+    if (request.bodyFd == -1)
+    {
+        request.bodyFd = open_body_file(serverInfo.spoolDirectoryFd);
+    }
+
+    // Whatever was read along with the header, or received by the ring,
+    // which lands everything in memory anyway. Taken out of readBuffer so
+    // that it only ever holds the header and what follows the body.
+    if (length > 0)
+    {
+        const char *data = client->readBuffer + client->parsedLength;
+
+        write_body(request.bodyFd, data, length, client->bodyLength);
+        client->readLength -= length;
+        memmove(client->readBuffer + client->parsedLength, data + length,
+            client->readLength - client->parsedLength);
+        client->bodyLength += length;
+        client->spoolRemaining -= length;
+        set_client_deadline(client, serverInfo.requestHeaderTimeout);
+    }
+    if (client->spoolRemaining == 0 || usingIoUring)
+    {
+        return client->spoolRemaining == 0;
+    }
+
+    // The rest goes from the socket into the pipe and from the pipe into
+    // the file without passing through user memory. The socket is non-
+    // blocking, the file is written to like any other.
+    if (spoolPipe[0] == -1 && pipe2(spoolPipe, O_CLOEXEC) == -1)
+    {
+        spoolPipe[0] = -1;
+        spoolPipe[1] = -1;
+        throw std::runtime_error(std::string("pipe2(spoolPipe, O_CLOEXEC) "
+            "failed -> ") + strerror(errno));
     }
+    while (client->spoolRemaining > 0 && budget-- > 0)
+    {
+        loff_t offset = client->bodyLength;
+        ssize_t spliced = splice(client->sock, nullptr, spoolPipe[1], nullptr,
+            std::min(client->spoolRemaining, (uint64_t)SPLICE_CHUNK_SIZE),
+            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        ssize_t drained = 0;
+
+        if (spliced == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return false;
+            }
+            throw std::runtime_error("splice(" + std::to_string(client->sock)
+                + ", nullptr, " + std::to_string(spoolPipe[1])
+                + ", nullptr, " + std::to_string(std::min(
+                client->spoolRemaining, (uint64_t)SPLICE_CHUNK_SIZE))
+                + ", SPLICE_F_MOVE | SPLICE_F_NONBLOCK) failed -> "
+                + strerror(errno));
+        }
+        if (spliced == 0)
+        {
+            #ifdef AWSIM_DEBUG
+                syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Client disconnected "
+                    "during upload", id);
+            #endif
+            remove_client(client);
+            return false;
+        }
+        while (drained < spliced)
+        {
+            ssize_t result = splice(spoolPipe[0], nullptr, request.bodyFd,
+                &offset, spliced - drained, SPLICE_F_MOVE);
+
+            if (result <= 0)
+            {
+                int error = result == 0 ? EIO : errno;
+
+                // Whatever is left in the pipe would end up in the next file
+                close(spoolPipe[0]);
+                close(spoolPipe[1]);
+                spoolPipe[0] = -1;
+                spoolPipe[1] = -1;
+                throw std::runtime_error("splice(pipe, nullptr, "
+                    + std::to_string(request.bodyFd) + ", &offset, "
+                    + std::to_string(spliced - drained) + ", SPLICE_F_MOVE) "
+                    "failed -> " + strerror(error));
+            }
+            drained += result;
+        }
+        client->bodyLength += spliced;
+        client->spoolRemaining -= spliced;
+        set_client_deadline(client, serverInfo.requestHeaderTimeout);
+    }
+    return client->spoolRemaining == 0;
 }
 
 void awsim::Worker::stop()
@@ -935,48 +2493,119 @@ void awsim::Worker::stop()
     #ifdef AWSIM_DEBUG
         syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Stopping", id);
     #endif
-    Client *client;
 
-    client = allocatedList;
-    while (client != nullptr)
+    syslog(LOG_INFO, "(Worker %" PRIu64 ") Accepted %s", id,
+        acceptStats.to_string().c_str());
+    syslog(LOG_INFO, "(Worker %" PRIu64 ") File cache: %s", id,
+        fileCache.get_stats().to_string().c_str());
+    if (serverInfo.compression)
     {
-        client->~Client();
-        client = client->next;
+        syslog(LOG_INFO, "(Worker %" PRIu64 ") Compression: %s", id,
+            compressor.get_stats().to_string().c_str());
     }
-    if (clientHeap != nullptr)
+
+    // Every slot was constructed by add_client_chunk(), allocated or not
+    for (Client *chunk : clientChunks)
     {
-        free(clientHeap);
+        for (uint64_t i = 0; i < CLIENT_CHUNK_SIZE; ++i)
+        {
+            free(chunk[i].readBuffer);
+            free(chunk[i].writeBuffer);
+            free(chunk[i].overflowBuffer);
+            chunk[i].~Client();
+        }
+        free(chunk);
     }
+    clientChunks.clear();
     allocatedList = nullptr;
     unallocatedList = nullptr;
+    maxNumberOfClients = 0;
     _numberOfClients = 0;
+    // The timers were linked through the slab
+    timers.clear(now);
+    fileCache.clear();
+    compressor.clear();
 
-    close(epollfd);
+    if (usingIoUring)
+    {
+        ring.deinit();
+        for (auto &buffer : orphanedWriteBuffers)
+        {
+            free(buffer.second);
+        }
+        orphanedWriteBuffers.clear();
+        for (auto &spare : sparePipes)
+        {
+            close(spare.first);
+            close(spare.second);
+        }
+        sparePipes.clear();
+    }
+    else
+    {
+        close(epollfd);
+        if (spoolPipe[0] != -1)
+        {
+            close(spoolPipe[0]);
+            close(spoolPipe[1]);
+        }
+    }
     close(serverWritefd);
     close(serverReadfd);
 
     state = State::Stopped;
 }
 
+void awsim::Worker::update_receive(Client *client)
+{
+    // Data piling up behind a slow response is not taken in without bounds,
+    // the socket's receive buffer pushes back on the peer instead
+    bool wanted = client->overflowLength < Client::READ_BUFFER_SIZE;
+
+    if (wanted && !client->receiving)
+    {
+        arm_receive(client);
+    }
+    else if (!wanted && client->receiving && !client->receiveCancelled)
+    {
+        cancel_receive(client);
+    }
+}
+
 void awsim::Worker::weak_stop()
 {
     #ifdef AWSIM_DEBUG
         syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Weak stopping", id);
     #endif
+    Client *client;
+
     remove_remote_host_sockets();
-    if (_numberOfClients == 0)
-    {
-        state = State::WeakStopped;
-    }
-    else
+
+    // Connections that are between requests would only be waiting for their
+    // keep alive to run out. Fresh connections still get their first request
+    // answered.
+    client = allocatedList;
+    while (client != nullptr)
     {
-        state = State::WeakStopPending;
+        Client *next = client->next;
+
+        if (client->readLength == 0 && client->requestsServed > 0)
+        {
+            remove_client(client);
+        }
+        client = next;
     }
+
+    // The loop finishes the weak stop once the last client is gone
+    state = State::WeakStopPending;
 }
 
-awsim::Worker::Worker(uint64_t id, ServerInfo &serverInfo) :
+awsim::Worker::Worker(uint64_t id, ServerInfo &serverInfo, int httpSocket) :
+    routingEpoch(QUIESCENT_ROUTING_EPOCH),
     numberOfClients(0),
-    id(id), // order matters, this should be set before the thread begins
+    weakStopRequested(false),
+    httpSockets{httpSocket}, // these should be set before the thread begins
+    id(id),
     serverInfo(serverInfo),
     thread(&routine_start, std::ref(*this))
 {
@@ -990,10 +2619,35 @@ awsim::Worker::~Worker()
     #ifdef AWSIM_DEBUG
         syslog(LOG_DEBUG, "(Worker %" PRIu64 ") Ending", id);
     #endif
-    request_stop();
+    // A crashed worker reads its pipe no more
+    if (state != State::Stopped && state != State::Crashed)
+    {
+        request_stop();
+    }
     thread.join();
 }
 
+static void write_body(int fd, const char *data, size_t length,
+    uint64_t offset)
+{
+    size_t written = 0;
+
+    while (written < length)
+    {
+        ssize_t result = pwrite(fd, data + written, length - written,
+            offset + written);
+
+        if (result == -1)
+        {
+            throw std::runtime_error("pwrite(" + std::to_string(fd)
+                + ", data, " + std::to_string(length - written) + ", "
+                + std::to_string(offset + written) + ") failed -> "
+                + strerror(errno));
+        }
+        written += result;
+    }
+}
+
 void awsim::Worker::write_to_pipe(void *buffer, size_t length)
 {
     if (write(serverWritefd, buffer, length) == -1)
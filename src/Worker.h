@@ -3,21 +3,36 @@
 
 #include <atomic>
 #include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <new>
+#include <poll.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/epoll.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <thread>
+#include <time.h>
 #include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <sys/sendfile.h>
 
 #include "Client.h"
+#include "Compressor.h"
 #include "CriticalException.h"
+#include "FileCache.h"
 #include "HttpParser.h"
 #include "HttpRequest.h"
 #include "HttpResponse.h"
+#include "IoUring.h"
 #include "ParserDetails.h"
 #include "ServerInfo.h"
+#include "TimerWheel.h"
+#include "UnavailableException.h"
 #include "WorkerAndServerFlags.h"
 
 namespace awsim
@@ -25,10 +40,25 @@ namespace awsim
     class Worker
     {
     public:
-        static const uint64_t HTTP_HEADER_BUFFER_SIZE = 8192;
-        static const uint64_t INITIAL_MAX_NUMBER_OF_CLIENTS = 128;
+        static const uint64_t ACCEPT_BUDGET = 64;
+        // Clients per chunk of the slab, a power of 2
+        static const uint64_t CLIENT_CHUNK_SIZE = 128;
+        static const uint64_t IO_URING_BUFFER_COUNT = 1024;
+        static const uint64_t IO_URING_BUFFER_SIZE = 4096;
+        static const uint64_t IO_URING_COMPLETION_ENTRIES = 16384;
+        static const uint64_t IO_URING_ENTRIES = 2048;
+        static const uint64_t IO_URING_MAX_FIXED_FILES = 65536;
+        static const uint64_t IO_URING_READ_BODY_LIMIT = 16384;
         static const uint64_t MAX_NUMBER_OF_EPOLL_EVENTS = 8192;
+        static const int NOT_SENT_LOW_WATERMARK = 16384;
+        // routingEpoch of a worker that is waiting for events
+        static const uint64_t QUIESCENT_ROUTING_EPOCH = UINT64_MAX;
         static const uint64_t SERVER_PIPE_BUFFER_SIZE = 512;
+        static const uint64_t SPLICE_CHUNK_SIZE = 65536;
+        // Chunks of a spooled body moved per event, so one upload does not
+        // hold up the other clients of the worker
+        static const uint64_t SPOOL_BUDGET = 16;
+        static const uint64_t TIMER_TICK_MILLISECONDS = 10;
 
         static HttpParserSettings httpParserSettings;
 
@@ -43,28 +73,96 @@ namespace awsim
 
         // Used by both threads
         std::atomic<State> state;
+        // The epoch of ServerInfo the worker saw before it took the routing
+        // snapshot it uses, see Routing
+        std::atomic<uint64_t> routingEpoch;
 
         // Used by server thread
         uint64_t numberOfClients;
+        bool weakStopRequested;
 
+        void request_add_http_socket(int sock);
+        void request_remove_http_socket(int sock);
         void request_weak_stop();
         uint64_t get_number_of_clients();
 
-        Worker(uint64_t id, ServerInfo &serverInfo);
+        Worker(uint64_t id, ServerInfo &serverInfo, int httpSocket);
         ~Worker();
 
     private:
+        // Sizes of the batches of connections taken per wakeup of the
+        // listening sockets, logged when the worker stops
+        struct AcceptStats
+        {
+            // Batches of 1, 2-3, 4-7, ... up to the budget
+            static const uint64_t BUCKETS = 7;
+
+            uint64_t batches;
+            uint64_t budgetExhausted;
+            uint64_t clients;
+            uint64_t emptyBatches;
+            uint64_t histogram[BUCKETS];
+            uint64_t largestBatch;
+
+            void record(uint64_t size, bool exhausted);
+            std::string to_string() const;
+        };
+
+        // What a completion of the io_uring backend belongs to, kept in the
+        // low byte of its user data
+        enum class RingOperation : uint8_t
+        {
+            Accept,
+            Cancel,
+            Close,
+            PollOut,
+            ReadBody,
+            Receive,
+            Send,
+            ServerPipe,
+            SpliceIn,
+            SpliceOut
+        };
+
         // Used by worker thread
+        AcceptStats acceptStats;
         Client *allocatedList;
+        // Slab of clients, grown a chunk at a time. Chunks are never moved or
+        // freed before the worker stops.
+        std::vector<Client*> clientChunks;
+        // Compresses response bodies on the fly, see Compressor
+        Compressor compressor;
         int epollfd;
-        Client *clientHeap;
-        HttpParser httpParser;
+        // Static files this worker has served, see FileCache
+        FileCache fileCache;
+        // Listening sockets this worker accepts from. With SO_REUSEPORT each
+        // worker starts with its own, and takes over the ones of workers
+        // that stop.
+        std::vector<int> httpSockets;
         uint64_t id;
         uint64_t maxNumberOfClients;
+        uint64_t now;
         uint64_t _numberOfClients;
+        // Write buffers of removed clients that a send in the ring still
+        // reads from, by the user data of that send
+        std::unordered_map<uint64_t, char*> orphanedWriteBuffers;
+        IoUring ring;
+        // Taken from ServerInfo after every wait for events. The snapshot
+        // may be deleted while the worker waits, so whether it changed is
+        // told by the epoch it was published at.
+        const Routing *routing;
+        uint64_t routingSnapshotEpoch;
         ServerInfo &serverInfo;
         int serverReadfd;
+        // Empty pipes left over from spliced file bodies, as read and write end
+        std::vector<std::pair<int, int>> sparePipes;
+        // Spooled bodies go from the socket to the file through it, see
+        // spool_body(). It is drained before spool_body() returns, so one
+        // pipe serves every client. Made on first use, epoll only.
+        int spoolPipe[2];
+        TimerWheel timers;
         Client *unallocatedList;
+        bool usingIoUring;
 
         // Used by server thread
         std::thread thread;
@@ -73,18 +171,60 @@ namespace awsim
         int serverWritefd;
 
         void accept_http_client();
+        void add_accepted_clients(const int *clientSockets, uint64_t count,
+            bool exhausted);
+        void add_client_chunk();
         void add_http_client(int clientSocket);
-        void increase_max_number_of_clients(
-            uint64_t maxNumberOfClients);
+        void add_http_clients(const int *clientSockets, uint64_t count);
+        void add_http_socket(int sock);
+        void arm_accept(int sock);
+        void arm_receive(Client *client);
+        void arm_server_pipe();
+        void cancel_receive(Client *client);
+        void close_client_socket(int sock);
+        bool complete_response(Client *client);
+        // Stops taking connections and tells the server, which hands the
+        // listening sockets of the worker to the others
+        void crash();
+        void expire_clients();
+        void finish_output(Client *client);
+        Client* get_client(uint64_t userData);
         void handle_client(Client *client);
+        void handle_client_output(Client *client);
+        void handle_output_completion(const io_uring_cqe &cqe);
+        void handle_receive_completion(const io_uring_cqe &cqe);
         void handle_server_pipe();
+        void process_overflow(Client *client);
+        void process_requests(Client *client);
+        // Takes the routing snapshot that is published now
+        void refresh_routing();
+        void receive_data(Client *client, const char *data, size_t length);
         void remove_client(Client *client);
+        void remove_http_socket(int sock);
         void remove_remote_host_sockets();
         void request_stop();
         static void routine_start(Worker &worker);
         void routine_loop();
+        void routine_loop_epoll();
+        void routine_loop_io_uring();
+        // Answers with a prebuilt error response in place of anything queued,
+        // and closes the connection once it is out
+        void send_error(Client *client, HttpResponse::StatusCode statusCode);
+        void send_queued_output(Client *client);
+        bool send_response(Client *client);
+        void set_client_deadline(Client *client, uint64_t seconds);
+        void set_client_events(Client *client, bool waitForWrite);
+        // Moves the gathered body of the current request, which filled the
+        // read buffer, to a file the parser writes the rest of it to
+        void spill_body(Client *client);
+        // Moves the spooled body of the current request to its file as far
+        // as it has arrived. Whether all of it is in, the client may have
+        // been removed when it is not.
+        bool spool_body(Client *client);
         void stop();
+        void update_receive(Client *client);
         void weak_stop();
+        void notify_server(WorkerAndServerFlags::ToServerFlags flag);
         void write_to_pipe(void *buffer, size_t length);
         void write_to_server(void *buffer, size_t length);
     };
@@ -10,6 +10,10 @@ std::string awsim::WorkerAndServerFlags::to_string(ToWorkerFlags flag)
             return "STOP REQUEST";
         case ToWorkerFlags::NumberOfClientsRequest:
             return "NUMBER OF CLIENTS REQUEST";
+        case ToWorkerFlags::AddHttpSocketRequest:
+            return "ADD HTTP SOCKET REQUEST";
+        case ToWorkerFlags::RemoveHttpSocketRequest:
+            return "REMOVE HTTP SOCKET REQUEST";
         default:
             return "UNKNOWN";
     }
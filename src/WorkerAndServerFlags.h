@@ -1,6 +1,7 @@
 #ifndef AWSIM_WORKERANDSERVERFLAGS_H
 #define AWSIM_WORKERANDSERVERFLAGS_H
 
+#include <stdint.h>
 #include <string>
 
 namespace awsim
@@ -33,7 +34,10 @@ namespace awsim
         {
             WeakStopRequest = 0x01,
             StopRequest = 0x02,
-            NumberOfClientsRequest = 0x03
+            NumberOfClientsRequest = 0x03,
+            // Followed by the socket as an int
+            AddHttpSocketRequest = 0x04,
+            RemoveHttpSocketRequest = 0x05
         };
 
         enum class ToServerFlags
@@ -43,6 +47,13 @@ namespace awsim
             Crashed = 0x3
         };
 
+        // Every message from a worker starts with this header
+        struct ToServerHeader
+        {
+            uint64_t workerID;
+            ToServerFlags flag;
+        };
+
         static std::string to_string(ToWorkerFlags flag);
 
         static std::string to_string(ToServerFlags flag);
@@ -1,12 +1,24 @@
 #ifndef AWSIM_DEFAULTS_H
 #define AWSIM_DEFAULTS_H
 
+#define AWSIM_DEFAULT_COMPRESSION true
 #define AWSIM_DEFAULT_CONSOLE_SOCKET_PATH "/var/run/awsimd"
 #define AWSIM_DEFAULT_DYNAMIC_NUMBER_OF_WORKERS true
+#define AWSIM_DEFAULT_EVENT_LOOP "epoll"
+#define AWSIM_DEFAULT_FILE_CACHE_ENTRIES 1024
+#define AWSIM_DEFAULT_FILE_CACHE_MEMORY 16777216
+#define AWSIM_DEFAULT_FILE_CACHE_TTL 2
 #define AWSIM_DEFAULT_HTTP_PORT_NUMBER 80
 #define AWSIM_DEFAULT_HTTPS_PORT_NUMBER 443
+#define AWSIM_DEFAULT_KEEP_ALIVE_TIMEOUT 15
+#define AWSIM_DEFAULT_MAX_BODY_SIZE 1048576
 #define AWSIM_DEFAULT_MINIMUM_SIZE_OF_LARGE_FILES 1048576
+#define AWSIM_DEFAULT_MINIMUM_SIZE_OF_SPOOLED_BODIES 65536
 #define AWSIM_DEFAULT_PERCENT_OF_CORES_AS_WORKERS 1.0
+#define AWSIM_DEFAULT_REQUEST_HEADER_TIMEOUT 10
+#define AWSIM_DEFAULT_REUSE_PORT true
+#define AWSIM_DEFAULT_SPOOL_DIRECTORY "/var/tmp"
 #define AWSIM_DEFAULT_STATIC_NUMBER_OF_WORKERS 4
+#define AWSIM_DEFAULT_WRITE_TIMEOUT 30
 
 #endif
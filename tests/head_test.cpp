@@ -0,0 +1,255 @@
+// Answers HEAD and then GET for the same static file on one keep-alive
+// connection, for each way a static file goes out: from memory, by
+// sendfile, compressed on the fly, from a precompressed sibling, as a
+// single range and as multipart ranges. Then the same for a dynamic page,
+// which Router hands HEAD as well as GET. The HEAD response has to end
+// with its headers, or the GET response behind it is read as the rest of
+// its body.
+//
+// Usage: head_test
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "Client.h"
+#include "Compressor.h"
+#include "DynamicPage.h"
+#include "DynamicPages.h"
+#include "FileCache.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "Resource.h"
+
+#define LARGE_FILE_SIZE 2097152
+#define SMALL_FILE_SIZE 12790
+
+namespace
+{
+    struct Case
+    {
+        const char *name;
+        const char *path;
+        const char *acceptEncoding;
+        const char *range;
+        bool compress;
+        // Answers in place of the file at path when set
+        awsim::DynamicPage page;
+    };
+}
+
+static bool check_responses(const std::string &stream,
+    const char *name);
+static void page(const awsim::HttpRequest *request, awsim::Client *client);
+static void respond(awsim::Client *client, awsim::FileCache &fileCache,
+    int rootDirectoryFd, const Case &test, awsim::HttpRequest::Method method);
+static void write_file(int directoryFd, const char *path, size_t size);
+
+int main()
+{
+    static const Case cases[] = {
+        {"in memory", "/data.txt", nullptr, nullptr, false, nullptr},
+        {"sendfile", "/large.bin", nullptr, nullptr, false, nullptr},
+        {"compressed on the fly", "/data.txt", "gzip", nullptr, true,
+            nullptr},
+        {"precompressed sibling", "/style.css", "gzip", nullptr, false,
+            nullptr},
+        {"single range", "/data.txt", nullptr, "bytes=10-99", false,
+            nullptr},
+        {"multipart ranges", "/large.bin", nullptr, "bytes=0-9,100-199",
+            false, nullptr},
+        {"dynamic page", "/page", nullptr, nullptr, false, page},
+        {"dynamic page compressed", "/page", "gzip", nullptr, true, page}
+    };
+    char directory[] = "/tmp/awsim-head-test-XXXXXX";
+    awsim::FileCache fileCache;
+    awsim::Compressor compressor;
+    int failures = 0;
+    int rootDirectoryFd;
+
+    if (mkdtemp(directory) == nullptr)
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    rootDirectoryFd = open(directory, O_RDONLY | O_DIRECTORY);
+    write_file(rootDirectoryFd, "data.txt", SMALL_FILE_SIZE);
+    write_file(rootDirectoryFd, "large.bin", LARGE_FILE_SIZE);
+    write_file(rootDirectoryFd, "style.css", SMALL_FILE_SIZE);
+    write_file(rootDirectoryFd, "style.css.gz", SMALL_FILE_SIZE / 4);
+    fileCache.init(64, 60, 16777216, 1048576);
+    compressor.init();
+
+    for (const Case &test : cases)
+    {
+        awsim::Client *client = new awsim::Client();
+        std::string stream;
+        int fds[2];
+        std::thread reader;
+
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+        {
+            perror("socketpair");
+            return 1;
+        }
+        reader = std::thread([&stream, fd = fds[1]]()
+        {
+            char buffer[65536];
+            ssize_t length;
+
+            while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+            {
+                stream.append(buffer, length);
+            }
+        });
+        client->init(fds[0], false);
+        client->compressor = test.compress ? &compressor : nullptr;
+        respond(client, fileCache, rootDirectoryFd, test,
+            awsim::HttpRequest::Method::HEAD);
+        respond(client, fileCache, rootDirectoryFd, test,
+            awsim::HttpRequest::Method::GET);
+        close(fds[0]);
+        reader.join();
+        close(fds[1]);
+        free(client->writeBuffer);
+        delete client;
+
+        if (!check_responses(stream, test.name))
+        {
+            failures++;
+        }
+    }
+
+    for (const char *path : {"data.txt", "large.bin", "style.css",
+        "style.css.gz"})
+    {
+        unlinkat(rootDirectoryFd, path, 0);
+    }
+    close(rootDirectoryFd);
+    rmdir(directory);
+    printf("%d of %zu failed\n", failures, sizeof(cases) / sizeof(cases[0]));
+    return failures == 0 ? 0 : 1;
+}
+
+// The stream has to hold a response to HEAD with no body, then a response
+// to GET with as much body as its Content-Length says, and nothing else
+static bool check_responses(const std::string &stream, const char *name)
+{
+    size_t offset = 0;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        size_t end = stream.find("\r\n\r\n", offset);
+        size_t field;
+        uint64_t length;
+
+        if (stream.compare(offset, 9, "HTTP/1.1 ") != 0
+            || end == std::string::npos)
+        {
+            printf("FAIL %s: response %d does not start where it should\n",
+                name, i + 1);
+            return false;
+        }
+        field = stream.find("Content-Length: ", offset);
+        if (field == std::string::npos || field > end)
+        {
+            printf("FAIL %s: response %d has no Content-Length\n", name,
+                i + 1);
+            return false;
+        }
+        length = strtoull(stream.c_str() + field + 16, nullptr, 10);
+        offset = end + 4 + (i == 0 ? 0 : length);
+        if (offset > stream.size())
+        {
+            printf("FAIL %s: the GET response is %zu bytes short\n", name,
+                offset - stream.size());
+            return false;
+        }
+    }
+    if (offset != stream.size())
+    {
+        printf("FAIL %s: %zu bytes follow the GET response\n", name,
+            stream.size() - offset);
+        return false;
+    }
+    printf("ok   %s\n", name);
+    return true;
+}
+
+static void page(const awsim::HttpRequest*, awsim::Client *client)
+{
+    awsim::HttpResponse response(1, 1, awsim::HttpResponse::StatusCode::OK_200);
+    std::string body;
+
+    while (body.size() < SMALL_FILE_SIZE)
+    {
+        body += "row " + std::to_string(body.size()) + "\n";
+    }
+    response.set_connection(awsim::HttpResponse::Connection::KeepAlive);
+    response.send_to(client, body.data(), body.size());
+}
+
+static void respond(awsim::Client *client, awsim::FileCache &fileCache,
+    int rootDirectoryFd, const Case &test, awsim::HttpRequest::Method method)
+{
+    static const awsim::DynamicPages dynamicPages;
+    awsim::Resource resource;
+    awsim::HttpRequest::Value *value;
+
+    client->reset_request();
+    client->keepAlive = true;
+    client->request.method = method;
+    if (test.acceptEncoding != nullptr)
+    {
+        value = client->request.add_field(
+            awsim::HttpRequest::Field::AcceptEncoding);
+        value->buffer = test.acceptEncoding;
+        value->length = strlen(test.acceptEncoding);
+        value->set = true;
+    }
+    if (test.range != nullptr)
+    {
+        value = client->request.add_field(awsim::HttpRequest::Field::Range);
+        value->buffer = test.range;
+        value->length = strlen(test.range);
+        value->set = true;
+    }
+    if (test.page != nullptr)
+    {
+        test.page(&client->request, client);
+    }
+    else
+    {
+        resource.init(test.path, method, rootDirectoryFd, dynamicPages,
+            &fileCache);
+        resource.respond(&client->request, client);
+    }
+    while (!client->flush())
+    {
+    }
+}
+
+static void write_file(int directoryFd, const char *path, size_t size)
+{
+    std::string contents;
+    int fd = openat(directoryFd, path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    // Text, so that it is worth compressing on the fly
+    while (contents.size() < size)
+    {
+        contents += "line " + std::to_string(contents.size()) + "\n";
+    }
+    contents.resize(size);
+    if (fd == -1 || write(fd, contents.data(), size) != (ssize_t)size)
+    {
+        perror(path);
+        exit(1);
+    }
+    close(fd);
+}
@@ -0,0 +1,387 @@
+// Writes precompressed siblings (foo.js.gz, foo.js.br, foo.js.zst) of the
+// files below the given directories, which awsimd serves to clients that
+// accept them. Siblings that are at least as new as their file are left
+// alone, and a sibling is only kept if it is smaller than the file.
+//
+// Usage: awsim-precompress [-f] [-m <minimum size>] <directory>...
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <inttypes.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef AWSIM_HAVE_BROTLI
+    #include <brotli/encode.h>
+#endif
+#ifdef AWSIM_HAVE_ZSTD
+    #include <zstd.h>
+#endif
+
+#define DEFAULT_MINIMUM_SIZE 256
+
+namespace
+{
+    struct Encoder
+    {
+        const char *suffix;
+        std::string (*compress)(const std::string &data);
+    };
+
+    struct Totals
+    {
+        uint64_t files;
+        uint64_t written;
+        uint64_t upToDate;
+        uint64_t notSmaller;
+        uint64_t errors;
+    };
+}
+
+static std::string compress_gzip(const std::string &data);
+#ifdef AWSIM_HAVE_BROTLI
+    static std::string compress_brotli(const std::string &data);
+#endif
+#ifdef AWSIM_HAVE_ZSTD
+    static std::string compress_zstd(const std::string &data);
+#endif
+static bool has_suffix(const char *path, const char *suffix);
+static bool is_compressible(const char *path);
+static void precompress(const char *path, const struct stat &s);
+static std::string read_file(const char *path, size_t size);
+static int visit(const char *path, const struct stat *s, int type,
+    FTW *ftw);
+static void write_file(const std::string &path, const std::string &data,
+    const struct stat &s);
+
+static const Encoder encoders[] = {
+    #ifdef AWSIM_HAVE_BROTLI
+        {".br", compress_brotli},
+    #endif
+    #ifdef AWSIM_HAVE_ZSTD
+        {".zst", compress_zstd},
+    #endif
+    {".gz", compress_gzip}
+};
+
+static bool force = false;
+static uint64_t minimumSize = DEFAULT_MINIMUM_SIZE;
+static Totals totals;
+
+int main(int argc, char **argv)
+{
+    int option;
+
+    while ((option = getopt(argc, argv, "fm:")) != -1)
+    {
+        switch (option)
+        {
+            case 'f':
+                force = true;
+                break;
+            case 'm':
+                minimumSize = strtoull(optarg, nullptr, 10);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-f] [-m <minimum size>] "
+                    "<directory>...\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind == argc)
+    {
+        fprintf(stderr, "Usage: %s [-f] [-m <minimum size>] <directory>...\n",
+            argv[0]);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; ++i)
+    {
+        if (nftw(argv[i], visit, 64, FTW_PHYS) == -1)
+        {
+            fprintf(stderr, "nftw(\"%s\", visit, 64, FTW_PHYS) failed -> %s\n",
+                argv[i], strerror(errno));
+            totals.errors++;
+        }
+    }
+
+    printf("%" PRIu64 " files, %" PRIu64 " siblings written, %" PRIu64
+        " up to date, %" PRIu64 " not smaller than their file, %" PRIu64
+        " errors\n", totals.files, totals.written, totals.upToDate,
+        totals.notSmaller, totals.errors);
+    return totals.errors == 0 ? 0 : 2;
+}
+
+static std::string compress_gzip(const std::string &data)
+{
+    z_stream stream;
+    std::string output;
+    int result;
+
+    memset(&stream, 0, sizeof(stream));
+    // 16 on top of the window bits asks for a gzip header and trailer
+    result = deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9,
+        Z_DEFAULT_STRATEGY);
+    if (result != Z_OK)
+    {
+        throw std::runtime_error("deflateInit2(...) failed -> "
+            + std::to_string(result));
+    }
+    output.resize(deflateBound(&stream, data.size()));
+    stream.next_in = (Bytef*)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef*)&output[0];
+    stream.avail_out = output.size();
+    result = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END)
+    {
+        throw std::runtime_error("deflate(&stream, Z_FINISH) failed -> "
+            + std::to_string(result));
+    }
+    output.resize(stream.total_out);
+    return output;
+}
+
+#ifdef AWSIM_HAVE_BROTLI
+    static std::string compress_brotli(const std::string &data)
+    {
+        std::string output;
+        size_t length = BrotliEncoderMaxCompressedSize(data.size());
+
+        output.resize(length);
+        if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW,
+            BROTLI_MODE_GENERIC, data.size(), (const uint8_t*)data.data(),
+            &length, (uint8_t*)&output[0]))
+        {
+            throw std::runtime_error("BrotliEncoderCompress(...) failed");
+        }
+        output.resize(length);
+        return output;
+    }
+#endif
+
+#ifdef AWSIM_HAVE_ZSTD
+    static std::string compress_zstd(const std::string &data)
+    {
+        std::string output;
+        size_t length;
+
+        output.resize(ZSTD_compressBound(data.size()));
+        length = ZSTD_compress(&output[0], output.size(), data.data(),
+            data.size(), 19);
+        if (ZSTD_isError(length))
+        {
+            throw std::runtime_error(
+                std::string("ZSTD_compress(...) failed -> ")
+                + ZSTD_getErrorName(length));
+        }
+        output.resize(length);
+        return output;
+    }
+#endif
+
+static bool has_suffix(const char *path, const char *suffix)
+{
+    size_t pathLength = strlen(path);
+    size_t suffixLength = strlen(suffix);
+
+    return pathLength >= suffixLength
+        && strcasecmp(path + pathLength - suffixLength, suffix) == 0;
+}
+
+static bool is_compressible(const char *path)
+{
+    // Already compressed formats, the siblings themselves and siblings
+    // that are being written
+    static const char *skipped[] = {
+        ".7z", ".avif", ".br", ".bz2", ".gif", ".gz", ".jpeg", ".jpg",
+        ".mp3", ".mp4", ".ogg", ".png", ".tmp", ".webm", ".webp", ".woff",
+        ".woff2", ".xz", ".zip", ".zst"
+    };
+
+    for (const char *suffix : skipped)
+    {
+        if (has_suffix(path, suffix))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void precompress(const char *path, const struct stat &s)
+{
+    std::string data;
+
+    for (const Encoder &encoder : encoders)
+    {
+        std::string siblingPath = std::string(path) + encoder.suffix;
+        std::string compressed;
+        struct stat sibling;
+
+        if (!force && stat(siblingPath.c_str(), &sibling) == 0
+            && (sibling.st_mtim.tv_sec > s.st_mtim.tv_sec
+            || (sibling.st_mtim.tv_sec == s.st_mtim.tv_sec
+            && sibling.st_mtim.tv_nsec >= s.st_mtim.tv_nsec)))
+        {
+            totals.upToDate++;
+            continue;
+        }
+
+        if (data.empty())
+        {
+            data = read_file(path, s.st_size);
+        }
+        compressed = encoder.compress(data);
+        if (compressed.size() >= data.size())
+        {
+            // A stale sibling would be served in place of the newer file
+            if (unlink(siblingPath.c_str()) == -1 && errno != ENOENT)
+            {
+                throw std::runtime_error("unlink(\"" + siblingPath
+                    + "\") failed -> " + strerror(errno));
+            }
+            totals.notSmaller++;
+            continue;
+        }
+        write_file(siblingPath, compressed, s);
+        totals.written++;
+        printf("%s: %zu -> %zu\n", siblingPath.c_str(), data.size(),
+            compressed.size());
+    }
+}
+
+static std::string read_file(const char *path, size_t size)
+{
+    std::string data;
+    size_t length = 0;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        throw std::runtime_error(std::string("open(\"") + path
+            + "\", O_RDONLY | O_CLOEXEC) failed -> " + strerror(errno));
+    }
+    data.resize(size);
+    while (length < size)
+    {
+        ssize_t count = read(fd, &data[length], size - length);
+
+        if (count == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            int error = errno;
+
+            close(fd);
+            throw std::runtime_error(std::string("read(\"") + path
+                + "\") failed -> " + (count == 0 ? "File shrank"
+                : strerror(error)));
+        }
+        length += count;
+    }
+    close(fd);
+    return data;
+}
+
+static int visit(const char *path, const struct stat *s, int type, FTW *ftw)
+{
+    (void)ftw;
+    if (type != FTW_F || !S_ISREG(s->st_mode) || !is_compressible(path)
+        || (uint64_t)s->st_size < minimumSize)
+    {
+        return 0;
+    }
+
+    totals.files++;
+    try
+    {
+        precompress(path, *s);
+    }
+    catch (const std::exception &ex)
+    {
+        fprintf(stderr, "Failed to precompress \"%s\" -> %s\n", path,
+            ex.what());
+        totals.errors++;
+    }
+    return 0;
+}
+
+static void write_file(const std::string &path, const std::string &data,
+    const struct stat &s)
+{
+    std::string temporaryPath = path + ".tmp";
+    timespec times[2] = {s.st_atim, s.st_mtim};
+    size_t length = 0;
+    int fd;
+
+    // Written next to the sibling and renamed over it, so the server never
+    // opens a half written file
+    fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+        s.st_mode & 0777);
+    if (fd == -1)
+    {
+        throw std::runtime_error("open(\"" + temporaryPath
+            + "\", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC) failed -> "
+            + strerror(errno));
+    }
+    while (length < data.size())
+    {
+        ssize_t count = write(fd, data.data() + length, data.size() - length);
+
+        if (count == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count == -1)
+        {
+            int error = errno;
+
+            close(fd);
+            unlink(temporaryPath.c_str());
+            throw std::runtime_error("write(\"" + temporaryPath
+                + "\") failed -> " + strerror(error));
+        }
+        length += count;
+    }
+    // The sibling carries the time of the file it was made from, which is
+    // how later runs tell that it is up to date
+    if (futimens(fd, times) == -1)
+    {
+        int error = errno;
+
+        close(fd);
+        unlink(temporaryPath.c_str());
+        throw std::runtime_error("futimens(\"" + temporaryPath
+            + "\") failed -> " + strerror(error));
+    }
+    if (close(fd) == -1)
+    {
+        int error = errno;
+
+        unlink(temporaryPath.c_str());
+        throw std::runtime_error("close(\"" + temporaryPath
+            + "\") failed -> " + strerror(error));
+    }
+    if (rename(temporaryPath.c_str(), path.c_str()) == -1)
+    {
+        int error = errno;
+
+        unlink(temporaryPath.c_str());
+        throw std::runtime_error("rename(\"" + temporaryPath + "\", \"" + path
+            + "\") failed -> " + strerror(error));
+    }
+}